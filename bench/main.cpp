@@ -0,0 +1,322 @@
+//
+// bench_trackerboy
+//
+// Offline render benchmark. Each module is rendered with the same
+// DefaultApu/Synth/Engine path used by WavExporter, except that the samples
+// are discarded instead of written to a file. Results are printed as a table
+// and optionally as JSON, for tracking performance across releases.
+//
+// Usage: bench_trackerboy [options] module_file...
+//
+
+#include "trackerboy/apu/DefaultApu.hpp"
+#include "trackerboy/data/Module.hpp"
+#include "trackerboy/engine/Engine.hpp"
+#include "trackerboy/export/Player.hpp"
+#include "trackerboy/Synth.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+constexpr int EXIT_BAD_ARGUMENTS = 1;
+constexpr int EXIT_BAD_MODULE = 2;
+
+struct Options {
+    std::vector<int> samplerates{ 44100 };
+    int loops = 1;
+    int song = 0;
+    // number of times each render is repeated, the fastest is reported
+    int repeat = 3;
+    // path to write JSON results to, "-" for stdout
+    std::string json;
+    std::vector<std::string> modules;
+};
+
+struct Result {
+    std::string module;
+    int samplerate;
+    long frames;
+    long samples;
+    double seconds;
+
+    double framesPerSecond() const {
+        return frames / seconds;
+    }
+
+    double samplesPerSecond() const {
+        return samples / seconds;
+    }
+
+    // audio duration divided by the time it took to render
+    double realtimeFactor() const {
+        return ((double)samples / samplerate) / seconds;
+    }
+};
+
+static void usage(const char *argv0) {
+    std::fprintf(stderr,
+        "usage: %s [options] module_file...\n"
+        "\n"
+        "options:\n"
+        "  --samplerates <list>  comma separated samplerates (default: 44100)\n"
+        "  --loops <count>       number of times to play the song (default: 1)\n"
+        "  --song <index>        index of the song to render (default: 0)\n"
+        "  --repeat <count>      renders per measurement, fastest is kept (default: 3)\n"
+        "  --json <path>         write results as JSON to path, - for stdout\n",
+        argv0
+    );
+}
+
+static bool parseInt(const char *str, int min, int &result) {
+    char *end;
+    auto value = std::strtol(str, &end, 10);
+    if (end == str || *end != '\0' || value < min) {
+        return false;
+    }
+    result = (int)value;
+    return true;
+}
+
+static bool parseArgs(int argc, char *argv[], Options &options) {
+    for (int i = 1; i < argc; ++i) {
+        auto const arg = argv[i];
+        if (arg[0] != '-' || std::strcmp(arg, "-") == 0) {
+            options.modules.emplace_back(arg);
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n", arg);
+            return false;
+        }
+        auto const value = argv[++i];
+
+        bool ok = true;
+        if (std::strcmp(arg, "--samplerates") == 0) {
+            options.samplerates.clear();
+            std::stringstream ss(value);
+            std::string item;
+            while (ok && std::getline(ss, item, ',')) {
+                int rate;
+                ok = parseInt(item.c_str(), 1, rate);
+                options.samplerates.push_back(rate);
+            }
+            ok = ok && !options.samplerates.empty();
+        } else if (std::strcmp(arg, "--loops") == 0) {
+            ok = parseInt(value, 1, options.loops);
+        } else if (std::strcmp(arg, "--song") == 0) {
+            ok = parseInt(value, 0, options.song);
+        } else if (std::strcmp(arg, "--repeat") == 0) {
+            ok = parseInt(value, 1, options.repeat);
+        } else if (std::strcmp(arg, "--json") == 0) {
+            options.json = value;
+        } else {
+            std::fprintf(stderr, "unknown option: %s\n", arg);
+            return false;
+        }
+
+        if (!ok) {
+            std::fprintf(stderr, "invalid value for %s: %s\n", arg, value);
+            return false;
+        }
+    }
+
+    if (options.modules.empty()) {
+        std::fputs("no module files given\n", stderr);
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Renders the song once, returning the number of frames rendered. The total
+// number of samples is stored in samples and the sum of all samples is added
+// to sink, so the compiler cannot discard the render.
+//
+static long render(
+    trackerboy::Module const& mod,
+    trackerboy::Song const* song,
+    int samplerate,
+    int loops,
+    long &samples,
+    double &sink
+) {
+    trackerboy::DefaultApu apu;
+    trackerboy::Synth synth(apu, samplerate, mod.framerate());
+    trackerboy::Engine engine(apu, &mod);
+    engine.setSong(song);
+
+    trackerboy::Player player(engine);
+    player.start(loops);
+
+    auto buffer = std::make_unique<float[]>(synth.framesize() * 2);
+
+    long frames = 0;
+    samples = 0;
+    for (;;) {
+        player.step();
+        if (!player.isPlaying()) {
+            break;
+        }
+        synth.run();
+
+        auto samplesRead = apu.readSamples(buffer.get(), synth.framesize());
+        if (samplesRead) {
+            sink += buffer[0] + buffer[samplesRead * 2 - 1];
+        }
+        samples += (long)samplesRead;
+        ++frames;
+    }
+
+    return frames;
+}
+
+static std::string jsonEscape(std::string const& str) {
+    std::string result;
+    result.reserve(str.size());
+    for (auto ch : str) {
+        switch (ch) {
+            case '"':
+                result += "\\\"";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            case '\n':
+                result += "\\n";
+                break;
+            case '\t':
+                result += "\\t";
+                break;
+            default:
+                if ((unsigned char)ch < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", ch);
+                    result += buf;
+                } else {
+                    result += ch;
+                }
+                break;
+        }
+    }
+    return result;
+}
+
+static void writeJson(std::ostream &out, Options const& options, std::vector<Result> const& results) {
+    out << "{\n";
+    out << "  \"loops\": " << options.loops << ",\n";
+    out << "  \"song\": " << options.song << ",\n";
+    out << "  \"repeat\": " << options.repeat << ",\n";
+    out << "  \"results\": [";
+    bool first = true;
+    for (auto const& result : results) {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {"
+            << "\"module\": \"" << jsonEscape(result.module) << "\", "
+            << "\"samplerate\": " << result.samplerate << ", "
+            << "\"frames\": " << result.frames << ", "
+            << "\"samples\": " << result.samples << ", "
+            << "\"seconds\": " << result.seconds << ", "
+            << "\"framesPerSecond\": " << result.framesPerSecond() << ", "
+            << "\"samplesPerSecond\": " << result.samplesPerSecond() << ", "
+            << "\"realtimeFactor\": " << result.realtimeFactor()
+            << "}";
+    }
+    out << "\n  ]\n";
+    out << "}\n";
+}
+
+int main(int argc, char *argv[]) {
+
+    Options options;
+    if (!parseArgs(argc, argv, options)) {
+        usage(argv[0]);
+        return EXIT_BAD_ARGUMENTS;
+    }
+
+    // when JSON goes to stdout, the table goes to stderr instead
+    auto table = options.json == "-" ? stderr : stdout;
+
+    std::vector<Result> results;
+    double sink = 0.0;
+    int code = 0;
+
+    std::fprintf(table, "%-40s %8s %10s %14s %14s %10s\n", "module", "rate", "frames", "frames/s", "samples/s", "realtime");
+
+    for (auto const& path : options.modules) {
+        trackerboy::Module mod;
+        std::ifstream in(path, std::ios::binary | std::ios::in);
+        if (!in.good() || mod.deserialize(in) != trackerboy::FormatError::none) {
+            std::fprintf(stderr, "%s: could not load module\n", path.c_str());
+            code = EXIT_BAD_MODULE;
+            continue;
+        }
+
+        auto const songCount = (int)mod.songs().size();
+        if (options.song >= songCount) {
+            std::fprintf(stderr, "%s: song %d does not exist\n", path.c_str(), options.song);
+            code = EXIT_BAD_MODULE;
+            continue;
+        }
+        auto const song = mod.songs().get(options.song);
+
+        for (auto samplerate : options.samplerates) {
+            Result result;
+            result.module = path;
+            result.samplerate = samplerate;
+            result.frames = 0;
+            result.samples = 0;
+            result.seconds = 0.0;
+
+            for (int i = 0; i < options.repeat; ++i) {
+                auto const start = std::chrono::steady_clock::now();
+                result.frames = render(mod, song, samplerate, options.loops, result.samples, sink);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                if (i == 0 || elapsed.count() < result.seconds) {
+                    result.seconds = elapsed.count();
+                }
+            }
+            // guard against dividing by zero for empty songs
+            result.seconds = std::max(result.seconds, 1e-9);
+
+            std::fprintf(table, "%-40s %8d %10ld %14.0f %14.0f %9.1fx\n",
+                path.c_str(),
+                samplerate,
+                result.frames,
+                result.framesPerSecond(),
+                result.samplesPerSecond(),
+                result.realtimeFactor()
+            );
+            results.push_back(std::move(result));
+        }
+    }
+
+    if (!options.json.empty()) {
+        if (options.json == "-") {
+            writeJson(std::cout, options, results);
+        } else {
+            std::ofstream out(options.json);
+            if (!out.good()) {
+                std::fprintf(stderr, "could not write %s\n", options.json.c_str());
+                return EXIT_BAD_ARGUMENTS;
+            }
+            writeJson(out, options, results);
+        }
+    }
+
+    // printed so the renders have an observable effect
+    std::fprintf(stderr, "checksum: %g\n", sink);
+
+    return code;
+}
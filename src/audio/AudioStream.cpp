@@ -11,6 +11,9 @@ namespace TU {
 
 static const char* LOG_PREFIX = "[AudioStream]";
 
+// number of device periods to use when rendering from a callback
+constexpr ma_uint32 CALLBACK_PERIODS = 2;
+
 }
 
 
@@ -50,7 +53,12 @@ AudioStream::AudioStream(QObject *parent) :
     mDevice(),
     mPlaybackDelay(0),
     mUnderruns(0),
-    mDraining(false)
+    mDraining(false),
+    mRenderCallback(nullptr),
+    mRenderCallbackData(nullptr),
+    mWakeCallback(nullptr),
+    mWakeCallbackData(nullptr),
+    mWakeWatermark(0)
 {
 
 }
@@ -75,6 +83,29 @@ size_t AudioStream::bufferSize() const {
     return mBuffer.size();
 }
 
+size_t AudioStream::deviceBufferSize() {
+    if (!isEnabled()) {
+        return 0;
+    }
+    auto device = mDevice.get();
+    return (size_t)device->playback.internalPeriodSizeInFrames * device->playback.internalPeriods;
+}
+
+void AudioStream::setRenderCallback(RenderCallbackFn fn, void *userData) {
+    mRenderCallback = fn;
+    mRenderCallbackData = userData;
+}
+
+bool AudioStream::hasRenderCallback() const {
+    return mRenderCallback != nullptr;
+}
+
+void AudioStream::setWakeCallback(WakeCallbackFn fn, void *userData, size_t watermark) {
+    mWakeCallback = fn;
+    mWakeCallbackData = userData;
+    mWakeWatermark = watermark;
+}
+
 void AudioStream::setDraining(bool draining) {
     mDraining = draining;
 }
@@ -104,6 +135,12 @@ void AudioStream::open(AudioEnumerator::Device const& device, int samplerate, in
     deviceConfig.pUserData = this;
     deviceConfig.sampleRate = samplerate;
     deviceConfig.playback.pDeviceID = device.id;
+    if (mRenderCallback) {
+        // no playback buffer, so the latency setting is used for the device's
+        // buffer instead
+        deviceConfig.periodSizeInMilliseconds = (ma_uint32)std::max(1, latency / (int)TU::CALLBACK_PERIODS);
+        deviceConfig.periods = TU::CALLBACK_PERIODS;
+    }
 
     mContext = device.context;
     auto result = mDevice.init(mContext.get(), &deviceConfig);
@@ -169,6 +206,11 @@ void AudioStream::deviceDataCallback(ma_device *device, void *out, const void *i
 
 void AudioStream::handleData(float *out, size_t frames) {
 
+    if (mRenderCallback) {
+        mRenderCallback(mRenderCallbackData, out, frames);
+        return;
+    }
+
     // an entire buffer's worth of silence is played when the stream is started
     // this gives the us ample time to fill the buffer before playing from it.
     // Without this the output might be choppy at the start.
@@ -182,10 +224,15 @@ void AudioStream::handleData(float *out, size_t frames) {
         mPlaybackDelay -= samples;
     }
 
-    auto nread = mBuffer.reader().fullRead(out, frames);
+    auto reader = mBuffer.reader();
+    auto nread = reader.fullRead(out, frames);
     if (nread < frames && !mDraining) {
         ++mUnderruns;
     }
+
+    if (mWakeCallback && reader.availableRead() <= mWakeWatermark) {
+        mWakeCallback(mWakeCallbackData);
+    }
 }
 
 void AudioStream::deviceStopCallback(ma_device *device) {
@@ -14,11 +14,28 @@
 // AudioStream class. Manages a miniaudio device and a playback buffer for
 // asynchronous sound output.
 //
+// When a render callback is set, the playback buffer is bypassed and the
+// callback is responsible for filling the device's buffer directly.
+//
 class AudioStream : public QObject {
 
     Q_OBJECT
 
 public:
+
+    //
+    // Callback function for rendering directly to the device buffer. The
+    // callback must write exactly frames samples to out (out is zero-filled
+    // beforehand). This function is called from the device's thread.
+    //
+    using RenderCallbackFn = void(*)(void *userData, float *out, size_t frames);
+
+    //
+    // Callback function for when the playback buffer runs low. This function
+    // is called from the device's thread and must not block.
+    //
+    using WakeCallbackFn = void(*)(void *userData);
+
     explicit AudioStream(QObject *parent = nullptr);
 
     //
@@ -49,6 +66,33 @@ public:
     //
     size_t bufferSize() const;
 
+    //
+    // Gets the size of the device's internal buffer, in samples. Returns 0
+    // if the stream is not enabled.
+    //
+    size_t deviceBufferSize();
+
+    //
+    // Sets the callback to render with. When set, the playback buffer is not
+    // used. Set to nullptr to use the playback buffer. The stream must be
+    // reopened for the change to take effect.
+    //
+    void setRenderCallback(RenderCallbackFn fn, void *userData = nullptr);
+
+    //
+    // Determines if a render callback is being used instead of the playback
+    // buffer.
+    //
+    bool hasRenderCallback() const;
+
+    //
+    // Sets the callback invoked after the device reads from the playback
+    // buffer, if the samples left in the buffer are at or below the given
+    // watermark. Set to nullptr to disable. Must not be called while the
+    // stream is running.
+    //
+    void setWakeCallback(WakeCallbackFn fn, void *userData = nullptr, size_t watermark = 0);
+
     void setDraining(bool draining);
 
     //
@@ -120,5 +164,14 @@ private:
     std::atomic_uint mUnderruns;
     std::atomic_bool mDraining;
 
+    // only modified when the device is not initialized
+    RenderCallbackFn mRenderCallback;
+    void *mRenderCallbackData;
+
+    // only modified when the device is not running
+    WakeCallbackFn mWakeCallback;
+    void *mWakeCallbackData;
+    size_t mWakeWatermark;
+
 };
 
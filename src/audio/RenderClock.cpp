@@ -0,0 +1,133 @@
+
+#include "audio/RenderClock.hpp"
+
+#define TU RenderClockTU
+namespace TU {
+
+// used until an interval is set
+constexpr auto DEFAULT_INTERVAL = std::chrono::milliseconds(5);
+
+}
+
+RenderClock::RenderClock() :
+    mThread(),
+    mMutex(),
+    mCv(),
+    mRunning(false),
+    mWakePending(false),
+    mWakeTime(0),
+    mInterval(Clock::duration(TU::DEFAULT_INTERVAL).count()),
+    mCallback(nullptr),
+    mCallbackData(nullptr),
+    mThreadInit(nullptr),
+    mThreadInitData(nullptr),
+    mLateness(0)
+{
+}
+
+RenderClock::~RenderClock() {
+    stop();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void RenderClock::setCallback(CallbackFn function, void *data) {
+    mCallback = function;
+    mCallbackData = data;
+}
+
+void RenderClock::setThreadInit(CallbackFn function, void *data) {
+    mThreadInit = function;
+    mThreadInitData = data;
+}
+
+void RenderClock::setInterval(Clock::duration interval) {
+    mInterval = interval.count();
+}
+
+void RenderClock::start() {
+    stop();
+    // the thread may have stopped itself, it is finished or about to be
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+
+    mWakePending = false;
+    mRunning = true;
+    mThread = std::thread(&RenderClock::run, this);
+}
+
+void RenderClock::stop() {
+    {
+        // set under the lock so the thread can't miss it between checking
+        // and waiting
+        std::lock_guard lock(mMutex);
+        mRunning = false;
+    }
+    mCv.notify_one();
+
+    if (mThread.joinable() && mThread.get_id() != std::this_thread::get_id()) {
+        mThread.join();
+    }
+}
+
+bool RenderClock::isRunning() const {
+    return mRunning;
+}
+
+void RenderClock::wake() {
+    if (mWakePending.load(std::memory_order_relaxed)) {
+        // the thread hasn't gotten to the last one yet
+        return;
+    }
+    mWakeTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    mWakePending.store(true, std::memory_order_release);
+    // no lock is taken here, see the note in the header
+    mCv.notify_one();
+}
+
+RenderClock::Clock::duration RenderClock::lateness() const {
+    return mLateness;
+}
+
+void RenderClock::run() {
+    if (mThreadInit) {
+        mThreadInit(mThreadInitData);
+    }
+
+    auto deadline = Clock::now() + Clock::duration(mInterval.load());
+
+    while (mRunning) {
+        {
+            std::unique_lock lock(mMutex);
+            mCv.wait_until(lock, deadline, [this]() {
+                return !mRunning || mWakePending.load(std::memory_order_acquire);
+            });
+        }
+
+        if (!mRunning) {
+            break;
+        }
+
+        auto const now = Clock::now();
+        if (mWakePending.exchange(false, std::memory_order_acquire)) {
+            mLateness = now - Clock::time_point(Clock::duration(mWakeTime.load(std::memory_order_relaxed)));
+        } else {
+            mLateness = now - deadline;
+        }
+
+        mCallback(mCallbackData);
+
+        // the next deadline is relative to the last, so that wake up latency
+        // doesn't accumulate. If we fell more than a period behind, start
+        // over from now instead of running periods back to back
+        auto const interval = Clock::duration(mInterval.load());
+        deadline += interval;
+        if (deadline <= now) {
+            deadline = now + interval;
+        }
+    }
+}
+
+#undef TU
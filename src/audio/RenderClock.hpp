@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//
+// Clock for the render thread mode. Unlike FastTimer, which depends on a Qt
+// event loop and millisecond timers, the clock runs its own std::thread that
+// sleeps until an absolute deadline, so periods do not accumulate drift. The
+// thread can also be woken early with wake(), the AudioStream does this when
+// its playback buffer runs low.
+//
+// Unless otherwise noted, methods must be called from the GUI thread.
+//
+class RenderClock {
+
+public:
+
+    using Clock = std::chrono::steady_clock;
+    using CallbackFn = void(*)(void*);
+
+    RenderClock();
+    ~RenderClock();
+
+    //
+    // Sets the function invoked every period from the clock's thread. Must
+    // not be called while running.
+    //
+    void setCallback(CallbackFn function, void *data = nullptr);
+
+    //
+    // Sets a function invoked from the clock's thread when it starts, before
+    // the first period. Must not be called while running.
+    //
+    void setThreadInit(CallbackFn function, void *data = nullptr);
+
+    //
+    // Sets the time between periods. Takes effect on the next period. Can be
+    // called from any thread.
+    //
+    void setInterval(Clock::duration interval);
+
+    //
+    // Starts the clock thread. If the clock is already running it is
+    // restarted.
+    //
+    void start();
+
+    //
+    // Stops the clock. When called from the clock's thread (ie from the
+    // callback), the thread exits once the callback returns, otherwise this
+    // waits for the thread to exit.
+    //
+    void stop();
+
+    bool isRunning() const;
+
+    //
+    // Wakes the clock's thread for an early period. Lock-free, so it can be
+    // called from a real-time thread. Wakes that arrive while the thread is
+    // about to sleep may be missed, the period then happens on schedule.
+    //
+    void wake();
+
+    //
+    // Gets how late the current period started, from either the deadline or
+    // the call to wake(). Must only be called from the callback.
+    //
+    Clock::duration lateness() const;
+
+private:
+
+    void run();
+
+    std::thread mThread;
+    std::mutex mMutex;
+    std::condition_variable mCv;
+
+    std::atomic_bool mRunning;
+    std::atomic_bool mWakePending;
+    // time of the pending wake, in ticks since the clock's epoch
+    std::atomic<Clock::rep> mWakeTime;
+    std::atomic<Clock::rep> mInterval;
+
+    CallbackFn mCallback;
+    void *mCallbackData;
+    CallbackFn mThreadInit;
+    void *mThreadInitData;
+
+    // clock thread only
+    Clock::duration mLateness;
+
+};
@@ -1,5 +1,6 @@
 
 #include "audio/Renderer.hpp"
+#include "core/SongIndex.hpp"
 #include "core/StandardRates.hpp"
 #include "utils/utils.hpp"
 
@@ -8,9 +9,97 @@
 #include <QMutexLocker>
 #include <QtDebug>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <ratio>
+#include <utility>
+
+#define TU RendererTU
+namespace TU {
+
+static auto LOG_PREFIX = "[Renderer]";
+
+// frames to search past the start of a pattern for the desired row when
+// seeking, 256 rows at the slowest speed
+constexpr int SEEK_ROW_LIMIT = 256 * 32;
+
+// frames stepped per lock of the module when seeking, so that edits and the
+// render thread are never held up for long
+constexpr int SEEK_BURST_FRAMES = 512;
+
+// a seek taking longer than this is abandoned and playback starts cold
+constexpr auto SEEK_TIMEOUT = std::chrono::milliseconds(250);
+
+// maximum time, in seconds, a MIDI message may be delayed to keep the spacing
+// between it and the first message of its burst
+constexpr double MIDI_MAX_DELAY = 0.1;
+
+constexpr double TAU = 6.283185307179586;
+
+// MIDI controller numbers
+constexpr uint8_t MIDI_CC_MODULATION = 1;
+constexpr uint8_t MIDI_CC_ALL_SOUND_OFF = 120;
+constexpr uint8_t MIDI_CC_ALL_NOTES_OFF = 123;
+
+// pitch bend range, in semitones
+constexpr double MIDI_BEND_RANGE = 2.0;
+// vibrato at full modulation, depth in semitones and period in frames
+constexpr double MIDI_VIBRATO_DEPTH = 0.5;
+constexpr unsigned MIDI_VIBRATO_PERIOD = 12;
+
+// frequency registers (low, high) of the channels that can be bent, bending
+// the noise channel has no musical meaning
+constexpr uint8_t FREQ_REGS[3][2] = {
+    { trackerboy::Apu::REG_NR13, trackerboy::Apu::REG_NR14 },
+    { trackerboy::Apu::REG_NR23, trackerboy::Apu::REG_NR24 },
+    { trackerboy::Apu::REG_NR33, trackerboy::Apu::REG_NR34 }
+};
+// length enable bit of NR14, NR24 and NR34, set by the instrument and kept
+// when bending. The trigger bit is left clear so the note isn't restarted
+constexpr uint8_t NRX4_LENGTH_ENABLE = 0x40;
+
+constexpr int MIDI_CLOCKS_PER_BEAT = 24;
+// clock intervals longer than this (in seconds) mean the clock was paused
+constexpr double MIDI_CLOCK_TIMEOUT = 0.5;
+// weight of a new clock interval in the smoothed interval
+constexpr double MIDI_CLOCK_SMOOTHING = 0.1;
+// fraction of the drift, in frames, corrected for on every clock and the
+// largest correction allowed, as a fraction of the tempo
+constexpr double MIDI_DRIFT_GAIN = 0.01;
+constexpr double MIDI_DRIFT_MAX = 0.02;
+// limits on the engine steps per synthesized frame when syncing
+constexpr double MIDI_RATE_MIN = 0.25;
+constexpr double MIDI_RATE_MAX = 4.0;
 
-//static auto LOG_PREFIX = "[Renderer]";
+//
+// Gets the frequency of the note offset by the given number of semitones.
+//
+static uint16_t bendFrequency(uint8_t note, double semitones) {
+    // the period (2048 - frequency) is inversely proportional to the pitch
+    double const period = 2048 - trackerboy::lookupToneNote(note);
+    auto const bent = std::lround(2048.0 - period / std::exp2(semitones / 12.0));
+    return (uint16_t)std::clamp(bent, 0L, 2047L);
+}
+
+//
+// Locks the channels enabled in the output flags for music, disabled
+// channels are kept unlocked.
+//
+static void lockOutputChannels(trackerboy::Engine &engine, ChannelOutput::Flags flags) {
+    int flag = ChannelOutput::CH1;
+    for (int i = 0; i < 4; ++i) {
+        auto ch = static_cast<trackerboy::ChType>(i);
+        if (flags.testFlag((ChannelOutput::Flag)(flag))) {
+            engine.lock(ch);
+        } else {
+            engine.unlock(ch);
+        }
+        flag <<= 1;
+    }
+}
+
+}
 
 
 // Renderer Notes
@@ -23,6 +112,34 @@
 // utilization indicates that the callback is consuming faster than the rate the
 // audio is being produced. When this happens underruns occur, as the callback doesn't
 // get what it needs and there are now gaps in the playback.
+//
+// The render thread never waits on the GUI thread. While rendering, the
+// RenderContext belongs to the render thread and the GUI thread can only
+// change it by posting a Command to the mCommands queue, which is drained at
+// the start of every period. Information needed by the GUI (the engine frame
+// and buffer diagnostics) is published at the end of every period through the
+// mStatus triple buffer. Once the timer is stopped, the GUI thread takes over
+// the context and executes commands directly.
+//
+// MIDI notes skip the GUI thread entirely: the MIDI input thread pushes them
+// to mMidiQueue which is also drained at the start of every period. Messages
+// drained together are spread out over the period using the timestamps they
+// were received with, so a fast run of notes keeps its rhythm instead of
+// being quantized to the period. The first message of a burst is applied
+// immediately.
+//
+// Playing from the middle of a song needs the engine state (speed, volume,
+// effects) that the earlier patterns leave behind. Neither the GUI nor the
+// render thread replays the song for this: a worker steps a separate engine
+// up to the pattern and the render thread swaps it in with a play command.
+
+
+Renderer::Playback::Playback(trackerboy::Module const& mod, int samplerate, float framerate) :
+    apu(),
+    synth(apu, samplerate, framerate),
+    engine(apu, &mod)
+{
+}
 
 
 Renderer::RenderContext::RenderContext(Module &mod) :
@@ -30,15 +147,32 @@ Renderer::RenderContext::RenderContext(Module &mod) :
     stepping(false),
     step(false),
     song(nullptr),
-    apu(),
-    synth(apu, 44100),
-    engine(apu, &mod.data()),
-    ip(),
+    playback(std::make_shared<Playback>(mod.data(), 44100, mod.data().framerate())),
+    patternRepeat(false),
+    voices(),
+    voiceAge(0),
     previewState(PreviewState::none),
-    previewChannel(trackerboy::ChType::ch1),
-    state(State::stopped),
+    outputFlags(ChannelOutput::AllOn),
+    midiTrack(-1),
+    midiInstrument(),
+    midiHold(false),
+    midiBend(0.0),
+    midiModulation(0.0),
+    midiVibratoTimer(0),
+    midiPitchApplied(false),
+    midiTransport(),
+    framerate(mod.data().framerate()),
+    midiPending(),
+    midiPendingCount(0),
+    midiBaseTime(0.0),
+    midiBaseOffset(0),
+    currentEngineFrame(),
+    visBuffer(),
     stopCounter(0),
+    stopRequested(false),
     bufferSize(0),
+    period(0),
+    renderMode(SoundConfig::RenderMode::push),
     watchdog(),
     lastPeriod(),
     periodTime(0),
@@ -46,19 +180,53 @@ Renderer::RenderContext::RenderContext(Module &mod) :
 {
 }
 
+Renderer::Command::Command(Type type, int arg0, int arg1, int arg2) :
+    type(type),
+    args{ arg0, arg1, arg2 },
+    instrument(),
+    song(),
+    playback(),
+    frame()
+{
+}
 
 
 Renderer::Renderer(Module &mod, QObject *parent) :
     QObject(parent),
     mTimerThread(),
     mTimer(new FastTimer),
+    mClock(),
     mStream(),
-    mVisBuffer(),
+    mScopeWidth(0),
     mOutputFlags(ChannelOutput::AllOn),
     mRenderStartTime(),
+    mStepping(false),
+    mSamplerate(44100),
+    mBufferSize(0),
+    mRenderMode(SoundConfig::RenderMode::push),
+    mMidiHold(false),
+    mSchedOptions(),
+    mSchedMutex(),
+    mSchedStatus(),
+    mState(State::stopped),
+    mJitterCounts(),
+    mJitterMax(0),
+    mCommands(),
+    mMidiQueue(),
+    mMidiStartPending(false),
+    mStatus(),
+    mVisSnapshot(),
+    mSeekPool(),
+    mSeekId(0),
+    mRetiredPlayback(),
     mContext(mod)
 {
+    mSeekPool.setMaxThreadCount(1);
+    mStatus.write({ mContext.currentEngineFrame, 0, Clock::duration(0) });
+
     mTimer->setCallback(timerCallback, this);
+    mClock.setCallback(timerCallback, this);
+    mClock.setThreadInit(clockThreadInit, this);
     mTimer->moveToThread(&mTimerThread);
     connect(&mTimerThread, &QThread::finished, mTimer, &FastTimer::deleteLater);
     mTimerThread.setObjectName(QStringLiteral("renderer timer thread"));
@@ -66,8 +234,9 @@ Renderer::Renderer(Module &mod, QObject *parent) :
 
     connect(&mStream, &AudioStream::aborted, this,
         [this]() {
-            auto handle = mContext.access();
-            stopRender(handle, true);
+            if (mState != State::stopped) {
+                stopRender(true);
+            }
         });
 
     connect(&mod, &Module::songChanged, this, &Renderer::setSong);
@@ -75,7 +244,10 @@ Renderer::Renderer(Module &mod, QObject *parent) :
 }
 
 Renderer::~Renderer() {
-    mTimer->stop();
+    cancelSeek();
+    mSeekPool.waitForDone();
+
+    stopClock();
 
     if (mStream.isRunning()) {
         mStream.stop();
@@ -86,18 +258,21 @@ Renderer::~Renderer() {
 }
 
 void Renderer::setSong() {
-    auto ctx = mContext.access();
-    ctx->song = ctx->mod.songShared();
-    ctx->engine.setSong(ctx->song.get());
+    // a seek in progress is for the previous song
+    cancelSeek();
+
+    Command cmd(Command::Type::setSong);
+    cmd.song = mContext.mod.songShared();
+    postCommand(std::move(cmd));
 
     // if we are playing, restart playback from the start with the new song
     // if we are stepping, stop playback
 
     if (mStream.isRunning()) {
-        if (ctx->stepping) {
-            _stopMusic(ctx);
+        if (mStepping) {
+            stopMusic();
         } else {
-            _play(ctx, 0, 0, false);
+            play(0, 0, false);
         }
     }
 }
@@ -107,18 +282,37 @@ unsigned Renderer::statUnderruns() const {
 }
 
 Renderer::BufferStats Renderer::statBuffer() {
-    auto handle = mContext.access();
-    // it is safe to access the writer since we have acquired access to mContext
+    auto const& status = mStatus.read();
+
+    // no playback buffer is used when rendering from the device callback
+    auto const size = mRenderMode != SoundConfig::RenderMode::pull ? mBufferSize : 0;
+    // the writer's available count is atomic, safe to read from any thread
+    auto const usage = size ? size - mStream.writer().availableWrite() : 0;
+
+    // audio just synthesized must wait for everything in the playback buffer
+    // and the device's buffer to be played out first
+    auto const latency = usage + mStream.deviceBufferSize();
 
-    auto const size = handle->bufferSize;
     return {
-        (int)(size - mStream.writer().availableWrite()),
+        (int)usage,
         (int)size,
-        (int)handle->writesSinceLastPeriod,
-        std::chrono::duration<double, std::milli>{handle->periodTime}.count()
+        (int)status.writesSinceLastPeriod,
+        std::chrono::duration<double, std::milli>{status.periodTime}.count(),
+        latency * 1000.0 / mSamplerate
     };
 }
 
+Renderer::JitterStats Renderer::statJitter() const {
+    JitterStats stats;
+    for (int i = 0; i < JitterStats::BINS; ++i) {
+        stats.counts[i] = mJitterCounts[i].load(std::memory_order_relaxed);
+    }
+    stats.maxMs = std::chrono::duration<double, std::milli>(
+        Clock::duration(mJitterMax.load(std::memory_order_relaxed))
+    ).count();
+    return stats;
+}
+
 long Renderer::statElapsed() const {
     return (long)std::chrono::duration_cast<std::chrono::milliseconds>(
         Clock::now() - mRenderStartTime
@@ -126,11 +320,29 @@ long Renderer::statElapsed() const {
 }
 
 int Renderer::samplerate() {
-    return mContext.access()->synth.samplerate();
+    return mSamplerate;
+}
+
+SoundConfig::RenderMode Renderer::renderMode() const {
+    return mRenderMode;
+}
+
+ThreadScheduling::Status Renderer::schedulingStatus() {
+    QMutexLocker locker(&mSchedMutex);
+    return mSchedStatus;
 }
 
-Guarded<VisualizerBuffer>& Renderer::visualizerBuffer() {
-    return mVisBuffer;
+void Renderer::setSchedulingStatus(ThreadScheduling::Status const& status) {
+    QMutexLocker locker(&mSchedMutex);
+    mSchedStatus = status;
+}
+
+TripleBuffer<VisualizerBuffer::Snapshot>& Renderer::visualizerSnapshot() {
+    return mVisSnapshot;
+}
+
+void Renderer::setScopeWidth(int width) {
+    mScopeWidth = width;
 }
 
 bool Renderer::isRunning() {
@@ -138,16 +350,15 @@ bool Renderer::isRunning() {
 }
 
 bool Renderer::isStepping() {
-    return mContext.access()->stepping;
+    return mStepping;
 }
 
 bool Renderer::isPlaying() {
-    return !mContext.access()->currentEngineFrame.halted;
+    return !mStatus.read().frame.halted;
 }
 
 trackerboy::Frame Renderer::currentFrame() {
-    auto handle = mContext.access();
-    return handle->currentEngineFrame;
+    return mStatus.read().frame;
 }
 
 bool Renderer::setConfig(SoundConfig const &soundConfig, AudioEnumerator const& enumerator) {
@@ -159,7 +370,18 @@ bool Renderer::setConfig(SoundConfig const &soundConfig, AudioEnumerator const&
 
     bool wasRunning = mStream.isRunning();
     if (wasRunning) {
-        mTimer->stop();
+        // stopping both the timer and the stream ensures that nothing is
+        // rendering, so we now own the context
+        stopClock();
+        mStream.stop();
+        drainCommands();
+    }
+
+    mRenderMode = soundConfig.renderMode();
+    if (mRenderMode == SoundConfig::RenderMode::pull) {
+        mStream.setRenderCallback(renderCallback, this);
+    } else {
+        mStream.setRenderCallback(nullptr);
     }
 
     mStream.open(
@@ -171,122 +393,310 @@ bool Renderer::setConfig(SoundConfig const &soundConfig, AudioEnumerator const&
     if (mStream.isEnabled()) {
 
         mTimer->setInterval(soundConfig.period(), Qt::PreciseTimer);
-        
+        mClock.setInterval(std::chrono::milliseconds(soundConfig.period()));
+        mContext.period = std::chrono::milliseconds(soundConfig.period());
+        mContext.renderMode = mRenderMode;
+        if (mRenderMode == SoundConfig::RenderMode::clock) {
+            // wake the render thread early if the buffer is half empty
+            mStream.setWakeCallback(wakeCallback, this, mStream.bufferSize() / 2);
+        } else {
+            mStream.setWakeCallback(nullptr);
+        }
 
-        // update the synthesizer (the guard isn't necessary here but we'll use it anyways)
+        mSchedOptions.realtime = soundConfig.realtimePriority();
+        mSchedOptions.cpu = soundConfig.renderCpu();
+        mSchedOptions.lockMemory = soundConfig.lockMemory();
+        // process wide, done once here instead of by every render thread.
+        // Failures are reported in the render thread's status
+        ThreadScheduling::lockProcessMemory(mSchedOptions.lockMemory);
+
+        // the timer thread only gets the options when it is the render
+        // thread, otherwise they are reverted in case it was previously
+        auto timerOptions = mSchedOptions;
+        if (mRenderMode != SoundConfig::RenderMode::push) {
+            timerOptions.realtime = false;
+            timerOptions.cpu = -1;
+            timerOptions.lockMemory = false;
+        }
+        ThreadScheduling::Status timerStatus;
+        QMetaObject::invokeMethod(mTimer, [&timerStatus, &timerOptions]() {
+            timerStatus = ThreadScheduling::applyToCurrentThread(timerOptions);
+        }, Qt::BlockingQueuedConnection);
+        if (mRenderMode == SoundConfig::RenderMode::push) {
+            setSchedulingStatus(timerStatus);
+        } else {
+            // pull: the device's thread is managed by the backend
+            // clock: set by clockThreadInit when the thread starts
+            setSchedulingStatus({});
+        }
+
+
+        // update the synthesizer, safe to do so as the timer is stopped
         {
-            auto handle = mContext.access();
-            
             bool reloadRegisters = false;
             auto const samplerate = soundConfig.samplerate();
-            if (samplerate != handle->synth.samplerate()) {
-                handle->synth.setSamplerate(samplerate);
+            if (samplerate != mContext.playback->synth.samplerate()) {
+                mContext.playback->synth.setSamplerate(samplerate);
                 reloadRegisters = wasRunning;
             }
-            //handle->synth.apu().setQuality(static_cast<gbapu::Apu::Quality>(soundConfig.quality()));
-            handle->synth.setupBuffers();
+            mSamplerate = samplerate;
+            //mContext.playback->synth.apu().setQuality(static_cast<gbapu::Apu::Quality>(soundConfig.quality()));
+            mContext.playback->synth.setupBuffers();
 
             if (reloadRegisters) {
                 // resizing the buffers in synth results in an APU reset so we need to
                 // rewrite channel registers
-                handle->engine.reload();
+                mContext.playback->engine.reload();
             }
 
-            handle->bufferSize = mStream.bufferSize();
+            mBufferSize = mStream.bufferSize();
+            mContext.bufferSize = mBufferSize;
 
 
-            mVisBuffer.access()->resize(handle->synth.framesize());
+            mContext.visBuffer.resize(mContext.playback->synth.framesize());
 
 
 
         }
 
-        if (wasRunning && mStream.isRunning()) {
-            mTimer->start();
+        if (wasRunning) {
+            if (!mStream.start()) {
+                mState = State::stopped;
+                return false;
+            }
+            startClock();
+        } else if (mMidiHold) {
+            beginRender();
         }
 
         return true;
 
     } else {
         // something went wrong
-        mContext.access()->state = State::stopped;
+        mState = State::stopped;
         return false;
     }
 }
 
-void Renderer::beginRender(Handle &handle) {
-    if (handle->state == State::stopped) {
+void Renderer::postCommand(Command &&cmd) {
+    if (mState == State::stopped) {
+        // the render thread is idle, the context is ours
+        execute(cmd);
+    } else if (!mCommands.push(std::move(cmd))) {
+        // should never happen, the render thread drains the queue every period
+        qWarning() << TU::LOG_PREFIX << "command queue is full, command dropped";
+    }
+}
+
+void Renderer::drainCommands() {
+    Command cmd;
+    while (mCommands.pop(cmd)) {
+        execute(cmd);
+    }
+}
+
+void Renderer::execute(Command &cmd) {
+    auto &ctx = mContext;
+    auto const& args = cmd.args;
+
+    switch (cmd.type) {
+        case Command::Type::none:
+            break;
+        case Command::Type::play:
+            stopMidiSync();
+            if (cmd.playback) {
+                _playSeeked(std::move(cmd.playback), cmd.frame, args[2] != 0);
+            } else {
+                _play(args[0], args[1], args[2] != 0);
+            }
+            break;
+        case Command::Type::resume: {
+            auto expected = State::stopping;
+            mState.compare_exchange_strong(expected, State::running);
+            ctx.stopCounter = 0;
+            ctx.stopRequested = false;
+            mStream.setDraining(false);
+            break;
+        }
+        case Command::Type::stepNextFrame:
+            if (ctx.stepping) {
+                ctx.step = true;
+            }
+            break;
+        case Command::Type::stepOut:
+            ctx.stepping = false;
+            break;
+        case Command::Type::jump:
+            ctx.playback->engine.jump(args[0]);
+            break;
+        case Command::Type::patternRepeat:
+            ctx.patternRepeat = args[0] != 0;
+            ctx.playback->engine.repeatPattern(ctx.patternRepeat);
+            break;
+        case Command::Type::stopMusic:
+            ctx.playback->engine.halt();
+            ctx.stepping = false;
+            stopMidiSync();
+            break;
+        case Command::Type::previewNote:
+            switch (ctx.previewState) {
+                case PreviewState::waveform: {
+                    auto freq = trackerboy::lookupToneNote(args[0]);
+                    ctx.playback->apu.writeRegister(trackerboy::Apu::REG_NR33, (uint8_t)(freq & 0xFF));
+                    ctx.playback->apu.writeRegister(trackerboy::Apu::REG_NR34, (uint8_t)(freq >> 8));
+                    break;
+                }
+                case PreviewState::instrument:
+                    // update the current note
+                    for (auto &voice : ctx.voices) {
+                        if (voice.note != -1) {
+                            voice.note = args[0];
+                            voice.ip.play((uint8_t)args[0]);
+                        }
+                    }
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case Command::Type::instrumentPreview:
+            if (ctx.previewState != PreviewState::none) {
+                resetPreview();
+            }
+            startVoice((uint8_t)args[0], args[1], std::move(cmd.instrument));
+            break;
+        case Command::Type::voicePreview:
+            startVoice((uint8_t)args[0], args[1], std::move(cmd.instrument));
+            break;
+        case Command::Type::stopVoicePreview:
+            stopVoice(args[0]);
+            break;
+        case Command::Type::waveformPreview: {
+            if (ctx.previewState != PreviewState::none) {
+                resetPreview();
+            }
+
+            ctx.previewState = PreviewState::waveform;
+            // unlock the channel, no longer effected by music
+            ctx.playback->engine.unlock(trackerboy::ChType::ch3);
+
+            trackerboy::ChannelState state(trackerboy::ChType::ch3);
+            state.playing = true;
+            state.frequency = trackerboy::lookupToneNote(args[0]);
+            state.envelope = (uint8_t)args[1];
+            {
+                QMutexLocker locker(&ctx.mod.mutex());
+                trackerboy::ChannelControl<trackerboy::ChType::ch3>::init(
+                    ctx.playback->apu, ctx.mod.data().waveformTable(), state
+                );
+            }
+            break;
+        }
+        case Command::Type::midiPreview:
+            ctx.midiTrack = args[0];
+            ctx.midiInstrument = std::move(cmd.instrument);
+            break;
+        case Command::Type::midiHold:
+            ctx.midiHold = args[0] != 0;
+            break;
+        case Command::Type::stopPreview:
+            if (ctx.previewState != PreviewState::none) {
+                resetPreview();
+            }
+            break;
+        case Command::Type::setSong:
+            ctx.song = std::move(cmd.song);
+            ctx.playback->engine.setSong(ctx.song.get());
+            break;
+        case Command::Type::updateFramerate:
+            ctx.framerate = ctx.mod.data().framerate();
+            ctx.playback->synth.setFramerate(ctx.framerate);
+            ctx.playback->synth.setupBuffers();
+            break;
+        case Command::Type::resetGlobalVolume:
+            ctx.playback->apu.writeRegister(trackerboy::IApuIo::REG_NR50, 0x77);
+            break;
+        case Command::Type::channelOutput:
+            ctx.outputFlags = ChannelOutput::Flags(QFlag(args[0]));
+            _setChannelOutput(ctx.outputFlags);
+            break;
+    }
+}
+
+void Renderer::beginRender() {
+    auto state = mState.load();
+    if (state == State::stopped) {
 
         bool success = mStream.start();
 
         if (success) {
+            // the timer is not running, safe to access the context
             auto const now = Clock::now();
-            handle->lastPeriod = now;
-            handle->watchdog = now;
+            mContext.lastPeriod = now;
+            mContext.watchdog = now;
+            mContext.stopCounter = 0;
+            mContext.stopRequested = false;
             mRenderStartTime = now;
-            mTimer->start();
-            handle.unlock();
+            mState = State::running;
+            startClock();
             emit audioStarted();
-            handle.relock();
         } else {
             // unable to start, an error occurred
-            handle.unlock();
             emit audioError();
-            return;
         }
 
+    } else {
+        // cancel the stop countdown, if there is one
+        mStream.setDraining(false);
+        mState.compare_exchange_strong(state, State::running);
+        postCommand({ Command::Type::resume });
     }
-
-    // reset state to running
-    handle->state = State::running;
-    handle->stopCounter = 0;
 }
 
-void Renderer::stopRender(Handle &handle, bool aborted) {
-
+void Renderer::finishRender(bool aborted) {
+    if (mState == State::stopped) {
+        // already stopped via forceStop or an abort
+        return;
+    }
 
-    // this lambda must only be called from the same thread as the Renderer
-    auto stopRender_ = [this](bool aborted) {
+    if (aborted || mState == State::stopping) {
+        stopRender(aborted);
+        // MIDI messages may have been received during the stop
+        startMidiRender();
+    } else {
+        // a new render was requested before we could stop, carry on
+        // (the render thread stopped the timer when requesting the stop)
+        startClock();
+    }
+}
 
-        auto success = mStream.stop();
+void Renderer::stopRender(bool aborted) {
 
-        mVisBuffer.access()->clear();
-        emit updateVisualizers();
+    // once the timer and stream are stopped, nothing will access the context
+    // from another thread, so any pending commands can be executed here
 
-        if (aborted) {
-            mStream.disable();
-            emit audioError();
-        } else {
-            if (success) {
-                emit audioStopped();
-            } else {
-                emit audioError();
-            }
-        }
-    };
+    stopClock();
+    auto success = mStream.stop();
+    mState = State::stopped;
+    drainCommands();
 
-    // determine if we are in the GUI thread (same thread as the Renderer)
-    // this function is mostly called from the timer thread, occurs when:
-    //  - the buffer has drained and we are stopping
-    //  - the watchdog timer has exceeded 1 second (unknown problem with device)
-    // for these cases we need to invoke the lambda in the GUI thread (AudioStream is not thread-safe)
+    // the context is ours now, so we can publish in place of the render thread
+    mContext.visBuffer.clear();
+    mVisSnapshot.back().envelope.clear();
+    mVisSnapshot.publish();
+    emit updateVisualizers();
 
-    mTimer->stop();
-
-    if (objectInCurrentThread(*this)) {
-        handle->state = State::stopped;
-        handle.unlock();
-        stopRender_(aborted);
+    if (aborted) {
+        mStream.disable();
+        emit audioError();
     } else {
-        // stopRender was called from mTimerThread, invoke the lambda in the renderer's thread
-        handle.unlock();
-        QMetaObject::invokeMethod(this, [this, &stopRender_, aborted]() {
-            mContext.access()->state = State::stopped;
-            stopRender_(aborted);
-        }, Qt::BlockingQueuedConnection);
+        if (success) {
+            emit audioStopped();
+        } else {
+            emit audioError();
+        }
     }
 
-
 }
 
 
@@ -295,146 +705,286 @@ void Renderer::stopRender(Handle &handle, bool aborted) {
 
 void Renderer::clearDiagnostics() {
     mStream.resetUnderruns();
+    for (auto &count : mJitterCounts) {
+        count = 0;
+    }
+    mJitterMax = 0;
 }
 
 void Renderer::play(int pattern, int row, bool stepmode) {
 
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        _play(handle, pattern, row, stepmode);
+        mStepping = stepmode;
+        cancelSeek();
+        if (pattern != 0 || row != 0) {
+            // playing from the middle of the song, seek if the index can tell
+            // us where the pattern is. The index is never built here
+            auto const index = mContext.mod.songIndexAsync();
+            if (index) {
+                auto const patternFrame = index->frameOf(pattern);
+                if (patternFrame > 0) {
+                    startSeek(pattern, row, patternFrame);
+                    return;
+                }
+            }
+        }
+        postCommand({ Command::Type::play, pattern, row, stepmode });
+        beginRender();
+    }
+}
+
+void Renderer::startSeek(int pattern, int row, int patternFrame) {
+    // free the playbacks replaced by earlier seeks
+    std::shared_ptr<Playback> retired;
+    while (mRetiredPlayback.pop(retired)) {
+        retired.reset();
+    }
+
+    auto &mod = mContext.mod;
+    SeekRequest request;
+    request.id = ++mSeekId;
+    request.song = mod.songShared();
+    request.pattern = pattern;
+    request.row = row;
+    request.patternFrame = patternFrame;
+    request.samplerate = mSamplerate;
+    request.framerate = mod.data().framerate();
+    request.outputFlags = mOutputFlags;
+
+    mSeekPool.start([this, request]() {
+        seek(request);
+    });
+}
+
+void Renderer::cancelSeek() {
+    ++mSeekId;
+}
+
+void Renderer::seek(SeekRequest const& request) {
+    // worker thread
+
+    auto &mod = mContext.mod;
+    auto playback = std::make_shared<Playback>(mod.data(), request.samplerate, request.framerate);
+    playback->synth.setupBuffers();
+    auto &engine = playback->engine;
+    {
+        QMutexLocker locker(&mod.mutex());
+        engine.setSong(request.song.get());
+        engine.play(0, 0);
+    }
+    TU::lockOutputChannels(engine, request.outputFlags);
+
+    auto const deadline = Clock::now() + TU::SEEK_TIMEOUT;
+    auto const maxFrames = request.patternFrame + TU::SEEK_ROW_LIMIT;
+    trackerboy::Frame frame;
+    bool found = false;
+    int frameNo = 0;
+    while (!found && frameNo < maxFrames) {
+        if (mSeekId != request.id || Clock::now() >= deadline) {
+            break;
+        }
+
+        QMutexLocker locker(&mod.mutex());
+        auto const burstEnd = std::min(frameNo + TU::SEEK_BURST_FRAMES, maxFrames);
+        for (; frameNo < burstEnd; ++frameNo) {
+            engine.step(frame);
+            if (frame.halted) {
+                frameNo = maxFrames;
+                break;
+            }
+            if (frameNo >= request.patternFrame && frame.startedNewRow &&
+                frame.order == request.pattern && frame.row == request.row) {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    if (found) {
+        // this frame is the first to be played, synthesize it so that the
+        // render can continue from the next one
+        playback->synth.run();
+    } else {
+        playback.reset();
+    }
+
+    QMetaObject::invokeMethod(this,
+        [this, request, playback, frame]() {
+            seekFinished(request, playback, frame);
+        },
+        Qt::QueuedConnection);
+}
+
+void Renderer::seekFinished(SeekRequest const& request, std::shared_ptr<Playback> playback, trackerboy::Frame const& frame) {
+    if (request.id != mSeekId || !mStream.isEnabled()) {
+        // cancelled
+        return;
     }
+
+    // the playback's synth must match the context's, which may have changed
+    // during the seek
+    if (request.samplerate != mSamplerate || request.framerate != mContext.mod.data().framerate()) {
+        playback.reset();
+    }
+
+    Command cmd(Command::Type::play, request.pattern, request.row, mStepping);
+    // a failed seek starts cold
+    cmd.playback = std::move(playback);
+    cmd.frame = frame;
+    postCommand(std::move(cmd));
+    beginRender();
 }
 
 
 void Renderer::stepNextFrame() {
     
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        if (handle->stepping) {
-            handle->step = true;
-        }
-
+        postCommand({ Command::Type::stepNextFrame });
     }
 }
 
 void Renderer::stepOut() {
     if (mStream.isEnabled()) {
-        mContext.access()->stepping = false;
+        mStepping = false;
+        postCommand({ Command::Type::stepOut });
     }
 }
 
 void Renderer::jumpToPattern(int pattern) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        ctx->engine.jump(pattern);
+        postCommand({ Command::Type::jump, pattern });
     }
 }
 
 void Renderer::setPatternRepeat(bool repeat) {
 
     if (mStream.isEnabled()) {
-        mContext.access()->engine.repeatPattern(repeat);
+        postCommand({ Command::Type::patternRepeat, repeat });
     }
 }
 
 void Renderer::setPreviewNote(int note) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        switch (ctx->previewState) {
-            case PreviewState::waveform: {
-                auto freq = trackerboy::lookupToneNote(note);
-                ctx->apu.writeRegister(trackerboy::Apu::REG_NR33, (uint8_t)(freq & 0xFF));
-                ctx->apu.writeRegister(trackerboy::Apu::REG_NR34, (uint8_t)(freq >> 8));
-                break;
-            }
-            case PreviewState::instrument:
-                // update the current note
-                ctx->ip.play((uint8_t)note);
-                break;
-            default:
-                break;
-        
-        }
+        postCommand({ Command::Type::previewNote, note });
     }
 }
 
 void Renderer::instrumentPreview(int note, int track, int instrumentId) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        switch (ctx->previewState) {
-            case PreviewState::instrument:
-            case PreviewState::waveform:
-                resetPreview(ctx);
-                [[fallthrough]];
-            case PreviewState::none: {
-                auto const& itable = ctx->mod.data().instrumentTable();
-                std::shared_ptr<const trackerboy::Instrument> inst = nullptr;
-                if (instrumentId != -1) {
-                    inst = itable.getShared((uint8_t)instrumentId);
-                }
-
-                if (track == -1) {
-                    // instrument preview
-                    Q_ASSERT(inst != nullptr); // must have an instrument
-                    ctx->previewChannel = inst->channel();
-                } else {
-                    // note preview
-                    ctx->previewChannel = static_cast<trackerboy::ChType>(track);
-                }
-
-                ctx->ip.setInstrument(std::move(inst), ctx->previewChannel);
+        Command cmd(Command::Type::instrumentPreview, note, track, instrumentId);
+        if (instrumentId != -1) {
+            // lookup the instrument here, the render thread only gets a reference
+            auto const& itable = mContext.mod.data().instrumentTable();
+            cmd.instrument = itable.getShared((uint8_t)instrumentId);
+        }
+        postCommand(std::move(cmd));
+        beginRender();
+    }
+}
 
-                ctx->previewState = PreviewState::instrument;
-                // unlock the channel for preview
-                ctx->engine.unlock(ctx->previewChannel);
-                ctx->ip.play((uint8_t)note);
-                break;
-            }
+void Renderer::voicePreview(int note, int track, int instrumentId) {
+    if (mStream.isEnabled()) {
+        Command cmd(Command::Type::voicePreview, note, track, instrumentId);
+        if (instrumentId != -1) {
+            auto const& itable = mContext.mod.data().instrumentTable();
+            cmd.instrument = itable.getShared((uint8_t)instrumentId);
         }
-        beginRender(ctx);
+        postCommand(std::move(cmd));
+        beginRender();
+    }
+}
+
+void Renderer::stopVoicePreview(int note) {
+    if (mStream.isEnabled()) {
+        postCommand({ Command::Type::stopVoicePreview, note });
     }
 }
 
 void Renderer::waveformPreview(int note, int waveId) {
     if (mStream.isEnabled()) {
-        auto ctx = mContext.access();
-        switch (ctx->previewState) {
-            case PreviewState::instrument:
-            case PreviewState::waveform:
-                resetPreview(ctx);
-                [[fallthrough]];
-            case PreviewState::none:
-                ctx->previewState = PreviewState::waveform;
-                ctx->previewChannel = trackerboy::ChType::ch3;
-                // unlock the channel, no longer effected by music
-                ctx->engine.unlock(trackerboy::ChType::ch3);
-
-                trackerboy::ChannelState state(trackerboy::ChType::ch3);
-                state.playing = true;
-                state.frequency = trackerboy::lookupToneNote(note);
-                state.envelope = (uint8_t)waveId;
-                trackerboy::ChannelControl<trackerboy::ChType::ch3>::init(
-                    ctx->apu, ctx->mod.data().waveformTable(), state
-                );
-                break;
+        postCommand({ Command::Type::waveformPreview, note, waveId });
+        beginRender();
+    }
+}
+
+void Renderer::setMidiPreview(int track, int instrumentId) {
+    Command cmd(Command::Type::midiPreview, track, instrumentId);
+    if (instrumentId != -1) {
+        cmd.instrument = mContext.mod.data().instrumentTable().getShared((uint8_t)instrumentId);
+    }
+    postCommand(std::move(cmd));
+}
+
+void Renderer::setMidiInputOpen(bool open) {
+    mMidiHold = open;
+    postCommand({ Command::Type::midiHold, open });
+    if (open && mStream.isEnabled()) {
+        beginRender();
+    }
+}
+
+bool Renderer::midiMessage(Message const& msg) {
+    // MIDI input thread
+
+    if (msg.type == Message::Type::clock && mState.load() != State::running) {
+        // there is nothing to sync when not rendering, and clocks shouldn't
+        // keep the GUI thread busy
+        return true;
+    }
+
+    if (!mMidiQueue.push(msg)) {
+        return false;
+    }
+
+    if (mState.load() == State::running) {
+        // the render thread drains the queue, in the clock mode it can do so
+        // now instead of at the next deadline. Harmless in the other modes,
+        // the clock's thread isn't running
+        if (msg.type != Message::Type::clock) {
+            mClock.wake();
+        }
+    } else if (!mMidiStartPending.exchange(true)) {
+        // no period will drain the queue, get the GUI thread to start one.
+        // Only happens when no MIDI input is open or the render stopped
+        // from a device error
+        QMetaObject::invokeMethod(this, &Renderer::startMidiRender, Qt::QueuedConnection);
+    }
+    return true;
+}
+
+void Renderer::startMidiRender() {
+    mMidiStartPending = false;
+
+    if (mState != State::stopped) {
+        // cancels the stop, if stopping
+        beginRender();
+    } else if (mStream.isEnabled()) {
+        // the context is ours, apply the messages here and only start the
+        // render if there is something to hear
+        do {
+            receiveMidi();
+            applyMidi(std::numeric_limits<long>::max());
+        } while (!mMidiQueue.isEmpty());
+
+        if (mContext.previewState != PreviewState::none || mContext.midiTransport.playing) {
+            beginRender();
         }
-        beginRender(ctx);
+    } else {
+        // nothing will render these, discard
+        IMidiSink::Message msg;
+        while (mMidiQueue.pop(msg));
+        mContext.midiPendingCount = 0;
     }
 }
 
 void Renderer::updateFramerate() {
-    auto ctx = mContext.access();
-    ctx->synth.setFramerate(ctx->mod.data().framerate());
-    ctx->synth.setupBuffers();
+    postCommand({ Command::Type::updateFramerate });
 }
 
 void Renderer::stopPreview() {
 
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        if (handle->previewState != PreviewState::none) {
-            resetPreview(handle);
-        }
+        postCommand({ Command::Type::stopPreview });
     }
     
 }
@@ -442,225 +992,748 @@ void Renderer::stopPreview() {
 void Renderer::stopMusic() {
     
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        _stopMusic(handle);
+        mStepping = false;
+        cancelSeek();
+        postCommand({ Command::Type::stopMusic });
     }
 
 }
 
-void Renderer::_stopMusic(Handle &handle) {
-    handle->engine.halt();
-    handle->stepping = false;
-}
-
 void Renderer::forceStop() {
 
+    cancelSeek();
     if (mStream.isEnabled()) {
-        auto handle = mContext.access();
-        if (handle->state != State::stopped) {
-            resetPreview(handle);
-            handle->engine.halt();
-            handle->stepping = false;
-            stopRender(handle);
+        if (mState != State::stopped) {
+            mStepping = false;
+            // these get executed by stopRender if the render thread doesn't get to them
+            postCommand({ Command::Type::stopPreview });
+            postCommand({ Command::Type::stopMusic });
+            stopRender();
+            // don't resume previewing MIDI notes received before the stop
+            mContext.midiPendingCount = 0;
+            if (mMidiHold) {
+                // keep listening
+                beginRender();
+            }
+        }
+    }
+}
+
+void Renderer::_play(int orderNo, int rowNo, bool stepping) {
+
+    mContext.stepping = stepping;
+    mContext.playback->engine.play(orderNo, rowNo);
+    _setChannelOutput(mContext.outputFlags);
+    mContext.step = stepping;
+
+}
+
+void Renderer::_playSeeked(std::shared_ptr<Playback> &&playback, trackerboy::Frame const& frame, bool stepping) {
+    auto &ctx = mContext;
+
+    std::swap(ctx.playback, playback);
+    // the replaced playback is freed by the GUI thread. If the queue is
+    // somehow full it is freed here instead, along with the command
+    mRetiredPlayback.push(std::move(playback));
+
+    auto &engine = ctx.playback->engine;
+    engine.repeatPattern(ctx.patternRepeat);
+
+    // continue previews on the new APU, the waveform is lost with the old one
+    if (ctx.previewState == PreviewState::waveform) {
+        resetPreview();
+    }
+    for (size_t i = 0; i < ctx.voices.size(); ++i) {
+        auto &voice = ctx.voices[i];
+        if (voice.note != -1) {
+            engine.unlock(static_cast<trackerboy::ChType>(i));
+            voice.ip.play((uint8_t)voice.note);
         }
     }
+
+    ctx.stepping = stepping;
+    // the first row has already been stepped
+    ctx.step = false;
+    ctx.currentEngineFrame = frame;
 }
 
-void Renderer::_play(Handle &handle, int orderNo, int rowNo, bool stepping) {
+void Renderer::startVoice(uint8_t note, int track, std::shared_ptr<const trackerboy::Instrument> instrument, bool midi) {
+    auto &ctx = mContext;
 
-    handle->engine.play(orderNo, rowNo);
-    _setChannelOutput(handle, mOutputFlags);
-    handle->stepping = stepping;
-    handle->step = stepping;
-    beginRender(handle);
+    if (ctx.previewState == PreviewState::waveform) {
+        resetPreview();
+    }
 
+    trackerboy::ChType preferred;
+    if (track == -1) {
+        // instrument preview
+        Q_ASSERT(instrument != nullptr); // must have an instrument
+        preferred = instrument->channel();
+    } else {
+        // note preview
+        preferred = static_cast<trackerboy::ChType>(track);
+    }
+
+    // CH1 and CH2 are both pulse channels and can take each other's notes,
+    // CH3 and CH4 can only preview on themselves
+    auto const first = static_cast<int>(preferred);
+    auto const candidates = first <= 1 ? 2 : 1;
+
+    // retrigger a voice already previewing this note, otherwise use a free
+    // voice, otherwise reuse the oldest
+    int chosen = -1;
+    for (int i = 0; i < candidates; ++i) {
+        if (ctx.voices[first ^ i].note == note) {
+            chosen = first ^ i;
+            break;
+        }
+    }
+    if (chosen == -1) {
+        for (int i = 0; i < candidates; ++i) {
+            auto const ch = first ^ i;
+            if (ctx.voices[ch].note == -1) {
+                chosen = ch;
+                break;
+            }
+            if (chosen == -1 || ctx.voices[ch].age < ctx.voices[chosen].age) {
+                chosen = ch;
+            }
+        }
+    }
+
+    auto &voice = ctx.voices[chosen];
+    auto const channel = static_cast<trackerboy::ChType>(chosen);
+    voice.ip.setInstrument(std::move(instrument), channel);
+    voice.note = note;
+    voice.age = ++ctx.voiceAge;
+    voice.midi = midi;
+
+    ctx.previewState = PreviewState::instrument;
+    // unlock the channel for preview
+    ctx.playback->engine.unlock(channel);
+    voice.ip.play(note);
 }
 
-void Renderer::resetPreview(Handle &handle) {
-    // lock the channel so it can be used for music
-    handle->engine.lock(handle->previewChannel);
-    handle->ip.setInstrument(nullptr);
-    handle->previewState = PreviewState::none;
+void Renderer::stopVoice(int note) {
+    auto &ctx = mContext;
+
+    if (ctx.previewState != PreviewState::instrument) {
+        return;
+    }
+
+    bool active = false;
+    for (size_t i = 0; i < ctx.voices.size(); ++i) {
+        auto &voice = ctx.voices[i];
+        if (voice.note == -1) {
+            continue;
+        }
+        if (note == -1 || voice.note == note) {
+            // lock the channel so it can be used for music
+            ctx.playback->engine.lock(static_cast<trackerboy::ChType>(i));
+            voice.ip.setInstrument(nullptr);
+            voice.note = -1;
+        } else {
+            active = true;
+        }
+    }
+
+    if (!active) {
+        ctx.previewState = PreviewState::none;
+    }
+}
+
+void Renderer::resetPreview() {
+    if (mContext.previewState == PreviewState::waveform) {
+        // lock the channel so it can be used for music
+        mContext.playback->engine.lock(trackerboy::ChType::ch3);
+        mContext.previewState = PreviewState::none;
+    } else {
+        stopVoice(-1);
+    }
+}
+
+void Renderer::receiveMidi() {
+    auto &ctx = mContext;
+
+    auto const samplerate = ctx.playback->synth.samplerate();
+    auto const maxOffset = std::lround(TU::MIDI_MAX_DELAY * samplerate);
+
+    IMidiSink::Message msg;
+    while (ctx.midiPendingCount < ctx.midiPending.size() && mMidiQueue.pop(msg)) {
+        if (msg.type == IMidiSink::Message::Type::clock && ctx.midiPendingCount == 0) {
+            // clocks carry their own timestamp, there is no need to schedule
+            // them unless they must be kept in order with pending messages.
+            // They also shouldn't keep the render from stopping
+            midiClock(msg.time);
+            continue;
+        }
+
+        long offset;
+        if (ctx.midiPendingCount == 0) {
+            // start of a burst, apply right away
+            ctx.midiBaseTime = msg.time;
+            ctx.midiBaseOffset = 0;
+            offset = 0;
+        } else {
+            offset = ctx.midiBaseOffset + std::lround((msg.time - ctx.midiBaseTime) * samplerate);
+            offset = std::clamp(offset, 0L, maxOffset);
+        }
+        ctx.midiPending[ctx.midiPendingCount++] = { msg, offset };
+    }
+
+    if (ctx.midiPendingCount) {
+        // cancel a pending stop, we have work to do
+        ctx.stopCounter = 0;
+    }
+}
+
+void Renderer::applyMidi(long position) {
+    auto &ctx = mContext;
+
+    size_t applied = 0;
+    for (; applied < ctx.midiPendingCount; ++applied) {
+        auto const& pending = ctx.midiPending[applied];
+        if (pending.offset > position) {
+            break;
+        }
+        applyMidiMessage(pending.msg);
+    }
+
+    if (applied) {
+        std::copy(
+            ctx.midiPending.begin() + applied,
+            ctx.midiPending.begin() + ctx.midiPendingCount,
+            ctx.midiPending.begin()
+        );
+        ctx.midiPendingCount -= applied;
+    }
+}
+
+void Renderer::applyMidiMessage(IMidiSink::Message const& msg) {
+    auto &ctx = mContext;
+
+    using Type = IMidiSink::Message::Type;
+    switch (msg.type) {
+        case Type::noteOff:
+            if (ctx.midiTrack != -1) {
+                stopVoice(msg.note);
+            }
+            break;
+        case Type::noteOn:
+            if (ctx.midiTrack != -1) {
+                // copy the instrument, it is shared by every voice started by MIDI
+                startVoice(msg.note, ctx.midiTrack, ctx.midiInstrument, true);
+            }
+            break;
+        case Type::controller:
+            switch (msg.controller) {
+                case TU::MIDI_CC_MODULATION:
+                    ctx.midiModulation = msg.value / 127.0;
+                    break;
+                case TU::MIDI_CC_ALL_SOUND_OFF:
+                case TU::MIDI_CC_ALL_NOTES_OFF:
+                    stopVoice(-1);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        case Type::pitchBend:
+            ctx.midiBend = msg.value * TU::MIDI_BEND_RANGE / 8192.0;
+            break;
+        case Type::clock:
+            midiClock(msg.time);
+            break;
+        case Type::start:
+            ctx.midiTransport.songPosition = 0;
+            startMidiSync();
+            break;
+        case Type::resume:
+            startMidiSync();
+            break;
+        case Type::stop:
+            ctx.playback->engine.halt();
+            ctx.stepping = false;
+            stopMidiSync();
+            break;
+        case Type::songPosition:
+            ctx.midiTransport.songPosition = msg.value;
+            break;
+    }
+}
+
+void Renderer::applyMidiPitch() {
+    auto &ctx = mContext;
+
+    auto offset = ctx.midiBend;
+    if (ctx.midiModulation > 0.0) {
+        auto const phase = (double)(ctx.midiVibratoTimer++ % TU::MIDI_VIBRATO_PERIOD) / TU::MIDI_VIBRATO_PERIOD;
+        offset += std::sin(phase * TU::TAU) * TU::MIDI_VIBRATO_DEPTH * ctx.midiModulation;
+    } else {
+        ctx.midiVibratoTimer = 0;
+    }
+
+    if (offset == 0.0 && !ctx.midiPitchApplied) {
+        // leave the frequency set by the instrument alone
+        return;
+    }
+    // when the offset returns to 0, the unbent frequency is written once
+    ctx.midiPitchApplied = offset != 0.0;
+
+    for (int ch = 0; ch < 3; ++ch) {
+        auto const& voice = ctx.voices[ch];
+        if (voice.note == -1 || !voice.midi) {
+            // notes previewed from the GUI keep their pitch
+            continue;
+        }
+        auto &apu = ctx.playback->apu;
+        auto const freq = TU::bendFrequency((uint8_t)voice.note, offset);
+        auto const lengthEnable = apu.readRegister(TU::FREQ_REGS[ch][1]) & TU::NRX4_LENGTH_ENABLE;
+        apu.writeRegister(TU::FREQ_REGS[ch][0], (uint8_t)(freq & 0xFF));
+        apu.writeRegister(TU::FREQ_REGS[ch][1], (uint8_t)(lengthEnable | (freq >> 8)));
+    }
+}
+
+void Renderer::startMidiSync() {
+    auto &ctx = mContext;
+    auto &transport = ctx.midiTransport;
+
+    if (!ctx.song) {
+        return;
+    }
+
+    int patternSize;
+    int patterns;
+    {
+        QMutexLocker locker(&ctx.mod.mutex());
+        transport.rowsPerBeat = ctx.song->rowsPerBeat();
+        patternSize = ctx.song->patterns().length();
+        patterns = (int)ctx.song->order().size();
+    }
+
+    // a MIDI beat is a 16th note
+    auto const row = transport.songPosition * transport.rowsPerBeat / 4;
+    auto pattern = row / patternSize;
+    if (pattern >= patterns) {
+        // past the end of the song
+        pattern = 0;
+    }
+    _play(pattern, row % patternSize);
+
+    transport.playing = true;
+    transport.clocks = 0;
+    transport.expectedFrames = 0.0;
+    transport.frames = 0;
+    transport.lastClock = -1.0;
+    transport.clockInterval = 0.0;
+    transport.rate = 1.0;
+    transport.phase = 0.0;
+}
+
+void Renderer::stopMidiSync() {
+    auto &transport = mContext.midiTransport;
+    transport.playing = false;
+    transport.rate = 1.0;
+    transport.phase = 0.0;
+}
+
+void Renderer::midiClock(double time) {
+    auto &ctx = mContext;
+    auto &transport = ctx.midiTransport;
+
+    if (!transport.playing) {
+        return;
+    }
+
+    if (transport.lastClock >= 0.0) {
+        auto const interval = time - transport.lastClock;
+        if (interval > 0.0 && interval < TU::MIDI_CLOCK_TIMEOUT) {
+            if (transport.clockInterval == 0.0) {
+                transport.clockInterval = interval;
+            } else {
+                transport.clockInterval += (interval - transport.clockInterval) * TU::MIDI_CLOCK_SMOOTHING;
+            }
+        }
+    }
+    transport.lastClock = time;
+
+    // engine frames that make up a clock at the song's current speed
+    auto const framesPerClock = trackerboy::speedToFloat(ctx.currentEngineFrame.speed)
+        * transport.rowsPerBeat / TU::MIDI_CLOCKS_PER_BEAT;
+    // the first clock after a start marks the start of the song position
+    if (transport.clocks++ > 0) {
+        transport.expectedFrames += framesPerClock;
+    }
+
+    if (transport.clockInterval == 0.0) {
+        // no tempo yet
+        return;
+    }
+
+    // match the clock's tempo, then correct for the frames we have drifted
+    // from where the sequencer is
+    auto const tempoRate = framesPerClock / transport.clockInterval / ctx.framerate;
+    auto const drift = transport.expectedFrames - transport.frames;
+    auto const correction = std::clamp(drift * TU::MIDI_DRIFT_GAIN, -TU::MIDI_DRIFT_MAX, TU::MIDI_DRIFT_MAX);
+    transport.rate = std::clamp(tempoRate * (1.0 + correction), TU::MIDI_RATE_MIN, TU::MIDI_RATE_MAX);
 }
 
 void Renderer::resetGlobalVolume() {
-    auto ctx = mContext.access();
-    ctx->apu.writeRegister(trackerboy::IApuIo::REG_NR50, 0x77);
+    postCommand({ Command::Type::resetGlobalVolume });
 }
 
  void Renderer::setChannelOutput(ChannelOutput::Flags flags) {
      mOutputFlags = flags;
-     auto ctx = mContext.access();
-     _setChannelOutput(ctx, flags);
+     postCommand({ Command::Type::channelOutput, flags.toInt() });
  }
 
- void Renderer::_setChannelOutput(Handle &handle, ChannelOutput::Flags flags) {
-     int flag = ChannelOutput::CH1;
-     for (int i = 0; i < 4; ++i) {
-         auto ch = static_cast<trackerboy::ChType>(i);
-         if (flags.testFlag((ChannelOutput::Flag)(flag))) {
-             handle->engine.lock(ch);
-         } else {
-             // channel is disabled, keep unlocked
-             handle->engine.unlock(ch);
-         }
-         flag <<= 1;
-     }
+ void Renderer::_setChannelOutput(ChannelOutput::Flags flags) {
+     TU::lockOutputChannels(mContext.playback->engine, flags);
  }
 
+void Renderer::startClock() {
+    switch (mRenderMode) {
+        case SoundConfig::RenderMode::push:
+            mTimer->start();
+            break;
+        case SoundConfig::RenderMode::clock:
+            mClock.start();
+            break;
+        default:
+            // the device's callback renders
+            break;
+    }
+}
+
+void Renderer::stopClock() {
+    // safe to call from the render thread
+    switch (mRenderMode) {
+        case SoundConfig::RenderMode::push:
+            mTimer->stop();
+            break;
+        case SoundConfig::RenderMode::clock:
+            mClock.stop();
+            break;
+        default:
+            break;
+    }
+}
+
+void Renderer::recordJitter(Clock::duration jitter) {
+    if (jitter < Clock::duration::zero()) {
+        jitter = -jitter;
+    }
+    auto const us = std::chrono::duration_cast<std::chrono::microseconds>(jitter).count();
+
+    int bin = 0;
+    while (bin < JitterStats::BINS - 1 && us >= JitterStats::BIN_LIMITS[bin]) {
+        ++bin;
+    }
+    mJitterCounts[bin].fetch_add(1, std::memory_order_relaxed);
+
+    // the render thread is the only writer
+    if (jitter.count() > mJitterMax.load(std::memory_order_relaxed)) {
+        mJitterMax.store(jitter.count(), std::memory_order_relaxed);
+    }
+}
+
+void Renderer::wakeCallback(void *userData) {
+    // called by AudioStream in the device's thread when the buffer runs low
+    static_cast<Renderer*>(userData)->mClock.wake();
+}
+
 void Renderer::timerCallback(void *userData) {
     // called by FastTimer 
     static_cast<Renderer*>(userData)->render();
 }
 
+void Renderer::clockThreadInit(void *userData) {
+    auto renderer = static_cast<Renderer*>(userData);
+    renderer->setSchedulingStatus(ThreadScheduling::applyToCurrentThread(renderer->mSchedOptions));
+}
+
+void Renderer::renderCallback(void *userData, float *out, size_t frames) {
+    // called by AudioStream in the device's thread
+    static_cast<Renderer*>(userData)->renderPull(out, frames);
+}
+
 // this is the number of frames to output before stopping playback
 // (prevents a hard pop noise that may occur when stopping abruptly, as
 // the high pass filter will decay the signal to 0)
 constexpr int STOP_FRAMES = 5;
 
+size_t Renderer::synthesize(float *dest, size_t frames, trackerboy::Frame &frame, bool &newFrame) {
+    auto &ctx = mContext;
+    // cache a ref to the apu, we'll be using it often
+    auto &apu = ctx.playback->apu;
+
+    size_t written = 0;
+    while (written < frames) {
+
+        if (apu.samplesAvailable() == 0) {
+            // new frame
+
+            if (mState == State::stopping) {
+                break; // stop, don't render any more
+            }
+
+            if (ctx.stopCounter) {
+                if (--ctx.stopCounter == 0) {
+                    auto expected = State::running;
+                    if (mState.compare_exchange_strong(expected, State::stopping)) {
+                        mStream.setDraining(true);
+                    }
+                }
+            } else {
+                newFrame = true;
+
+                applyMidi((long)(ctx.writesSinceLastPeriod + written));
+
+                // the engine and previewer have read access to the module
+                // so the document must be locked when stepping
+
+                // step engine/previewer
+                if (!ctx.stepping || ctx.step) {
+
+                    // the engine is normally stepped once per frame, when
+                    // synced to a MIDI clock it may be stepped more or less
+                    int steps = 1;
+                    auto &transport = ctx.midiTransport;
+                    if (transport.playing) {
+                        transport.phase += transport.rate;
+                        steps = (int)transport.phase;
+                        transport.phase -= steps;
+                        transport.frames += steps;
+                    }
+
+                    bool newRow = false;
+                    bool newPattern = false;
+                    {
+                        QMutexLocker locker(&ctx.mod.mutex());
+                        for (int i = 0; i < steps; ++i) {
+                            ctx.playback->engine.step(frame);
+                            newRow |= frame.startedNewRow;
+                            newPattern |= frame.startedNewPattern;
+                        }
+                    }
+                    frame.startedNewRow = newRow;
+                    frame.startedNewPattern = newPattern;
+                    
+                    if (frame.startedNewRow) {
+                        ctx.step = false;
+                    }
+                }
+
+                if (ctx.previewState == PreviewState::instrument) {
+                    auto &mod = ctx.mod.data();
+                    trackerboy::RuntimeContext rc(apu, mod.instrumentTable(), mod.waveformTable());
+                    
+                    // all voices are stepped under a single lock
+                    {
+                        QMutexLocker locker(&ctx.mod.mutex());
+                        for (auto &voice : ctx.voices) {
+                            if (voice.note != -1) {
+                                voice.ip.step(rc);
+                            }
+                        }
+                    }
+                    applyMidiPitch();
+                }
+
+
+                if (frame.halted && ctx.previewState == PreviewState::none && ctx.midiPendingCount == 0 && !ctx.midiHold) {
+                    // no longer doing anything, start the stop counter
+                    ctx.stopCounter = STOP_FRAMES;
+                }
+
+            }
+
+            ctx.playback->synth.run();
+
+        }
+
+        size_t toWrite = std::min(frames - written, apu.samplesAvailable());
+        auto writePtr = dest + (written * 2);
+
+        // read from the apu to the destination
+        apu.readSamples(writePtr, toWrite);
+        // send a copy to the visualizer buffer as well
+        ctx.visBuffer.write(writePtr, toWrite);
+
+        written += toWrite;
+    }
+
+    ctx.writesSinceLastPeriod += written;
+    return written;
+}
+
 void Renderer::render() {
     // This function is called from a separate thread!
-    // FastTimer lives in its own thread and calls this function via the timer callback
+    // FastTimer lives in its own thread and calls this function via the timer
+    // callback, or RenderClock calls it from its thread in the clock mode
     
     auto now = Clock::now();
 
-    auto handle = mContext.access();
+    // apply any changes requested by the GUI
+    drainCommands();
 
-    if (handle->state == State::stopped) {
+    if (mState == State::stopped) {
         return;
     }
 
+    receiveMidi();
 
-    // diagnostics
-    handle->periodTime = now - handle->lastPeriod;
-    handle->lastPeriod = now;
-    handle->writesSinceLastPeriod = 0;
+    auto &ctx = mContext;
 
+    // diagnostics
+    ctx.periodTime = now - ctx.lastPeriod;
+    ctx.lastPeriod = now;
+    ctx.writesSinceLastPeriod = 0;
+    if (ctx.renderMode == SoundConfig::RenderMode::clock) {
+        recordJitter(mClock.lateness());
+    } else {
+        recordJitter(ctx.periodTime - ctx.period);
+    }
 
     auto writer = mStream.writer();
     auto framesToRender = writer.availableWrite();
 
     if (framesToRender) {
         // reset the watchdog
-        handle->watchdog = now;
+        ctx.watchdog = now;
     } else {
         constexpr auto WATCHDOG_INTERVAL = std::chrono::seconds(1);
-        auto timeSinceLastWatchdogReset = now - handle->watchdog;
+        auto timeSinceLastWatchdogReset = now - ctx.watchdog;
+        publishStatus();
         if (timeSinceLastWatchdogReset >= WATCHDOG_INTERVAL) {
             // we have gone 1 second without renderering anything
             // abort the render
-            handle.unlock();
-            stopRender(handle, true);
+            stopClock();
+            QMetaObject::invokeMethod(this, [this]() { finishRender(true); }, Qt::QueuedConnection);
         }
         // no frames to render, exit early
         return;
     }
 
+    if (mState == State::stopping) {
+        if (framesToRender == ctx.bufferSize) {
+            // the buffer has been drained, stop the callback and let
+            // the GUI thread finish the stop
+            publishStatus();
+            stopClock();
+            QMetaObject::invokeMethod(this, [this]() { finishRender(false); }, Qt::QueuedConnection);
+        }
+        return;
+    }
+
     
-    auto frame = handle->currentEngineFrame;
+    auto frame = ctx.currentEngineFrame;
     auto const haltedBefore = frame.halted;
 
-    // cache a ref to the apu, we'll be using it often
-    auto &apu = handle->apu;
-
     bool newFrame = false;
 
-    auto visHandle = mVisBuffer.access();
-    visHandle->beginWrite(framesToRender);
-
+    ctx.visBuffer.beginWrite(framesToRender);
     while (framesToRender) {
+        // the writable region may be smaller than requested if it wraps
+        size_t count = framesToRender;
+        auto writePtr = writer.acquireWrite(count);
+        count = synthesize(writePtr, count, frame, newFrame);
+        writer.commitWrite(count);
+
+        if (count == 0) {
+            // stopping, wait for the buffer to drain
+            break;
+        }
+        framesToRender -= count;
+    }
 
-        if (handle->state == State::stopping) {
-            if (writer.availableWrite() == handle->bufferSize) {
-                // the buffer has been drained, stop the callback
-                visHandle.unlock();
-                stopRender(handle);
-            }
-            return;
+    endPeriod(frame, haltedBefore, newFrame);
 
-        } else {
+}
 
-            if (apu.samplesAvailable() == 0) {
-                // new frame
+void Renderer::renderPull(float *out, size_t frames) {
+    // This function is called from the device's thread!
 
-                if (handle->state == State::stopping) {
-                    break; // stop, don't render any more
-                }
+    auto now = Clock::now();
 
-                if (handle->stopCounter) {
-                    if (--handle->stopCounter == 0) {
-                        handle->state = State::stopping;
-                        mStream.setDraining(true);
-                    }
-                } else {
-                    newFrame = true;
-
-                    // the engine and previewer have read access to the module
-                    // so the document must be locked when stepping
-
-                    // step engine/previewer
-                    if (!handle->stepping || handle->step) {
-                        
-                        {
-                            QMutexLocker locker(&handle->mod.mutex());
-                            handle->engine.step(frame);
-                        }
-                        
-                        if (frame.startedNewRow) {
-                            handle->step = false;
-                        }
-                    }
+    drainCommands();
 
-                    if (handle->previewState == PreviewState::instrument) {
-                        auto &mod = handle->mod.data();
-                        trackerboy::RuntimeContext rc(apu, mod.instrumentTable(), mod.waveformTable());
-                        
-                        {
-                            QMutexLocker locker(&handle->mod.mutex());
-                            handle->ip.step(rc);
-                        }
-                    }
+    if (mState == State::stopped) {
+        // output silence until the GUI thread stops the stream
+        return;
+    }
 
+    receiveMidi();
 
-                    if (frame.halted && handle->previewState == PreviewState::none) {
-                        // no longer doing anything, start the stop counter
-                        handle->stopCounter = STOP_FRAMES;
-                    }
+    auto &ctx = mContext;
 
-                }
+    ctx.periodTime = now - ctx.lastPeriod;
+    ctx.lastPeriod = now;
+    ctx.writesSinceLastPeriod = 0;
+    // the device should call us every frames samples
+    recordJitter(ctx.periodTime - std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>((double)frames / ctx.playback->synth.samplerate())
+    ));
+
+    auto frame = ctx.currentEngineFrame;
+    auto const haltedBefore = frame.halted;
+
+    bool newFrame = false;
+    ctx.visBuffer.beginWrite(frames);
+    auto const written = synthesize(out, frames, frame, newFrame);
+
+    if (written == 0 && mState == State::stopping && !ctx.stopRequested) {
+        // the last of the audio has been sent to the device, the rest of the
+        // stop must be done in the GUI thread
+        ctx.stopRequested = true;
+        QMetaObject::invokeMethod(this, [this]() { finishRender(false); }, Qt::QueuedConnection);
+    }
 
-                handle->synth.run();
+    endPeriod(frame, haltedBefore, newFrame);
+}
 
-            }
+void Renderer::publishVisualizers() {
+    // the envelope is computed here once per period, instead of by the scope
+    // for every paint
+    auto const width = mScopeWidth.load(std::memory_order_relaxed);
+    mContext.visBuffer.snapshot(width, mVisSnapshot.back());
+    mVisSnapshot.publish();
+}
 
-            size_t toWrite = std::min(framesToRender, apu.samplesAvailable());
-            auto writePtr = writer.acquireWrite(toWrite);
-            
-            // read from the apu to the ringbuffer
-            apu.readSamples(writePtr, toWrite);
-            // send a copy to the visualizer buffer as well
-            visHandle->write(writePtr, toWrite);
-            
-            writer.commitWrite(toWrite);
-            
-            handle->writesSinceLastPeriod += toWrite;
-            framesToRender -= toWrite;
+void Renderer::endPeriod(trackerboy::Frame const& frame, bool haltedBefore, bool newFrame) {
+    auto &ctx = mContext;
 
-        }
+    // pending MIDI messages are now relative to the next period
+    auto const written = (long)ctx.writesSinceLastPeriod;
+    for (size_t i = 0; i < ctx.midiPendingCount; ++i) {
+        ctx.midiPending[i].offset -= written;
+    }
+    ctx.midiBaseOffset -= written;
 
+    if (newFrame) {
+        ctx.currentEngineFrame = frame;
     }
+    publishStatus();
 
-    if (handle->writesSinceLastPeriod) {
+    if (ctx.writesSinceLastPeriod) {
+        publishVisualizers();
         emit updateVisualizers();
     }
 
     if (newFrame) {
-        handle->currentEngineFrame = frame;
-        handle.unlock(); // always unlock before emitting signals
         if (haltedBefore != frame.halted) {
             emit isPlayingChanged(!frame.halted);
         }
         emit frameSync();
     }
+}
 
+void Renderer::publishStatus() {
+    auto &status = mStatus.back();
+    status.frame = mContext.currentEngineFrame;
+    status.writesSinceLastPeriod = mContext.writesSinceLastPeriod;
+    status.periodTime = mContext.periodTime;
+    mStatus.publish();
 }
+
+#undef TU
@@ -3,12 +3,16 @@
 
 #include "audio/AudioStream.hpp"
 #include "audio/AudioEnumerator.hpp"
+#include "audio/RenderClock.hpp"
+#include "audio/ThreadScheduling.hpp"
 #include "audio/VisualizerBuffer.hpp"
 #include "config/data/SoundConfig.hpp"
 #include "core/ChannelOutput.hpp"
 #include "utils/FastTimer.hpp"
 #include "core/Module.hpp"
-#include "utils/Guarded.hpp"
+#include "midi/IMidiSink.hpp"
+#include "utils/SpscQueue.hpp"
+#include "utils/TripleBuffer.hpp"
 
 #include "trackerboy/apu/DefaultApu.hpp"
 #include "trackerboy/data/Song.hpp"
@@ -19,16 +23,28 @@
 #include "trackerboy/Synth.hpp"
 #include "trackerboy/note.hpp"
 
+#include <QMutex>
 #include <QObject>
 #include <QThread>
+#include <QThreadPool>
 
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <memory>
 
 //
 // Class handles all sound renderering. Sound is sent to the
 // configured device set in Config.
 //
-class Renderer : public QObject {
+// Unless otherwise noted, all methods must be called from the GUI thread.
+//
+// As an IMidiSink, the renderer previews MIDI notes without going through the
+// GUI thread. Messages are queued for the render thread and applied at frame
+// boundaries, keeping the spacing they were received with. While a MIDI input
+// is open the render is kept running, see setMidiInputOpen.
+//
+class Renderer : public QObject, public IMidiSink {
 
     Q_OBJECT
 
@@ -45,6 +61,24 @@ public:
         int writesSinceLastPeriod;
         // duration of the last period, in milliseconds
         double lastPeriodMs;
+        // estimated time, in milliseconds, for synthesized audio to reach
+        // the output device
+        double latencyMs;
+    };
+
+    //
+    // Histogram of the render period jitter, how far each period started from
+    // when it should have. For the clock render mode, this is the render
+    // thread's wake up latency.
+    //
+    struct JitterStats {
+        static constexpr int BINS = 8;
+        // upper limit of each bin, in microseconds. The last bin has no limit
+        static constexpr long BIN_LIMITS[BINS - 1] = { 100, 250, 500, 1000, 2000, 5000, 10000 };
+
+        unsigned counts[BINS];
+        // largest jitter recorded, in milliseconds
+        double maxMs;
     };
 
     explicit Renderer(Module &mod, QObject *parent = nullptr);
@@ -59,10 +93,15 @@ public:
     unsigned statUnderruns() const;
 
     //
-    // Gets the current buffer statistics.
+    // Gets the buffer statistics from the last completed period.
     //
     BufferStats statBuffer();
 
+    //
+    // Gets the period jitter histogram. Cleared by clearDiagnostics().
+    //
+    JitterStats statJitter() const;
+
     //
     // Gets the elapsed time, in milliseconds, of the current render. Behavior
     // is undefined when isRunning() is false.
@@ -75,10 +114,29 @@ public:
     int samplerate();
 
     //
-    // Accessor for the visualizer buffer. The updateVisualizers() signal is
-    // emitted when this buffer is modified.
+    // Gets the render mode from the last applied config
     //
-    Guarded<VisualizerBuffer>& visualizerBuffer();
+    SoundConfig::RenderMode renderMode() const;
+
+    //
+    // Gets the result of applying the scheduling options from the last
+    // applied config to the render thread. For the clock render mode, the
+    // options are applied each time the render thread starts.
+    //
+    ThreadScheduling::Status schedulingStatus();
+
+    //
+    // Accessor for the visualizer snapshot, published at the end of every
+    // period and followed by the updateVisualizers() signal. Reading never
+    // blocks the renderer. Only one consumer (in the GUI thread) may read
+    // from it.
+    //
+    TripleBuffer<VisualizerBuffer::Snapshot>& visualizerSnapshot();
+
+    //
+    // Sets the number of columns to compute for the scope envelope.
+    //
+    void setScopeWidth(int width);
 
     //
     // Determines if the renderer is renderering sound.
@@ -96,7 +154,8 @@ public:
     bool isPlaying();
 
     //
-    // Gets a copy of the current engine frame.
+    // Gets a copy of the engine frame that was last published by the render
+    // thread.
     //
     trackerboy::Frame currentFrame();
 
@@ -120,12 +179,50 @@ public:
     //
     void instrumentPreview(int note, int track, int instrument);
 
+    //
+    // Begins previewing a note on a new voice, without stopping previews of
+    // other notes. Arguments are the same as instrumentPreview. The voice is
+    // given a channel compatible with the track or instrument that is not
+    // previewing another note, if there are none the oldest voice is reused.
+    //
+    void voicePreview(int note, int track, int instrument);
+
+    //
+    // Stops the voice previewing the given note, or all voices if note is -1.
+    //
+    void stopVoicePreview(int note);
+
     //
     // Begins renderering a waveform preview. CH3 is unlocked and loaded with
     // the given waveform using the waveId.
     //
     void waveformPreview(int note, int waveId);
 
+    //
+    // Sets the track (0-3) and instrument (-1 for none) to preview notes
+    // received as an IMidiSink with. A track of -1 ignores all MIDI notes.
+    //
+    void setMidiPreview(int track, int instrument);
+
+    //
+    // Keeps the render running while a MIDI input is open, outputting silence
+    // when there is nothing to play, so that received messages never need
+    // the GUI thread to start a render. Call with false once the input is
+    // closed to let the render stop when idle.
+    //
+    void setMidiInputOpen(bool open);
+
+    //
+    // IMidiSink implementation, called from the MIDI input thread. Messages
+    // are queued for the render thread, which is woken right away in the
+    // clock render mode. If the render is not running (ie no MIDI input is
+    // open, or the device failed), the GUI thread is asked to start it.
+    // Each note is previewed with its own voice. Pitch bend and the mod wheel
+    // change the pitch of the voices started by MIDI, and the transport messages control
+    // music playback, following the tempo of the MIDI clock.
+    //
+    virtual bool midiMessage(Message const& msg) override;
+
     //
     // Update the framerate used by the synth. Call this when the module's framerate
     // changes.
@@ -147,6 +244,12 @@ public:
     // Begin playing music from the current pattern and row. stepmode determines
     // if the renderer will "step" rows.
     //
+    // When starting past the first pattern, the engine state is found on a
+    // worker thread and playback begins once it is ready. If the song's index
+    // is not built yet, or the seek fails, playback starts without the state
+    // of the patterns before it, and the index is built in the background for
+    // the next play.
+    //
     void play(int pattern, int row, bool stepmode);
 
     //
@@ -237,6 +340,37 @@ private:
         instrument
     };
 
+    //
+    // The APU, synthesizer and engine used for playback. A seek prepares a
+    // new Playback on a worker thread, which then replaces the render
+    // context's.
+    //
+    struct Playback {
+        trackerboy::DefaultApu apu;
+        trackerboy::Synth synth;
+        // read access to the current song, wave table and instrument table
+        trackerboy::Engine engine;
+
+        Playback(trackerboy::Module const& mod, int samplerate, float framerate);
+    };
+
+    //
+    // Parameters of a seek, copied for the worker thread
+    //
+    struct SeekRequest {
+        // incremented for every seek, the seek is cancelled when it no longer
+        // matches mSeekId
+        unsigned id;
+        std::shared_ptr<trackerboy::Song> song;
+        int pattern;
+        int row;
+        // frame the pattern is first played on, from the song's index
+        int patternFrame;
+        int samplerate;
+        float framerate;
+        ChannelOutput::Flags outputFlags;
+    };
+
     enum class State {
         running,    // render samples
         stopping,   // no longing synthesizing, transitions to stopped when the buffer empties
@@ -244,8 +378,65 @@ private:
     };
 
     //
-    // This struct contains shared data between the GUI thread and the
-    // render thread.
+    // Requests from the GUI thread for the render thread. Commands are queued
+    // while rendering and are executed at the start of the next period. When
+    // the render is stopped, commands are executed immediately instead.
+    //
+    struct Command {
+
+        enum class Type {
+            none,
+            play,               // args: pattern, row, stepmode, (playback, frame)
+            resume,             // cancels a pending stop
+            stepNextFrame,
+            stepOut,
+            jump,               // args: pattern
+            patternRepeat,      // args: repeat
+            stopMusic,
+            previewNote,        // args: note
+            instrumentPreview,  // args: note, track, (instrument)
+            voicePreview,       // args: note, track, (instrument)
+            stopVoicePreview,   // args: note
+            waveformPreview,    // args: note, waveId
+            midiPreview,        // args: track, (instrument)
+            midiHold,           // args: hold
+            stopPreview,
+            setSong,            // (song)
+            updateFramerate,
+            resetGlobalVolume,
+            channelOutput       // args: output flags
+        };
+
+        Type type = Type::none;
+        int args[3] = { 0, 0, 0 };
+        std::shared_ptr<const trackerboy::Instrument> instrument;
+        std::shared_ptr<trackerboy::Song> song;
+        // play: playback seeked to the pattern and row, and its engine frame
+        std::shared_ptr<Playback> playback;
+        trackerboy::Frame frame;
+
+        Command() = default;
+
+        Command(Type type, int arg0 = 0, int arg1 = 0, int arg2 = 0);
+    };
+
+    //
+    // Data published by the render thread at the end of every period, for
+    // the GUI thread to read without blocking the render thread.
+    //
+    struct Status {
+        trackerboy::Frame frame;
+        // number of samples written for the last period
+        size_t writesSinceLastPeriod = 0;
+        // time difference between the last period and the one before it
+        Clock::duration periodTime = Clock::duration(0);
+    };
+
+    //
+    // This struct contains the data used for renderering. While the render
+    // is running, the context is owned by the render thread and may only be
+    // modified by posting a Command. When stopped (the timer is not running)
+    // the GUI thread owns the context.
     //
     struct RenderContext {
         // the current module
@@ -258,24 +449,101 @@ private:
 
         std::shared_ptr<trackerboy::Song> song;
 
-        trackerboy::DefaultApu apu;
-        trackerboy::Synth synth;
-        //trackerboy::RuntimeContext mRc;
-        // read access to the current song, wave table and instrument table
-        trackerboy::Engine engine;
-        // has read access to an Instrument and wave table
-        trackerboy::InstrumentPreview ip;
-
-
+        // never null, only replaced when a seek is played
+        std::shared_ptr<Playback> playback;
+        // kept here so that a new playback repeats the pattern too
+        bool patternRepeat;
+
+        //
+        // A preview voice, one for each channel. The previewer has read access
+        // to an Instrument and wave table.
+        //
+        struct Voice {
+            trackerboy::InstrumentPreview ip;
+            // the note being previewed, -1 if the voice is free
+            int note = -1;
+            // allocation order, the oldest voice is reused when none are free
+            unsigned age = 0;
+            // started by a MIDI note, only these follow pitch bend and modulation
+            bool midi = false;
+        };
+        std::array<Voice, 4> voices;
+        unsigned voiceAge;
+
+        // instrument: at least one voice is active
+        // waveform: CH3 is previewing a waveform, all voices are free
         PreviewState previewState;
-        trackerboy::ChType previewChannel;
+
+        ChannelOutput::Flags outputFlags;
+
+        // preview target for MIDI notes, no notes are previewed when the
+        // track is -1
+        int midiTrack;
+        std::shared_ptr<const trackerboy::Instrument> midiInstrument;
+        // set while a MIDI input is open, the render does not stop when idle
+        bool midiHold;
+
+        // pitch bend, in semitones
+        double midiBend;
+        // mod wheel position (0-1), sets the depth of the vibrato
+        double midiModulation;
+        unsigned midiVibratoTimer;
+        // set if voice frequencies were overridden by the bend or vibrato
+        bool midiPitchApplied;
+
+        //
+        // Playback controlled by an external sequencer. While playing, the
+        // engine is stepped at the rate of the MIDI clock instead of the
+        // module's framerate.
+        //
+        struct MidiTransport {
+            bool playing = false;
+            // position to resume from, in MIDI beats (16th notes)
+            int songPosition = 0;
+            int rowsPerBeat = 4;
+            // clocks received since playback started
+            long clocks = 0;
+            // engine frames expected and actually stepped since the first clock
+            double expectedFrames = 0.0;
+            long frames = 0;
+            // time of the last clock, and the smoothed interval between clocks
+            double lastClock = -1.0;
+            double clockInterval = 0.0;
+            // engine steps per synthesized frame, and the fractional step
+            // carried to the next frame
+            double rate = 1.0;
+            double phase = 0.0;
+        };
+        MidiTransport midiTransport;
+        // the synth's framerate
+        float framerate;
+
+        // received MIDI messages that have yet to be applied. offset is the
+        // sample position, relative to the start of the current period, the
+        // message is applied at.
+        struct PendingMidi {
+            IMidiSink::Message msg;
+            long offset = 0;
+        };
+        std::array<PendingMidi, 64> midiPending;
+        size_t midiPendingCount;
+        // time and offset of the first message in the current burst, the
+        // offsets of the following messages are relative to it
+        double midiBaseTime;
+        long midiBaseOffset;
 
         trackerboy::Frame currentEngineFrame;
 
-        State state;
+        // recent samples for visualizers
+        VisualizerBuffer visBuffer;
+
         int stopCounter;
+        // set when a stop was requested from the device callback
+        bool stopRequested;
 
         size_t bufferSize; // cache this here so we don't have to call mStream.bufferSize() in the render thread
+        Clock::duration period; // configured period, for the push and clock modes
+        SoundConfig::RenderMode renderMode;
 
         // diagnostics
         Clock::time_point watchdog; // occurance of last watchdog reset
@@ -286,20 +554,103 @@ private:
         RenderContext(Module &mod);
     };
 
-    // type alias for mutually exclusive access to the RenderContext
-    using Handle = Locked<RenderContext>;
+    //
+    // Sends the command to the thread owning the render context.
+    //
+    void postCommand(Command &&cmd);
+
+    //
+    // Executes all queued commands. Must only be called by the context owner.
+    //
+    void drainCommands();
+
+    //
+    // Executes the command on the render context.
+    //
+    void execute(Command &cmd);
 
     // sets up the engine to play starting at the given pattern and row
-    void _play(Handle &handle, int pattern, int row, bool stepping = false);
+    void _play(int pattern, int row, bool stepping = false);
+
+    //
+    // Replaces the context's playback with one prepared by a seek, the
+    // engine continues from the given frame.
+    //
+    void _playSeeked(std::shared_ptr<Playback> &&playback, trackerboy::Frame const& frame, bool stepping);
 
-    void _stopMusic(Handle &handle);
+    //
+    // Starts a seek for play() on the seek thread pool, cancelling the
+    // previous one.
+    //
+    void startSeek(int pattern, int row, int patternFrame);
 
-    // utility function for preview slots
-    void resetPreview(Handle &handle);
+    //
+    // Cancels the seek in progress, if any. Its play command is not posted.
+    //
+    void cancelSeek();
 
-    void previewNoteOrInstrument(int note, int track = -1, int instrument = -1);
+    //
+    // Worker thread. Steps a new engine from the start of the song until
+    // the requested pattern and row is reached so that its state matches
+    // playing the song from the beginning. Only the engine is stepped, the
+    // APU just latches its register writes and the synth is only run for
+    // the frame that was seeked to. The result is sent to seekFinished.
+    //
+    void seek(SeekRequest const& request);
+
+    //
+    // Invoked in the GUI thread when a seek has completed. The play command
+    // is posted with the playback, or without it if the seek failed.
+    //
+    void seekFinished(SeekRequest const& request, std::shared_ptr<Playback> playback, trackerboy::Frame const& frame);
 
-    void _setChannelOutput(Handle &handle, ChannelOutput::Flags flags);
+    // starts a voice for the note, see voicePreview. midi marks voices
+    // started by a MIDI note on
+    void startVoice(uint8_t note, int track, std::shared_ptr<const trackerboy::Instrument> instrument, bool midi = false);
+
+    // stops voices previewing the note, or all voices for -1
+    void stopVoice(int note);
+
+    // utility function for preview slots, stops all previews
+    void resetPreview();
+
+    //
+    // Moves received MIDI messages from the queue to the render context,
+    // scheduling them within the period. Must only be called by the context
+    // owner, at the start of a period.
+    //
+    void receiveMidi();
+
+    //
+    // Applies all pending MIDI messages scheduled at or before the given
+    // sample position of the current period.
+    //
+    void applyMidi(long position);
+
+    void applyMidiMessage(IMidiSink::Message const& msg);
+
+    //
+    // Overrides the frequency of the active MIDI voices with the pitch bend
+    // and mod wheel vibrato. Called every frame after the voices are stepped.
+    //
+    void applyMidiPitch();
+
+    // starts playback from the transport's song position
+    void startMidiSync();
+
+    // playback is no longer controlled by the transport
+    void stopMidiSync();
+
+    // updates the engine rate from a received clock
+    void midiClock(double time);
+
+    //
+    // Invoked in the GUI thread when MIDI messages were received while not
+    // rendering.
+    //
+    void startMidiRender();
+
+    void _setChannelOutput(ChannelOutput::Flags flags);
 
     // stream management -----------------------------------------------------
 
@@ -307,10 +658,47 @@ private:
     // Start the audio callback thread for the configured device. If the audio
     // callback thread is already running, the stop countdown is cancelled
     //
-    void beginRender(Handle &handle);
+    void beginRender();
+
+    //
+    // Starts or stops whatever calls render() for the current render mode.
+    // stopClock() may be called from the render thread.
+    //
+    void startClock();
+    void stopClock();
 
     static void timerCallback(void *userData);
 
+    static void wakeCallback(void *userData);
+
+    //
+    // Applies mSchedOptions to the RenderClock's thread when it starts. The
+    // process's memory is locked once by setConfig, not here.
+    //
+    static void clockThreadInit(void *userData);
+
+    void setSchedulingStatus(ThreadScheduling::Status const& status);
+
+    static void renderCallback(void *userData, float *out, size_t frames);
+
+    //
+    // Synthesizes up to frames samples to the given buffer, stepping the
+    // engine and previewer as needed. Fewer samples are written if the render
+    // is stopping. The number of samples written is returned.
+    //
+    size_t synthesize(
+        float *dest,
+        size_t frames,
+        trackerboy::Frame &frame,
+        bool &newFrame
+    );
+
+    //
+    // Publishes a snapshot of the visualizer buffer. Must only be called by
+    // the context owner.
+    //
+    void publishVisualizers();
+
     //
     // Fills the playback buffer with newly renderered samples. Stops rendering
     // if there is no work to do and the buffer has drained completely.
@@ -320,27 +708,91 @@ private:
     void render();
 
     //
-    // Immediately stops the render without letting the buffer drain.
+    // Synthesizes directly to the device's buffer, used instead of render()
+    // when the render mode is pull. This function is called from the device's
+    // thread.
     //
-    void stopRender(Handle &handle, bool aborted = false);
+    void renderPull(float *out, size_t frames);
+
+    //
+    // Publishes results and emits signals at the end of a render.
+    //
+    void endPeriod(trackerboy::Frame const& frame, bool haltedBefore, bool newFrame);
+
+    //
+    // Publishes the current frame and diagnostics to the GUI thread.
+    //
+    void publishStatus();
+
+    //
+    // Adds the jitter of the current period to the histogram. Render thread
+    // only.
+    //
+    void recordJitter(Clock::duration jitter);
+
+    //
+    // Called in the GUI thread when the render thread has requested a stop,
+    // either from draining the buffer or from the watchdog.
+    //
+    void finishRender(bool aborted);
+
+    //
+    // Immediately stops the render without letting the buffer drain. Must be
+    // called from the GUI thread.
+    //
+    void stopRender(bool aborted = false);
 
     // class members ---------------------------------------------------------
 
     QThread mTimerThread;
     FastTimer *mTimer;      // thread-safe: yes
+    RenderClock mClock;     // thread-safe: see class
 
     AudioStream mStream;    // thread-safe: no
-    Guarded<VisualizerBuffer> mVisBuffer;
+    std::atomic_int mScopeWidth;
 
     ChannelOutput::Flags mOutputFlags;
 
     Clock::time_point mRenderStartTime;
 
-    //
-    // All variables accessible from multiple threads are stored in the RenderContext
-    // struct, access to them is guarded by a mutex.
-    //
-    Guarded<RenderContext> mContext;
+    // GUI thread copies of settings, so we never have to read the context
+    bool mStepping;
+    int mSamplerate;
+    size_t mBufferSize;
+    SoundConfig::RenderMode mRenderMode;
+    bool mMidiHold;
+    // only modified by the GUI thread while nothing is rendering
+    ThreadScheduling::Options mSchedOptions;
+
+    QMutex mSchedMutex;
+    ThreadScheduling::Status mSchedStatus; // guarded by mSchedMutex
+
+    // render state, only the GUI thread may transition to State::stopped
+    std::atomic<State> mState;
+
+    // render thread -> GUI, period jitter histogram
+    std::array<std::atomic_uint, JitterStats::BINS> mJitterCounts;
+    std::atomic<Clock::rep> mJitterMax;
+
+    // GUI -> render thread
+    SpscQueue<Command, 64> mCommands;
+    // MIDI thread -> render thread
+    SpscQueue<IMidiSink::Message, 256> mMidiQueue;
+    // set while a startMidiRender call is queued
+    std::atomic_bool mMidiStartPending;
+    // render thread -> GUI
+    TripleBuffer<Status> mStatus;
+    TripleBuffer<VisualizerBuffer::Snapshot> mVisSnapshot;
+
+    // seeks for play() run here, one at a time
+    QThreadPool mSeekPool;
+    // the current seek, compared with SeekRequest::id
+    std::atomic_uint mSeekId;
+    // context owner -> GUI, playbacks replaced by a seek. They are freed by
+    // the GUI thread instead of the render thread
+    SpscQueue<std::shared_ptr<Playback>, 4> mRetiredPlayback;
+
+    RenderContext mContext;
     
 
 
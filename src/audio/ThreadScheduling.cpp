@@ -0,0 +1,338 @@
+
+#include "audio/ThreadScheduling.hpp"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThread>
+#include <QtGlobal>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(Q_OS_UNIX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#endif
+#endif
+
+#define TU ThreadSchedulingTU
+namespace TU {
+
+// amount of stack touched ahead of time, more than the render thread
+// will ever use
+constexpr size_t PREFAULT_SIZE = 128 * 1024;
+constexpr size_t PREFAULT_STRIDE = 4096;
+
+// real-time priority requested, below the audio servers (JACK and PipeWire
+// use 80+) so that the device thread still preempts us
+constexpr int REALTIME_LEVEL = 40;
+
+// nice value used when real-time scheduling is not permitted
+constexpr int RAISED_NICE = -10;
+
+// mlockall is process wide, remember if we did it so it can be undone
+std::atomic_bool processLocked;
+// reason the last lockProcessMemory failed
+QMutex processLockMutex;
+QString processLockError;
+
+//
+// Scheduling of a thread before it was first changed, restored when the
+// options are turned off.
+//
+struct SavedScheduling {
+    bool saved = false;
+#if defined(Q_OS_WIN)
+    int priority = THREAD_PRIORITY_NORMAL;
+#elif defined(Q_OS_UNIX)
+    int policy = SCHED_OTHER;
+    sched_param param{};
+    #ifdef Q_OS_LINUX
+    int nice = 0;
+    #endif
+#endif
+};
+thread_local SavedScheduling savedScheduling;
+
+// address of the stack pages locked by this thread, or nullptr
+thread_local void *lockedStack;
+
+QString errorString(int err) {
+    return QString::fromLocal8Bit(std::strerror(err));
+}
+
+//
+// Touches PREFAULT_SIZE bytes of the calling thread's stack so that no page
+// faults occur when the stack grows during a render. If lock is true the
+// touched pages are locked as well, and remembered in lockedStack. Returns
+// true if the pages were locked.
+//
+#if defined(Q_CC_GNU) || defined(Q_CC_CLANG)
+__attribute__((noinline))
+#elif defined(Q_CC_MSVC)
+__declspec(noinline)
+#endif
+bool prefaultStack(bool lock) {
+    volatile unsigned char stack[PREFAULT_SIZE];
+    for (size_t i = 0; i < PREFAULT_SIZE; i += PREFAULT_STRIDE) {
+        stack[i] = 0;
+    }
+
+    if (!lock) {
+        return false;
+    }
+    // the pages stay mapped after returning, so they remain locked
+    auto addr = const_cast<unsigned char*>(stack);
+#if defined(Q_OS_WIN)
+    bool const locked = VirtualLock(addr, PREFAULT_SIZE);
+#elif defined(Q_OS_UNIX)
+    bool const locked = mlock(addr, PREFAULT_SIZE) == 0;
+#else
+    bool const locked = false;
+#endif
+    if (locked) {
+        lockedStack = addr;
+    }
+    return locked;
+}
+
+void unlockStack() {
+    if (lockedStack == nullptr) {
+        return;
+    }
+#if defined(Q_OS_WIN)
+    VirtualUnlock(lockedStack, PREFAULT_SIZE);
+#elif defined(Q_OS_UNIX)
+    munlock(lockedStack, PREFAULT_SIZE);
+#endif
+    lockedStack = nullptr;
+}
+
+void saveScheduling() {
+    auto &saved = savedScheduling;
+    if (saved.saved) {
+        return;
+    }
+    saved.saved = true;
+#if defined(Q_OS_WIN)
+    auto const priority = GetThreadPriority(GetCurrentThread());
+    if (priority != THREAD_PRIORITY_ERROR_RETURN) {
+        saved.priority = priority;
+    }
+#elif defined(Q_OS_UNIX)
+    if (pthread_getschedparam(pthread_self(), &saved.policy, &saved.param) != 0) {
+        saved.policy = SCHED_OTHER;
+        saved.param.sched_priority = 0;
+    }
+    #ifdef Q_OS_LINUX
+    // -1 is a valid nice value, errno tells if it failed
+    errno = 0;
+    auto const value = getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+    if (errno == 0) {
+        saved.nice = value;
+    }
+    #endif
+#endif
+}
+
+void restoreScheduling() {
+    auto const& saved = savedScheduling;
+    if (!saved.saved) {
+        // never changed
+        return;
+    }
+#if defined(Q_OS_WIN)
+    SetThreadPriority(GetCurrentThread(), saved.priority);
+#elif defined(Q_OS_UNIX)
+    pthread_setschedparam(pthread_self(), saved.policy, &saved.param);
+    #ifdef Q_OS_LINUX
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), saved.nice);
+    #endif
+#endif
+}
+
+void applyPriority(bool realtime, ThreadScheduling::Status &status, QStringList &errors) {
+    // start from the thread's original scheduling, so that nothing from a
+    // previous call is left over
+    restoreScheduling();
+    if (!realtime) {
+        return;
+    }
+    saveScheduling();
+
+#if defined(Q_OS_WIN)
+    if (SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        // time critical is the highest level for a normal priority class
+        // process, but it is not real-time
+        status.priority = ThreadScheduling::Priority::raised;
+    } else {
+        errors.append(QStringLiteral("Priority: SetThreadPriority failed (%1)").arg(GetLastError()));
+    }
+#elif defined(Q_OS_UNIX)
+    auto const self = pthread_self();
+    sched_param param{};
+
+    // an unprivileged thread may only go up to its RLIMIT_RTPRIO
+    auto level = std::min(REALTIME_LEVEL, sched_get_priority_max(SCHED_FIFO));
+    #ifdef RLIMIT_RTPRIO
+    if (geteuid() != 0) {
+        rlimit limit;
+        if (getrlimit(RLIMIT_RTPRIO, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+            level = std::min(level, (int)limit.rlim_cur);
+        }
+    }
+    #endif
+
+    int err = EPERM;
+    if (level >= sched_get_priority_min(SCHED_FIFO)) {
+        param.sched_priority = level;
+        err = pthread_setschedparam(self, SCHED_FIFO, &param);
+        if (err == 0) {
+            status.priority = ThreadScheduling::Priority::realtime;
+            status.level = level;
+            return;
+        }
+    }
+    errors.append(QStringLiteral("Real-time: %1").arg(errorString(err)));
+
+    #ifdef Q_OS_LINUX
+    // on Linux, nice values apply per thread
+    if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), RAISED_NICE) == 0) {
+        status.priority = ThreadScheduling::Priority::raised;
+    } else {
+        errors.append(QStringLiteral("Nice: %1").arg(errorString(errno)));
+    }
+    #endif
+#else
+    errors.append(QStringLiteral("Priority: not supported on this platform"));
+#endif
+}
+
+void applyAffinity(int cpu, ThreadScheduling::Status &status, QStringList &errors) {
+    if (cpu >= ThreadScheduling::cpuCount()) {
+        errors.append(QStringLiteral("Affinity: core %1 does not exist").arg(cpu));
+        cpu = -1;
+    }
+
+#if defined(Q_OS_WIN)
+    DWORD_PTR processMask, systemMask;
+    if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask)) {
+        processMask = ~(DWORD_PTR)0;
+    }
+    auto const mask = cpu == -1 ? processMask : (DWORD_PTR)1 << cpu;
+    if (SetThreadAffinityMask(GetCurrentThread(), mask)) {
+        status.cpu = cpu;
+    } else if (cpu != -1) {
+        errors.append(QStringLiteral("Affinity: SetThreadAffinityMask failed (%1)").arg(GetLastError()));
+    }
+#elif defined(Q_OS_LINUX)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu == -1) {
+        auto const count = ThreadScheduling::cpuCount();
+        for (int i = 0; i < count; ++i) {
+            CPU_SET(i, &set);
+        }
+    } else {
+        CPU_SET(cpu, &set);
+    }
+    auto const err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err == 0) {
+        status.cpu = cpu;
+    } else if (cpu != -1) {
+        errors.append(QStringLiteral("Affinity: %1").arg(errorString(err)));
+    }
+#else
+    if (cpu != -1) {
+        errors.append(QStringLiteral("Affinity: not supported on this platform"));
+    }
+#endif
+}
+
+void applyMemoryLock(bool lock, ThreadScheduling::Status &status, QStringList &errors) {
+    unlockStack();
+    if (!lock) {
+        return;
+    }
+
+    status.processLocked = processLocked;
+    if (!status.processLocked) {
+        QMutexLocker locker(&processLockMutex);
+        if (!processLockError.isEmpty()) {
+            errors.append(processLockError);
+        }
+    }
+
+    // the stack of a thread started after the process was locked is not, so
+    // it is always locked here
+    status.prefaulted = true;
+    status.stackLocked = prefaultStack(true);
+    if (!status.stackLocked) {
+        errors.append(QStringLiteral("Lock stack: failed"));
+    }
+}
+
+}
+
+ThreadScheduling::Status ThreadScheduling::applyToCurrentThread(Options const& options) {
+    Status status;
+    status.applied = true;
+    QStringList errors;
+
+    TU::applyPriority(options.realtime, status, errors);
+    TU::applyAffinity(options.cpu, status, errors);
+    TU::applyMemoryLock(options.lockMemory, status, errors);
+
+    status.errors = errors.join(QChar('\n'));
+    return status;
+}
+
+bool ThreadScheduling::lockProcessMemory(bool lock) {
+    QMutexLocker locker(&TU::processLockMutex);
+    TU::processLockError.clear();
+
+    if (lock == TU::processLocked) {
+        return true;
+    }
+
+#ifdef Q_OS_UNIX
+    if (!lock) {
+        munlockall();
+        TU::processLocked = false;
+        return true;
+    }
+
+    // only the memory mapped right now is locked, MCL_FUTURE would make any
+    // allocation past RLIMIT_MEMLOCK fail
+    if (mlockall(MCL_CURRENT) == 0) {
+        TU::processLocked = true;
+        return true;
+    }
+    TU::processLockError = QStringLiteral("Lock process: %1").arg(TU::errorString(errno));
+#else
+    if (!lock) {
+        return true;
+    }
+    TU::processLockError = QStringLiteral("Lock process: not supported on this platform");
+#endif
+    return false;
+}
+
+int ThreadScheduling::cpuCount() {
+    return QThread::idealThreadCount();
+}
+
+#undef TU
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QString>
+
+//
+// Platform specific scheduling for the render thread: real-time priority,
+// CPU affinity and memory locking. Every setting is best effort, when one
+// cannot be applied the thread keeps running with whatever could be, and
+// the reason is reported in the resulting Status.
+//
+// Locking the process's memory is process wide and done separately with
+// lockProcessMemory, a thread only pre-faults and locks its own stack.
+//
+// Linux: SCHED_FIFO (requires CAP_SYS_NICE or an RLIMIT_RTPRIO, ie the audio
+//        group), falling back to a negative nice value.
+// Other POSIX: SCHED_FIFO only, no affinity.
+// Windows: THREAD_PRIORITY_TIME_CRITICAL.
+//
+class ThreadScheduling {
+
+public:
+
+    enum class Priority {
+        normal,         // default scheduling
+        raised,         // higher than normal, but not real-time
+        realtime        // real-time scheduling
+    };
+
+    struct Options {
+        bool realtime = false;
+        // core to pin to, -1 for any
+        int cpu = -1;
+        // pre-fault and lock the thread's stack
+        bool lockMemory = false;
+    };
+
+    struct Status {
+        // false if the options have not been applied to a thread
+        bool applied = false;
+        Priority priority = Priority::normal;
+        // real-time priority level, if priority is realtime
+        int level = 0;
+        // core the thread is pinned to, or -1 for none
+        int cpu = -1;
+        // the thread's stack was pre-faulted
+        bool prefaulted = false;
+        // all of the process's memory is locked, see lockProcessMemory
+        bool processLocked = false;
+        // the thread's stack is locked
+        bool stackLocked = false;
+        // reasons why any of the options could not be applied, newline
+        // separated
+        QString errors;
+    };
+
+    ThreadScheduling() = delete;
+
+    //
+    // Applies the given options to the calling thread. Options that are off
+    // are reverted to what the thread had before the first call, so the same
+    // thread can be reconfigured. If lockMemory is set and the process's
+    // memory could not be locked, the reason is included in the errors.
+    //
+    static Status applyToCurrentThread(Options const& options);
+
+    //
+    // Locks all memory currently mapped by the process, or unlocks it. Does
+    // nothing if the memory is already in the requested state, so it can be
+    // called whenever the configuration is applied. Returns true on success.
+    //
+    static bool lockProcessMemory(bool lock);
+
+    //
+    // Number of cores that can be pinned to.
+    //
+    static int cpuCount();
+
+};
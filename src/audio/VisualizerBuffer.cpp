@@ -2,9 +2,163 @@
 #include "audio/VisualizerBuffer.hpp"
 
 #include <algorithm>
+#include <limits>
+#include <utility>
 
 #include <QtGlobal>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VIS_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(VIS_SSE2) && (defined(__GNUC__) || defined(__clang__))
+// AVX is enabled per function and selected at runtime
+#define VIS_AVX
+#include <immintrin.h>
+#endif
+
+#define TU VisualizerBufferTU
+namespace TU {
+
+//
+// Running min, max and sum for the left and right channels.
+//
+struct Stats {
+    float min[2] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float max[2] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+    float sum[2] = { 0.0f, 0.0f };
+};
+
+//
+// Accumulates the given number of interleaved stereo frames into stats.
+//
+using AccumulateFn = void(*)(float const *buf, size_t frames, Stats &stats);
+
+static void accumulateScalar(float const *buf, size_t frames, Stats &stats) {
+    for (size_t i = 0; i < frames; ++i) {
+        for (int ch = 0; ch < 2; ++ch) {
+            auto const sample = *buf++;
+            stats.min[ch] = std::min(stats.min[ch], sample);
+            stats.max[ch] = std::max(stats.max[ch], sample);
+            stats.sum[ch] += sample;
+        }
+    }
+}
+
+#ifdef VIS_SSE2
+
+//
+// Merges a vector of L R L R partial results into stats
+//
+static void reduce(__m128 vmin, __m128 vmax, __m128 vsum, Stats &stats) {
+    alignas(16) float mins[4];
+    alignas(16) float maxs[4];
+    alignas(16) float sums[4];
+    _mm_store_ps(mins, vmin);
+    _mm_store_ps(maxs, vmax);
+    _mm_store_ps(sums, vsum);
+    for (int ch = 0; ch < 2; ++ch) {
+        stats.min[ch] = std::min({ stats.min[ch], mins[ch], mins[ch + 2] });
+        stats.max[ch] = std::max({ stats.max[ch], maxs[ch], maxs[ch + 2] });
+        stats.sum[ch] += sums[ch] + sums[ch + 2];
+    }
+}
+
+static void accumulateSse2(float const *buf, size_t frames, Stats &stats) {
+    // each vector holds 2 stereo frames
+    auto vmin = _mm_set1_ps(std::numeric_limits<float>::max());
+    auto vmax = _mm_set1_ps(std::numeric_limits<float>::lowest());
+    auto vsum = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 2 <= frames; i += 2) {
+        auto const v = _mm_loadu_ps(buf + i * 2);
+        vmin = _mm_min_ps(vmin, v);
+        vmax = _mm_max_ps(vmax, v);
+        vsum = _mm_add_ps(vsum, v);
+    }
+    reduce(vmin, vmax, vsum, stats);
+    accumulateScalar(buf + i * 2, frames - i, stats);
+}
+
+#endif
+
+#ifdef VIS_AVX
+
+__attribute__((target("avx")))
+static void accumulateAvx(float const *buf, size_t frames, Stats &stats) {
+    // each vector holds 4 stereo frames
+    auto vmin = _mm256_set1_ps(std::numeric_limits<float>::max());
+    auto vmax = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+    auto vsum = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        auto const v = _mm256_loadu_ps(buf + i * 2);
+        vmin = _mm256_min_ps(vmin, v);
+        vmax = _mm256_max_ps(vmax, v);
+        vsum = _mm256_add_ps(vsum, v);
+    }
+    // fold the upper half onto the lower half, the layout is still L R L R
+    reduce(
+        _mm_min_ps(_mm256_castps256_ps128(vmin), _mm256_extractf128_ps(vmin, 1)),
+        _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1)),
+        _mm_add_ps(_mm256_castps256_ps128(vsum), _mm256_extractf128_ps(vsum, 1)),
+        stats
+    );
+    accumulateSse2(buf + i * 2, frames - i, stats);
+}
+
+#endif
+
+static AccumulateFn selectAccumulate() {
+    #ifdef VIS_AVX
+    if (__builtin_cpu_supports("avx")) {
+        return accumulateAvx;
+    }
+    #endif
+    #ifdef VIS_SSE2
+    return accumulateSse2;
+    #else
+    return accumulateScalar;
+    #endif
+}
+
+static AccumulateFn const accumulate = selectAccumulate();
+
+}
+
+VisualizerBuffer::Envelope::Envelope() :
+    mChannels(),
+    mWidth(0)
+{
+}
+
+int VisualizerBuffer::Envelope::width() const {
+    return mWidth;
+}
+
+void VisualizerBuffer::Envelope::resize(int width) {
+    width = std::max(0, width);
+    for (auto &channel : mChannels) {
+        channel.min.resize(width);
+        channel.max.resize(width);
+        channel.avg.resize(width);
+    }
+    mWidth = width;
+}
+
+void VisualizerBuffer::Envelope::clear() {
+    mWidth = 0;
+}
+
+VisualizerBuffer::Envelope::Channel const& VisualizerBuffer::Envelope::left() const {
+    return mChannels[0];
+}
+
+VisualizerBuffer::Envelope::Channel const& VisualizerBuffer::Envelope::right() const {
+    return mChannels[1];
+}
+
 VisualizerBuffer::VisualizerBuffer() :
     mBufferData(),
     mBufferSize(0),
@@ -48,28 +202,44 @@ void VisualizerBuffer::read(size_t index, float &outLeft, float &outRight) {
 
 }
 
-void VisualizerBuffer::averageSample(float index, float bin, float &outLeft, float &outRight) {
-    
-    // determine the number of samples to average, with a minimum of 1 sample
-    int samples = std::max(1, (int)((index + bin) - (int)index));
+void VisualizerBuffer::envelope(int width, Envelope &out) const {
+    if (mBufferSize == 0 || width <= 0) {
+        out.clear();
+        return;
+    }
+
+    if ((size_t)width != out.mChannels[0].min.size()) {
+        out.resize(width);
+    }
+    out.mWidth = width;
+
+    auto const data = mBufferData.get();
+    for (int col = 0; col < width; ++col) {
+        // range of samples for this column, oldest sample is at index 0
+        auto const start = (size_t)col * mBufferSize / width;
+        auto const end = std::max(start + 1, (size_t)(col + 1) * mBufferSize / width);
+        auto const count = end - start;
 
-    size_t bufIndex = (mIndex + (size_t)index) % mBufferSize;
-    auto buf = mBufferData.get() + (bufIndex * 2);
+        // the range may wrap around the end of the buffer
+        TU::Stats stats;
+        auto const pos = (mIndex + start) % mBufferSize;
+        auto const first = std::min(count, mBufferSize - pos);
+        TU::accumulate(data + pos * 2, first, stats);
+        if (count > first) {
+            TU::accumulate(data, count - first, stats);
+        }
 
-    float sumLeft = 0.0f;
-    float sumRight = 0.0f;
-    for (int i = 0; i < samples; ++i) {
-        sumLeft += *buf++;
-        sumRight += *buf++;
-        if (++bufIndex == mBufferSize) {
-            bufIndex = 0;
-            buf = mBufferData.get();
+        for (int ch = 0; ch < 2; ++ch) {
+            auto &channel = out.mChannels[ch];
+            channel.min[col] = stats.min[ch];
+            channel.max[col] = stats.max[ch];
+            channel.avg[col] = stats.sum[ch] / count;
         }
     }
-    
-    outLeft = (float)sumLeft / samples;
-    outRight = (float)sumRight / samples;
+}
 
+void VisualizerBuffer::snapshot(int width, Snapshot &out) const {
+    envelope(width, out.envelope);
 }
 
 void VisualizerBuffer::beginWrite(size_t amount) {
@@ -121,3 +291,5 @@ void VisualizerBuffer::write(float buf[], size_t amount) {
     }
 
 }
+
+#undef TU
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <memory>
+#include <vector>
 
 
 //
@@ -30,6 +31,55 @@
 class VisualizerBuffer {
 
 public:
+
+    //
+    // Decimated copy of the buffer for drawing, with one column per pixel.
+    // Each column has the minimum, maximum and average sample of the samples
+    // it covers, for both channels.
+    //
+    class Envelope {
+
+    public:
+
+        struct Channel {
+            std::vector<float> min;
+            std::vector<float> max;
+            std::vector<float> avg;
+        };
+
+        Envelope();
+
+        //
+        // Number of columns, 0 if there is nothing to draw.
+        //
+        int width() const;
+
+        void resize(int width);
+
+        //
+        // Sets the width to 0, keeping the memory allocated.
+        //
+        void clear();
+
+        Channel const& left() const;
+        Channel const& right() const;
+
+    private:
+        friend class VisualizerBuffer;
+
+        Channel mChannels[2];
+        int mWidth;
+
+    };
+
+    //
+    // The latest state of the buffer, published by the renderer for the
+    // visualizers.
+    //
+    struct Snapshot {
+        Envelope envelope;
+    };
+
     VisualizerBuffer();
     ~VisualizerBuffer() = default;
 
@@ -42,11 +92,16 @@ public:
     void read(size_t index, float &outLeft, float &outRight);
 
     //
-    // Computes the average left and right samples for the given index and bin
-    // size. Bin size refers to the ratio of samples per pixel. ie, a bin size
-    // of 2.5 means that 2.5 samples are represented by a single pixel.
+    // Computes the envelope of the entire buffer for the given number of
+    // columns. Uses SSE2 or AVX when available. Memory is only allocated
+    // when the width of out changes.
+    //
+    void envelope(int width, Envelope &out) const;
+
+    //
+    // Computes the envelope for the given snapshot.
     //
-    void averageSample(float index, float bin, float &outLeft, float &outRight);
+    void snapshot(int width, Snapshot &out) const;
 
     //
     // Begin a write operation. If amount is greater than this buffer's
@@ -1,8 +1,11 @@
 
 #include "audio/Wav.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdint>
+#include <cstring>
 
 
 namespace WavPrivate {
@@ -10,12 +13,13 @@ namespace WavPrivate {
 #pragma pack(push, 1)
 
 //
-// Header for wav files with 32-bit floating point samples
+// Header for wav files. The same layout is used for both float and PCM
+// samples, the fact chunk is optional for PCM but is still valid.
 //
 struct WavHeader {
 
     // [B] indicates that this field is set in the Wav constructor
-    // [F] indicates that this field is set in the Wav destructor
+    // [F] indicates that this field is set when the Wav is closed
     // = indicates the field's initial value
 
     // RIFF chunk
@@ -25,12 +29,12 @@ struct WavHeader {
     // fmt subchunk
     char fmtId[4];              // = "fmt "
     uint32_t fmtChunkSize;      // = 18
-    uint16_t fmtTag;            // = 0x3 for IEEE_FLOAT
+    uint16_t fmtTag;            // [B] 0x3 for IEEE_FLOAT, 0x1 for PCM
     uint16_t fmtChannels;       // [B]
     uint32_t fmtSampleRate;     // [B]
-    uint32_t fmtAvgBytesPerSec; // [B] = 4 * fmtSampleRate * fmtChannels
-    uint16_t fmtBlockAlign;     // [B] = 4 * fmtChannels
-    uint16_t fmtBitsPerSample;  // = 32
+    uint32_t fmtAvgBytesPerSec; // [B] = bytesPerSample * fmtSampleRate * fmtChannels
+    uint16_t fmtBlockAlign;     // [B] = bytesPerSample * fmtChannels
+    uint16_t fmtBitsPerSample;  // [B] 32, 24 or 16
     uint16_t fmtCbSize;         // = 0
     // fact subchunk
     char factId[4];             // = "fact"
@@ -67,34 +71,143 @@ struct WavHeader {
 
 #pragma pack(pop)
 
+constexpr uint16_t FORMAT_PCM = 0x1;
+constexpr uint16_t FORMAT_IEEE_FLOAT = 0x3;
+
+static int bytesPerSample(Wav::Format format) {
+    switch (format) {
+        case Wav::Format::pcm16:
+            return 2;
+        case Wav::Format::pcm24:
+            return 3;
+        default:
+            return 4;
+    }
 }
 
+//
+// xorshift32, cheap noise source for dithering
+//
+static inline uint32_t nextRandom(uint32_t &state) {
+    auto x = state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state = x;
+    return x;
+}
 
+//
+// Triangular (TPDF) dither noise in the range (-1, 1), in units of the
+// least significant bit.
+//
+static inline float dither(uint32_t &state) {
+    constexpr float SCALE = 1.0f / 16777216.0f;
+    auto r1 = (nextRandom(state) >> 8) * SCALE;
+    auto r2 = (nextRandom(state) >> 8) * SCALE;
+    return r1 - r2;
+}
+
+//
+// Scales, dithers and rounds a sample to a signed integer with the given
+// maximum value.
+//
+static inline int32_t quantize(float sample, float max, uint32_t &state) {
+    auto scaled = std::clamp(sample, -1.0f, 1.0f) * max + dither(state);
+    auto rounded = (int32_t)std::lrint(scaled);
+    return std::clamp(rounded, (int32_t)-max - 1, (int32_t)max);
+}
 
-Wav::Wav(std::string const& filename, int channels, int samplerate) :
-    mStream(filename, std::ios::out | std::ios::binary),
+}
+
+
+
+Wav::Wav(
+    std::string const& filename,
+    int channels,
+    int samplerate,
+    Format format,
+    bool threaded
+) :
+    mStream(),
     mSampleCount(0),
     mChannels(channels),
-    mSamplingRate(samplerate)
+    mSamplingRate(samplerate),
+    mFormat(format),
+    mBytesPerSample(WavPrivate::bytesPerSample(format)),
+    mRng(0x2545F491),
+    mBuffers(),
+    mCurrent(0),
+    mBufferUsed(0),
+    mThreaded(threaded),
+    mWriter(),
+    mMutex(),
+    mCv(),
+    mPendingIndex(0),
+    mPending(0),
+    mQuit(false),
+    mError(false),
+    mClosed(false)
 {
     assert(channels > 0);
     assert(samplerate > 0);
 
+    // we do our own buffering, so disable the stream's buffer
+    mStream.rdbuf()->pubsetbuf(nullptr, 0);
+    mStream.open(filename, std::ios::out | std::ios::binary);
+
     WavPrivate::WavHeader header;
+    header.fmtTag = mFormat == Format::float32 ? WavPrivate::FORMAT_IEEE_FLOAT : WavPrivate::FORMAT_PCM;
     header.fmtChannels = mChannels;
     header.fmtSampleRate = mSamplingRate;
-    uint16_t bytesPerChannel = mChannels * 4;
+    uint16_t bytesPerChannel = mChannels * mBytesPerSample;
     header.fmtAvgBytesPerSec = bytesPerChannel * mSamplingRate;
     header.fmtBlockAlign = bytesPerChannel;
+    header.fmtBitsPerSample = mBytesPerSample * 8;
 
 
     mStream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!mStream.good()) {
+        mError = true;
+        return;
+    }
+
+    mBuffers[0] = std::make_unique<Page[]>(PAGES_PER_BUFFER);
+    if (mThreaded) {
+        mBuffers[1] = std::make_unique<Page[]>(PAGES_PER_BUFFER);
+        mWriter = std::thread(&Wav::writerMain, this);
+    }
 
 }
 
 Wav::~Wav() {
+    close();
+}
+
+bool Wav::close() {
+    if (mClosed) {
+        return !mError;
+    }
+    mClosed = true;
+
+    flush();
+    if (mWriter.joinable()) {
+        {
+            std::unique_lock lock(mMutex);
+            mCv.wait(lock, [this]() { return mPending == 0; });
+            mQuit = true;
+        }
+        mCv.notify_all();
+        mWriter.join();
+    }
+
+    if (mError) {
+        // the file is incomplete, leave the header as is
+        return false;
+    }
+
     uint32_t totalSamples = static_cast<uint32_t>(mSampleCount);
-    uint32_t dataChunkSize = totalSamples * mChannels * 4;
+    uint32_t dataChunkSize = totalSamples * mChannels * mBytesPerSample;
 
     // chunk size totals
     // 4: riff chunk
@@ -123,20 +236,116 @@ Wav::~Wav() {
     // overwrite the chunk size of the data subchunk
     mStream.seekp(offsetof(WavPrivate::WavHeader, dataChunkSize));
     mStream.write(reinterpret_cast<const char *>(&dataChunkSize), sizeof(dataChunkSize));
+
+    mStream.close();
+    if (mStream.fail()) {
+        mError = true;
+    }
+    return !mError;
 }
 
-std::ofstream const& Wav::stream() const {
-    return mStream;
+bool Wav::good() const {
+    return !mError;
 }
 
-void Wav::write(float buf[], std::size_t nsamples) {
+void Wav::write(float const buf[], std::size_t nsamples) {
 
-    std::size_t totalSamples = mChannels * nsamples;
-    mStream.write(reinterpret_cast<const char*>(buf), totalSamples * sizeof(float));
-    if (!mStream.good()) {
+    if (mError || mClosed) {
         return;
     }
 
+    std::size_t remaining = mChannels * nsamples;
+    while (remaining) {
+        auto dest = reinterpret_cast<char*>(mBuffers[mCurrent].get()) + mBufferUsed;
+        auto count = std::min(remaining, (BUFFER_SIZE - mBufferUsed) / mBytesPerSample);
+        convert(buf, count, dest);
+        buf += count;
+        remaining -= count;
+        mBufferUsed += count * mBytesPerSample;
+
+        if (BUFFER_SIZE - mBufferUsed < (std::size_t)mBytesPerSample) {
+            flush();
+            if (mError) {
+                return;
+            }
+        }
+    }
+
     mSampleCount += nsamples;
 
 }
+
+void Wav::convert(float const src[], std::size_t count, char *dest) {
+    switch (mFormat) {
+        case Format::float32:
+            std::memcpy(dest, src, count * sizeof(float));
+            break;
+        case Format::pcm16:
+            for (std::size_t i = 0; i < count; ++i) {
+                auto sample = (int16_t)WavPrivate::quantize(src[i], 32767.0f, mRng);
+                std::memcpy(dest, &sample, 2);
+                dest += 2;
+            }
+            break;
+        case Format::pcm24:
+            for (std::size_t i = 0; i < count; ++i) {
+                auto sample = WavPrivate::quantize(src[i], 8388607.0f, mRng);
+                // little endian, lowest 3 bytes
+                dest[0] = (char)(sample & 0xFF);
+                dest[1] = (char)((sample >> 8) & 0xFF);
+                dest[2] = (char)((sample >> 16) & 0xFF);
+                dest += 3;
+            }
+            break;
+    }
+}
+
+void Wav::flush() {
+    if (mBufferUsed == 0 || mError) {
+        return;
+    }
+
+    if (mThreaded) {
+        {
+            // wait for the writer to finish the previous buffer, then hand
+            // off this one and continue filling the other
+            std::unique_lock lock(mMutex);
+            mCv.wait(lock, [this]() { return mPending == 0; });
+            mPendingIndex = mCurrent;
+            mPending = mBufferUsed;
+        }
+        mCv.notify_all();
+        mCurrent ^= 1;
+    } else {
+        mStream.write(reinterpret_cast<const char*>(mBuffers[mCurrent].get()), mBufferUsed);
+        if (!mStream.good()) {
+            mError = true;
+        }
+    }
+    mBufferUsed = 0;
+}
+
+void Wav::writerMain() {
+    std::unique_lock lock(mMutex);
+    for (;;) {
+        mCv.wait(lock, [this]() { return mPending != 0 || mQuit; });
+        if (mPending == 0) {
+            // quit requested and nothing left to write
+            break;
+        }
+
+        auto const buffer = reinterpret_cast<const char*>(mBuffers[mPendingIndex].get());
+        auto const size = mPending;
+        lock.unlock();
+        if (!mError) {
+            mStream.write(buffer, size);
+            if (!mStream.good()) {
+                mError = true;
+            }
+        }
+        lock.lock();
+
+        mPending = 0;
+        mCv.notify_all();
+    }
+}
@@ -6,9 +6,13 @@
 **
 ** To create a file, construct a Wav object with a filepath, number of channels
 ** and samplerate. Then write as many samples you want to it via the write
-** method. Note that for multichannel data, the samples are interleaved.
+** method. Note that for multichannel data, the samples are interleaved. Call
+** close when done to finalize the file and check that it was written.
 **
-** This library only writes wav files using 32-bit float samples.
+** Samples are given as 32-bit float and can be stored as 32-bit float, or
+** converted to 16-bit or 24-bit PCM with TPDF dither. Writes are collected
+** in a large staging buffer and written to the file in big chunks, optionally
+** from a background writer thread.
 **
 ** stoneface86
 **
@@ -43,38 +47,68 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 
 class Wav {
 
 public:
 
+    //
+    // Sample format stored in the file.
+    //
+    enum class Format {
+        float32,    // 32-bit IEEE float, no conversion
+        pcm16,      // 16-bit signed integer, dithered
+        pcm24,      // 24-bit signed integer, dithered
+        last = pcm24
+    };
 
     //
     // Opens a wav file for writing sample data with the given channel count
-    // and samplerate. Existing files will be overwritten.
+    // and samplerate. Existing files will be overwritten. If threaded is true,
+    // full staging buffers are written to the file by a background thread so
+    // that the caller can continue producing samples.
     //
-    explicit Wav(std::string const& filename, int channels, int samplerate);
+    explicit Wav(
+        std::string const& filename,
+        int channels,
+        int samplerate,
+        Format format = Format::float32,
+        bool threaded = false
+    );
 
     //
-    // Adjusts the wav header with the final number of samples written and
-    // closes the file.
+    // Closes the file if close() was not called, any error is ignored.
     //
     ~Wav();
 
     //
-    // Get the stream used by the wav writer.
+    // Flushes any buffered samples, waits for the writer thread, adjusts the
+    // wav header with the final number of samples written and closes the
+    // file. Returns false if any of this or an earlier write failed, in which
+    // case the file is incomplete. No samples can be written afterwards.
     //
-    std::ofstream const& stream() const;
+    bool close();
+
+    //
+    // Returns false if the file could not be opened or a write failed.
+    //
+    bool good() const;
 
     //
     // Writes the given number of samples from the given buffer to the wav
     // file. The buffer should be at least the size of nsamples * channels.
     //
-    void write(float buf[], std::size_t nsamples);
+    void write(float const buf[], std::size_t nsamples);
 
 private:
 
@@ -86,10 +120,55 @@ private:
     Wav(Wav &&wav) = delete;
     Wav& operator=(Wav &&wav) = delete;
 
+    struct alignas(4096) Page {
+        char bytes[4096];
+    };
+
+    static constexpr std::size_t PAGES_PER_BUFFER = 1024;
+    static constexpr std::size_t BUFFER_SIZE = PAGES_PER_BUFFER * sizeof(Page);
+
+    //
+    // Converts interleaved samples to the file format, into dest.
+    //
+    void convert(float const src[], std::size_t count, char *dest);
+
+    //
+    // Writes the filled part of the current staging buffer to the file, or
+    // hands it off to the writer thread.
+    //
+    void flush();
+
+    void writerMain();
+
     std::ofstream mStream;
     std::size_t mSampleCount;
 
     int mChannels;
     int mSamplingRate;
+    Format mFormat;
+    int mBytesPerSample;
+
+    // state for the dither noise generator
+    uint32_t mRng;
+
+    // staging buffers, the second is only allocated in threaded mode
+    std::unique_ptr<Page[]> mBuffers[2];
+    // index of the buffer being filled and how many bytes it has
+    int mCurrent;
+    std::size_t mBufferUsed;
+
+    // writer thread, only used in threaded mode
+    bool mThreaded;
+    std::thread mWriter;
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    // buffer handed off to the writer and its size in bytes, a size of 0
+    // means the writer is idle
+    int mPendingIndex;
+    std::size_t mPending;
+    bool mQuit;
+
+    std::atomic_bool mError;
+    bool mClosed;
 
 };
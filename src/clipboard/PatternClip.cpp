@@ -145,6 +145,14 @@ bool PatternClip::hasData() const {
     return bool(mData);
 }
 
+size_t PatternClip::dataSize() const {
+    if (!mData) {
+        return 0;
+    }
+    auto iter = mLocation.iterator();
+    return TU::getRowLength(iter) * iter.rows();
+}
+
 PatternSelection const& PatternClip::selection() {
     return mLocation;
 }
@@ -46,6 +46,11 @@ public:
     //
     bool hasData() const;
 
+    //
+    // Size, in bytes, of the clipped data. 0 if there is no clip.
+    //
+    size_t dataSize() const;
+
     //
     // Gets the selection the clip was sourced from
     //
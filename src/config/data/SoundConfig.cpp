@@ -17,7 +17,11 @@ SoundConfig::SoundConfig() :
     mDeviceIndex(0),
     mSamplerateIndex(4),
     mLatency(40),
-    mPeriod(5)
+    mPeriod(5),
+    mRenderMode(RenderMode::push),
+    mRealtimePriority(false),
+    mRenderCpu(-1),
+    mLockMemory(false)
 {
 }
 
@@ -45,6 +49,22 @@ int SoundConfig::period() const {
     return mPeriod;
 }
 
+SoundConfig::RenderMode SoundConfig::renderMode() const {
+    return mRenderMode;
+}
+
+bool SoundConfig::realtimePriority() const {
+    return mRealtimePriority;
+}
+
+int SoundConfig::renderCpu() const {
+    return mRenderCpu;
+}
+
+bool SoundConfig::lockMemory() const {
+    return mLockMemory;
+}
+
 void SoundConfig::setBackendIndex(int index) {
     if (index >= -1) {
         mBackendIndex = index;
@@ -92,6 +112,30 @@ void SoundConfig::setPeriod(int period) {
     mPeriod = period;
 }
 
+void SoundConfig::setRenderMode(RenderMode mode) {
+    if (mode < RenderMode::push || mode > RenderMode::last) {
+        qWarning() << TU::LOG_PREFIX << "invalid render mode";
+        return;
+    }
+    mRenderMode = mode;
+}
+
+void SoundConfig::setRealtimePriority(bool realtime) {
+    mRealtimePriority = realtime;
+}
+
+void SoundConfig::setRenderCpu(int cpu) {
+    if (cpu < -1) {
+        qWarning() << TU::LOG_PREFIX << "invalid render cpu";
+        return;
+    }
+    mRenderCpu = cpu;
+}
+
+void SoundConfig::setLockMemory(bool lock) {
+    mLockMemory = lock;
+}
+
 void SoundConfig::readSettings(QSettings &settings, AudioEnumerator &enumerator) {
     settings.beginGroup(Keys::Sound);
 
@@ -127,6 +171,10 @@ void SoundConfig::readSettings(QSettings &settings, AudioEnumerator &enumerator)
     setSamplerate(settings.value(Keys::samplerate, samplerate()).toInt());
     setLatency(settings.value(Keys::latency, mLatency).toInt());
     setPeriod(settings.value(Keys::period, mPeriod).toInt());
+    setRenderMode(static_cast<RenderMode>(settings.value(Keys::renderMode, (int)mRenderMode).toInt()));
+    setRealtimePriority(settings.value(Keys::realtimePriority, mRealtimePriority).toBool());
+    setRenderCpu(settings.value(Keys::renderCpu, mRenderCpu).toInt());
+    setLockMemory(settings.value(Keys::lockMemory, mLockMemory).toBool());
 
     settings.endGroup();
 }
@@ -147,6 +195,10 @@ void SoundConfig::writeSettings(QSettings &settings, AudioEnumerator const& enum
     settings.setValue(Keys::samplerate, samplerate());
     settings.setValue(Keys::latency, mLatency);
     settings.setValue(Keys::period, mPeriod);
+    settings.setValue(Keys::renderMode, (int)mRenderMode);
+    settings.setValue(Keys::realtimePriority, mRealtimePriority);
+    settings.setValue(Keys::renderCpu, mRenderCpu);
+    settings.setValue(Keys::lockMemory, mLockMemory);
 
     settings.endGroup();
 }
@@ -15,6 +15,22 @@ public:
     static constexpr int MIN_LATENCY = 1;
     static constexpr int MAX_LATENCY = 500;
 
+    //
+    // Determines how the Renderer produces audio for the output device.
+    //
+    enum class RenderMode {
+        // a timer fills the playback buffer every period, and the device
+        // callback reads from this buffer
+        push,
+        // audio is synthesized inside the device callback, no playback buffer
+        // or timer is used
+        pull,
+        // like push, but periods are scheduled by a dedicated thread that is
+        // also woken by the device when the playback buffer runs low
+        clock,
+        last = clock
+    };
+
     SoundConfig();
     
     int backendIndex() const;
@@ -23,6 +39,10 @@ public:
     int samplerateIndex() const;
     int latency() const;
     int period() const;
+    RenderMode renderMode() const;
+    bool realtimePriority() const;
+    int renderCpu() const;
+    bool lockMemory() const;
 
     void setBackendIndex(int index);
 
@@ -35,6 +55,24 @@ public:
     void setLatency(int latency);
 
     void setPeriod(int period);
+
+    void setRenderMode(RenderMode mode);
+
+    //
+    // Request real-time scheduling for the render thread
+    //
+    void setRealtimePriority(bool realtime);
+
+    //
+    // Pin the render thread to the given CPU core, -1 for any core
+    //
+    void setRenderCpu(int cpu);
+
+    //
+    // Pre-fault and lock the process's memory so the render thread never
+    // waits on a page fault
+    //
+    void setLockMemory(bool lock);
     
     void readSettings(QSettings &settings, AudioEnumerator &enumerator);
 
@@ -47,4 +85,8 @@ private:
     int mSamplerateIndex;        // index of the current samplerate
     int mLatency;                // latency, or internal buffer size, in milliseconds
     int mPeriod;                 // period, in milliseconds
+    RenderMode mRenderMode;      // push or pull rendering
+    bool mRealtimePriority;      // request real-time scheduling for the render thread
+    int mRenderCpu;              // core to pin the render thread to, -1 for any
+    bool mLockMemory;            // lock memory pages for the render thread
 };
@@ -35,6 +35,10 @@ QString const samplerate { QStringLiteral("samplerate") };
 QString const period { QStringLiteral("period") };
 QString const latency { QStringLiteral("latency") };
 QString const deviceId { QStringLiteral("deviceId") };
+QString const renderMode { QStringLiteral("renderMode") };
+QString const realtimePriority { QStringLiteral("realtimePriority") };
+QString const renderCpu { QStringLiteral("renderCpu") };
+QString const lockMemory { QStringLiteral("lockMemory") };
 QString const noteCut { QStringLiteral("noteCut") };
 
 
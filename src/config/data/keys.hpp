@@ -46,6 +46,10 @@ extern QString const samplerate;
 extern QString const period;
 extern QString const latency;
 extern QString const deviceId;
+extern QString const renderMode;
+extern QString const realtimePriority;
+extern QString const renderCpu;
+extern QString const lockMemory;
 extern QString const noteCut;
 
 }
@@ -1,10 +1,12 @@
 ﻿
 #include "config/tabs/SoundConfigTab.hpp"
 #include "audio/AudioEnumerator.hpp"
+#include "audio/ThreadScheduling.hpp"
 #include "core/StandardRates.hpp"
 #include "midi/MidiEnumerator.hpp"
 #include "utils/connectutils.hpp"
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QGridLayout>
 #include <QGroupBox>
@@ -118,6 +120,24 @@ SoundConfigTab::SoundConfigTab(
     mSamplerateCombo = new QComboBox;
     audioLayout->addWidget(mSamplerateCombo, 2, 1);
 
+    // row 3, render mode
+    audioLayout->addWidget(new QLabel(tr("Render mode")), 3, 0);
+    mRenderModeCombo = new QComboBox;
+    audioLayout->addWidget(mRenderModeCombo, 3, 1);
+
+    // row 4, render thread core
+    audioLayout->addWidget(new QLabel(tr("Render core")), 4, 0);
+    mRenderCpuSpin = new QSpinBox;
+    audioLayout->addWidget(mRenderCpuSpin, 4, 1);
+
+    // row 5, render thread priority
+    mRealtimeCheck = new QCheckBox(tr("Real-time priority"));
+    audioLayout->addWidget(mRealtimeCheck, 5, 1);
+
+    // row 6, memory locking
+    mLockMemoryCheck = new QCheckBox(tr("Lock memory"));
+    audioLayout->addWidget(mLockMemoryCheck, 6, 1);
+
     audioGroup->setLayout(audioLayout);
 
     mMidiGroup = new DeviceGroup(tr("MIDI Input"));
@@ -141,9 +161,39 @@ SoundConfigTab::SoundConfigTab(
     }
 
     mSamplerateCombo->setCurrentIndex(soundConfig.samplerateIndex());
+
+    // combo index is the same as the SoundConfig::RenderMode value
+    mRenderModeCombo->addItem(tr("Timer (buffered)"));
+    mRenderModeCombo->addItem(tr("Device callback (low latency)"));
+    mRenderModeCombo->addItem(tr("Render thread (precise)"));
+    mRenderModeCombo->setToolTip(tr(
+        "Timer mode synthesizes audio every period into a playback buffer.\n"
+        "Device callback mode synthesizes audio when the device requests it, the\n"
+        "buffer size is used as the device's buffer size and the period is unused.\n"
+        "Render thread mode is the same as timer mode, but periods are scheduled\n"
+        "by a dedicated thread, which is also woken when the buffer runs low."
+    ));
+    mRenderModeCombo->setCurrentIndex((int)soundConfig.renderMode());
     mLatencySpin->setValue(soundConfig.latency());
     mPeriodSpin->setValue(soundConfig.period());
 
+    // -1 is shown as "Any"
+    mRenderCpuSpin->setMinimum(-1);
+    mRenderCpuSpin->setMaximum(ThreadScheduling::cpuCount() - 1);
+    mRenderCpuSpin->setSpecialValueText(tr("Any"));
+    mRenderCpuSpin->setValue(soundConfig.renderCpu());
+    mRenderCpuSpin->setToolTip(tr("Pins the render thread to a single CPU core"));
+    mRealtimeCheck->setChecked(soundConfig.realtimePriority());
+    mRealtimeCheck->setToolTip(tr(
+        "Requests real-time scheduling for the render thread. On Linux this\n"
+        "requires membership in a group with a real-time priority limit (ie audio).\n"
+        "If not permitted, the priority is raised as far as allowed."
+    ));
+    mLockMemoryCheck->setChecked(soundConfig.lockMemory());
+    mLockMemoryCheck->setToolTip(tr(
+        "Pre-faults and locks memory so the render thread is never paged out."
+    ));
+
     auto setupTimeSpinbox = [](QSpinBox &spin, int min, int max) {
         spin.setSuffix(tr(" ms"));
         spin.setMinimum(min);
@@ -158,6 +208,23 @@ SoundConfigTab::SoundConfigTab(
     connect(mSamplerateCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
     connect(mLatencySpin, qOverload<int>(&QSpinBox::valueChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
     connect(mPeriodSpin, qOverload<int>(&QSpinBox::valueChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
+    connect(mRenderModeCombo, qOverload<int>(&QComboBox::currentIndexChanged), this,
+        [this](int index) {
+            // the period is only used by the timer and the render thread
+            // so are the thread options, the device's thread is not ours
+            auto const ownThread = index != (int)SoundConfig::RenderMode::pull;
+            mPeriodSpin->setEnabled(ownThread);
+            mRenderCpuSpin->setEnabled(ownThread);
+            mRealtimeCheck->setEnabled(ownThread);
+            setDirty<Config::CategorySound>();
+        });
+    auto const ownThread = soundConfig.renderMode() != SoundConfig::RenderMode::pull;
+    mPeriodSpin->setEnabled(ownThread);
+    mRenderCpuSpin->setEnabled(ownThread);
+    mRealtimeCheck->setEnabled(ownThread);
+    connect(mRenderCpuSpin, qOverload<int>(&QSpinBox::valueChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
+    lazyconnect(mRealtimeCheck, toggled, this, setDirty<Config::CategorySound>);
+    lazyconnect(mLockMemoryCheck, toggled, this, setDirty<Config::CategorySound>);
 
     connect(mAudioGroup->mApiCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::audioApiChanged);
     connect(mAudioGroup->mDeviceCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &SoundConfigTab::setDirty<Config::CategorySound>);
@@ -176,6 +243,10 @@ void SoundConfigTab::apply(SoundConfig &soundConfig) {
 
     soundConfig.setLatency(mLatencySpin->value());
     soundConfig.setPeriod(mPeriodSpin->value());
+    soundConfig.setRenderMode(static_cast<SoundConfig::RenderMode>(mRenderModeCombo->currentIndex()));
+    soundConfig.setRenderCpu(mRenderCpuSpin->value());
+    soundConfig.setRealtimePriority(mRealtimeCheck->isChecked());
+    soundConfig.setLockMemory(mLockMemoryCheck->isChecked());
 
     clean();
 }
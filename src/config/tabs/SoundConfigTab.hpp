@@ -5,6 +5,7 @@
 class AudioEnumerator;
 class MidiEnumerator;
 
+class QCheckBox;
 class QComboBox;
 class QGroupBox;
 class QSpinBox;
@@ -60,6 +61,10 @@ private:
     QSpinBox *mLatencySpin;
     QSpinBox *mPeriodSpin;
     QComboBox *mSamplerateCombo;
+    QComboBox *mRenderModeCombo;
+    QSpinBox *mRenderCpuSpin;
+    QCheckBox *mRealtimeCheck;
+    QCheckBox *mLockMemoryCheck;
 
 
 };
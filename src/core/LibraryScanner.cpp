@@ -0,0 +1,157 @@
+#include "core/LibraryScanner.hpp"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
+
+#include <algorithm>
+
+#define TU LibraryScannerTU
+namespace TU {
+
+// how often, in milliseconds, progress is reported while indexing
+constexpr int PROGRESS_INTERVAL = 50;
+
+}
+
+
+LibraryScanner::LibraryScanner(QStringList const& directories, std::vector<ModuleLibrary::Entry> const& cached, QObject *parent) :
+    QThread(parent),
+    mDirectories(directories),
+    mCached(cached),
+    mPartial(false),
+    mEntries(),
+    mIndexedCount(0),
+    mAbort(false)
+{
+}
+
+void LibraryScanner::setPartial(bool partial) {
+    mPartial = partial;
+}
+
+void LibraryScanner::cancel() {
+    mAbort = true;
+}
+
+bool LibraryScanner::isCancelled() const {
+    return mAbort;
+}
+
+int LibraryScanner::indexedCount() const {
+    return mIndexedCount;
+}
+
+std::vector<ModuleLibrary::Entry> LibraryScanner::takeEntries() {
+    return std::move(mEntries);
+}
+
+void LibraryScanner::run() {
+    mEntries.clear();
+    mIndexedCount = 0;
+
+    QHash<QString, ModuleLibrary::Entry const*> cachedByPath;
+    for (auto const& entry : mCached) {
+        cachedByPath.insert(entry.path, &entry);
+    }
+
+    // find all modules, reusing cached entries for unchanged files. Entries
+    // that need indexing only have their path, size and modified time set
+    std::vector<size_t> stale;
+    QSet<QString> seen;
+    for (auto const& dir : mDirectories) {
+        QDirIterator iter(dir, { QStringLiteral("*.tbm") }, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+        while (iter.hasNext()) {
+            if (mAbort) {
+                mEntries.clear();
+                return;
+            }
+
+            iter.next();
+            auto const info = iter.fileInfo();
+            auto path = info.canonicalFilePath();
+            if (path.isEmpty() || seen.contains(path)) {
+                // broken link or found through overlapping directories
+                continue;
+            }
+            seen.insert(path);
+
+            auto const size = info.size();
+            auto const modified = info.lastModified().toMSecsSinceEpoch();
+            auto cached = cachedByPath.value(path);
+            if (cached && cached->size == size && cached->modified == modified) {
+                mEntries.push_back(*cached);
+            } else {
+                stale.push_back(mEntries.size());
+                auto &entry = mEntries.emplace_back();
+                entry.path = std::move(path);
+                entry.size = size;
+                entry.modified = modified;
+            }
+        }
+    }
+
+    mIndexedCount = (int)stale.size();
+    emit progressMax(mIndexedCount);
+
+    // each module is independent, so index them all at once
+    std::atomic_int indexed(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+    for (auto index : stale) {
+        pool.start([this, &entry = mEntries[index], &indexed]() {
+            if (!mAbort) {
+                entry = ModuleLibrary::index(entry.path, entry.size, entry.modified);
+            }
+            ++indexed;
+        });
+    }
+
+    int lastProgress = -1;
+    auto report = [&]() {
+        auto const amount = indexed.load();
+        if (amount != lastProgress) {
+            lastProgress = amount;
+            emit progress(amount);
+        }
+    };
+
+    while (!pool.waitForDone(TU::PROGRESS_INTERVAL)) {
+        report();
+    }
+    report();
+
+    if (mAbort) {
+        mEntries.clear();
+        return;
+    }
+
+    if (mPartial) {
+        // keep what we know about modules outside of the scanned directories,
+        // files under them that were not seen no longer exist
+        QStringList roots;
+        for (auto const& dir : mDirectories) {
+            QFileInfo info(dir);
+            auto root = info.canonicalFilePath();
+            roots.append(root.isEmpty() ? QDir::cleanPath(info.absoluteFilePath()) : root);
+        }
+        auto const isScanned = [&roots](QString const& path) {
+            return std::any_of(roots.cbegin(), roots.cend(),
+                [&path](QString const& root) {
+                    return path == root ||
+                           (path.startsWith(root) && (root.endsWith('/') || path.at(root.size()) == '/'));
+                });
+        };
+        for (auto const& entry : mCached) {
+            if (!seen.contains(entry.path) && !isScanned(entry.path)) {
+                mEntries.push_back(entry);
+            }
+        }
+    }
+}
+
+#undef TU
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "core/ModuleLibrary.hpp"
+
+#include <QStringList>
+#include <QThread>
+
+#include <atomic>
+#include <vector>
+
+//
+// Worker thread for scanning directories for modules. Module files found are
+// compared against the cached entries of the library, only files that are new
+// or whose size or modification time has changed are indexed. Indexing is done
+// in parallel on a thread pool.
+//
+class LibraryScanner : public QThread {
+    Q_OBJECT
+
+public:
+    LibraryScanner(QStringList const& directories, std::vector<ModuleLibrary::Entry> const& cached, QObject *parent = nullptr);
+
+    //
+    // A partial scan only covers some of the library's directories. Cached
+    // entries outside of the scanned directories are kept instead of being
+    // dropped. Must be set before the scan is started.
+    //
+    void setPartial(bool partial);
+
+    //
+    // Requests the scan to stop. Safe to call from any thread.
+    //
+    void cancel();
+
+    bool isCancelled() const;
+
+    //
+    // Number of files that had to be indexed in the last scan.
+    //
+    int indexedCount() const;
+
+    //
+    // Gets the entries of every module found in the last scan. Entries of
+    // files that no longer exist are dropped, along with every other cached
+    // entry unless the scan is partial. Empty if the scan was cancelled.
+    //
+    std::vector<ModuleLibrary::Entry> takeEntries();
+
+signals:
+    // progress is the number of files indexed
+    void progressMax(int max);
+    void progress(int amount);
+
+protected:
+    virtual void run() override;
+
+private:
+
+    QStringList mDirectories;
+    std::vector<ModuleLibrary::Entry> mCached;
+    bool mPartial;
+
+    std::vector<ModuleLibrary::Entry> mEntries;
+    int mIndexedCount;
+
+    std::atomic_bool mAbort;
+
+};
@@ -1,10 +1,13 @@
 
 #include "core/Module.hpp"
 
+#include "core/SongIndex.hpp"
+
 
 Module::Editor::Editor(Module &mod) :
     QMutexLocker<QMutex>(&mod.mMutex)
 {
+    ++mod.mRevision;
 }
 
 Module::PermanentEditor::PermanentEditor(Module &mod) :
@@ -25,9 +28,16 @@ Module::Module(QObject *parent) :
     mUndoGroup(new QUndoGroup(this)),
     mUndoStacks(),
     mSong(),
+    mRevision(0),
+    mSongIndex(),
+    mSongIndexSong(nullptr),
+    mSongIndexRevision(0),
+    mSongIndexPool(),
+    mSongIndexPending(false),
     mPermaDirty(false),
     mModified(false)
 {
+    mSongIndexPool.setMaxThreadCount(1);
     nameFirstSong();
     reset();
 
@@ -41,15 +51,39 @@ Module::Module(QObject *parent) :
         });
 }
 
+Module::~Module() {
+    // abandon any index build
+    {
+        QMutexLocker locker(&mMutex);
+        ++mRevision;
+    }
+    mSongIndexPool.waitForDone();
+}
+
 void Module::clear() {
     // clear song history
     mUndoStacks.clear();
 
-    mModule.clear();
+    {
+        QMutexLocker locker(&mMutex);
+        ++mRevision;
+        mModule.clear();
+    }
     nameFirstSong();
     reset();
 }
 
+void Module::replace(trackerboy::Module &&data) {
+    mUndoStacks.clear();
+
+    {
+        QMutexLocker locker(&mMutex);
+        ++mRevision;
+        mModule = std::move(data);
+    }
+    reset();
+}
+
 trackerboy::Module const& Module::data() const {
     return mModule;
 }
@@ -70,6 +104,53 @@ std::shared_ptr<trackerboy::Song> Module::songShared() {
     return mSong;
 }
 
+bool Module::isSongIndexCurrent() const {
+    return mSongIndex && mSongIndexSong == mSong.get() && mSongIndexRevision == mRevision;
+}
+
+std::shared_ptr<SongIndex const> Module::songIndex() const {
+    if (!isSongIndexCurrent()) {
+        auto index = std::make_shared<SongIndex>();
+        index->build(mModule, *mSong);
+        mSongIndex = std::move(index);
+        mSongIndexSong = mSong.get();
+        mSongIndexRevision = mRevision;
+    }
+    return mSongIndex;
+}
+
+std::shared_ptr<SongIndex const> Module::songIndexAsync() {
+    if (isSongIndexCurrent()) {
+        return mSongIndex;
+    }
+
+    if (!mSongIndexPending) {
+        mSongIndexPending = true;
+        auto song = mSong;
+        unsigned const revision = mRevision;
+        mSongIndexPool.start([this, song, revision]() {
+            auto index = std::make_shared<SongIndex>();
+            auto const complete = index->build(mModule, *song, mMutex,
+                [this, revision]() {
+                    return mRevision != revision;
+                });
+
+            QMetaObject::invokeMethod(this,
+                [this, index, song, revision, complete]() {
+                    mSongIndexPending = false;
+                    if (complete && song == mSong && revision == mRevision) {
+                        mSongIndex = index;
+                        mSongIndexSong = song.get();
+                        mSongIndexRevision = revision;
+                        emit songIndexReady();
+                    }
+                },
+                Qt::QueuedConnection);
+        });
+    }
+    return nullptr;
+}
+
 bool Module::isModified() const {
     return mModified;
 }
@@ -87,6 +168,7 @@ QUndoStack* Module::undoStack() {
 }
 
 void Module::reset() {
+    ++mRevision;
 
     setSong(0);
     clean();
@@ -134,6 +216,7 @@ void Module::setSong(int index) {
     } else {
         // no history for this song yet, create it and add to group
         stack = new QUndoStack(this);
+        stack->setUndoLimit(UNDO_LIMIT);
         mUndoGroup->addStack(stack);
         mUndoStacks.emplace(mSong.get(), stack);
     }
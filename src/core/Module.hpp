@@ -7,12 +7,17 @@
 #include <QMutex>
 #include <QMutexLocker>
 #include <QObject>
+#include <QThreadPool>
 #include <QUndoGroup>
 #include <QUndoStack>
 
+#include <atomic>
+#include <cstddef>
 #include <unordered_map>
 #include <memory>
 
+class SongIndex;
+
 //
 // Container class for a trackerboy::Module. Also contains a QMutex and
 // QUndoStacks for editing. Model classes edit the contained module.
@@ -53,7 +58,19 @@ public:
 
     };
 
+    //
+    // Undo history is bounded by memory. QUndoStack can only limit the number
+    // of commands, so the limit is the budget divided by the largest size a
+    // single command can have: a PasteCmd of an entire pattern, which keeps
+    // the pasted clip and the clip it replaced (2 x 8 KiB), or a fully merged
+    // TrackEditCmd (16 KiB).
+    //
+    static constexpr size_t UNDO_MEMORY_BUDGET = 32 * 1024 * 1024;
+    static constexpr size_t UNDO_COMMAND_MAX_SIZE = 32 * 1024;
+    static constexpr int UNDO_LIMIT = (int)(UNDO_MEMORY_BUDGET / UNDO_COMMAND_MAX_SIZE);
+
     explicit Module(QObject *parent = nullptr);
+    ~Module();
 
     //
     // Clears all data within the module and returns it to its default
@@ -61,6 +78,13 @@ public:
     //
     void clear();
 
+    //
+    // Replaces all data within the module with the given data, typically a
+    // module loaded on another thread. Undo history is discarded and the
+    // module is reset.
+    //
+    void replace(trackerboy::Module &&data);
+
     trackerboy::Module const& data() const;
     trackerboy::Module& data();
 
@@ -77,6 +101,22 @@ public:
     //
     std::shared_ptr<trackerboy::Song> songShared();
 
+    //
+    // Gets the playback index for the current song. The index is cached and
+    // only rebuilt when the module was edited since the last call. Must only
+    // be called from the GUI thread.
+    //
+    std::shared_ptr<SongIndex const> songIndex() const;
+
+    //
+    // Same as songIndex, but the index is never built on the calling thread.
+    // If the cached index is out of date, nullptr is returned and the index
+    // is built on a worker thread instead. songIndexReady is emitted once it
+    // has been cached. The build is abandoned if the module is edited before
+    // it completes.
+    //
+    std::shared_ptr<SongIndex const> songIndexAsync();
+
     bool isModified() const;
 
     QMutex& mutex();
@@ -167,12 +207,19 @@ signals:
     //
     void aboutToSave();
 
+    //
+    // Emitted when an index requested by songIndexAsync is ready.
+    //
+    void songIndexReady();
+
 private:
 
     Q_DISABLE_COPY(Module)
 
     void nameFirstSong();
 
+    bool isSongIndexCurrent() const;
+
     trackerboy::Module mModule;
 
     QMutex mMutex;
@@ -184,6 +231,18 @@ private:
 
     std::shared_ptr<trackerboy::Song> mSong;
 
+    // incremented whenever an edit begins or the module is reset, used for
+    // invalidating the song index. Edits and the data being replaced
+    // increment it with the mutex held, so that an index build on a worker
+    // thread can check it between bursts
+    std::atomic_uint mRevision;
+    mutable std::shared_ptr<SongIndex const> mSongIndex;
+    mutable trackerboy::Song const* mSongIndexSong;
+    mutable unsigned mSongIndexRevision;
+    // songIndexAsync builds here, one at a time
+    QThreadPool mSongIndexPool;
+    bool mSongIndexPending;
+
     // permanent dirty flag. Not all edits to the document can be undone. When such
     // edit occurs, this flag is set to true. It is reset when the document is
     // saved or when the document is reset or loaded from disk.
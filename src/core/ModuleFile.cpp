@@ -7,6 +7,7 @@
 #include <QtDebug>
 
 #include <fstream>
+#include <utility>
 
 ModuleFile::ModuleFile() :
     mFilename(),
@@ -17,25 +18,25 @@ ModuleFile::ModuleFile() :
 {
 }
 
-bool ModuleFile::open(QString const& path, Module &mod) {
-    
-    std::ifstream in(path.toStdString(), std::ios::binary | std::ios::in);
-    mIoError = in.fail();
-
-    if (!mIoError) {
-
-        mLastError = mod.data().deserialize(in);
-        mIoError = in.fail();
-        if (mLastError == trackerboy::FormatError::none) {
-            updateFilename(path);
-            // emits the reset signal
-            mod.reset();
-            return true;
-        } else {
-            // failed to deserialize module but the module might be paritially loaded
-            // clear it
-            mod.clear();
-        }
+bool ModuleFile::open(ModuleLoader &loader, Module &mod) {
+
+    if (loader.isCancelled()) {
+        return false;
+    }
+
+    mLastError = loader.error();
+    mIoError = loader.hasIoError();
+
+    auto data = loader.takeData();
+    if (data) {
+        updateFilename(loader.path());
+        // emits the reset signal
+        mod.replace(std::move(*data));
+        return true;
+    } else if (mLastError != trackerboy::FormatError::none) {
+        // deserialization failed, revert to a new document. (The document is
+        // left untouched if the file could not be opened)
+        mod.clear();
     }
 
     return false;
@@ -59,6 +60,28 @@ bool ModuleFile::save(QString const& filename, Module &mod) {
    
 }
 
+ModuleSaver* ModuleFile::saveInBackground(Module &mod, QObject *parent) {
+    if (mFilepath.isEmpty()) {
+        return nullptr;
+    }
+
+    auto saver = new ModuleSaver(mod, mFilepath, mAutoBackup, parent);
+    // edits made after this point will make the module dirty again
+    mod.clean();
+    saver->start();
+    return saver;
+}
+
+bool ModuleFile::finishSave(ModuleSaver &saver, Module &mod) {
+    saver.wait();
+    auto const success = saver.succeeded();
+    if (!success) {
+        // the snapshot never made it to disk
+        mod.makeDirty();
+    }
+    return success;
+}
+
 QString ModuleFile::crashSave(Module &mod) {
     // attempt to save a copy of the module
     // the copy is the same path of the module, but with .crash-%1 appended
@@ -132,54 +155,12 @@ void ModuleFile::setAutoBackup(bool backup) {
 }
 
 bool ModuleFile::doSave(QString const& filename, Module &mod) {
-    if (mAutoBackup) {
-        static constexpr auto errorPrefix = "failed to backup module:";
-
-        // backup the current file if it exists
-        QFileInfo info(filename);
-        if (info.exists() && info.isFile()) {
-            do { // do-once and break on error
-
-                // Qt doesn't have an overwrite file copy function so
-                // we'll have to remove first and then copy
-
-                QFileInfo backupInfo(filename + ".bak");
-                QString backupPath = backupInfo.filePath();
-                if (backupInfo.exists()) {
-                    if (!backupInfo.isFile()) {
-                        // ERROR! the backup dest is not a file!
-                        qWarning() << errorPrefix << "backup destination in use";
-                        break;
-                    }
-                    // remove old backup
-                    if (!QFile::remove(backupPath)) {
-                        // ERROR! failed to remove existing backup
-                        qWarning() << errorPrefix << "cannot remove existing backup";
-                        break;
-                    }
-                }
-                if (!QFile::copy(filename, backupPath)) {
-                    // ERROR! failed to backup module
-                    qWarning() << errorPrefix << "cannot copy existing module";
-                    break;
-                }
-                qInfo() << "module backup saved to" << backupPath;
-            } while (false);
-        }
-    }
-
-    bool success = false;
-    std::ofstream out(filename.toStdString(), std::ios::binary | std::ios::out);
-    if (out.good()) {
-        mod.beginSave();
-        success = mod.data().serialize(out) == trackerboy::FormatError::none;
-        if (success) {
-            mod.clean();
-        }
-
+    ModuleSaver saver(mod, filename, mAutoBackup);
+    saver.save();
+    auto const success = saver.succeeded();
+    if (success) {
+        mod.clean();
     }
-
-    out.close();
     return success;
 }
 
@@ -2,6 +2,8 @@
 #pragma once
 
 #include "core/Module.hpp"
+#include "core/ModuleLoader.hpp"
+#include "core/ModuleSaver.hpp"
 
 #include <QString>
 
@@ -15,9 +17,13 @@ public:
 
     ModuleFile();
 
-    // open the module, true is returned on success. On failure the document
-    // is reverted to a new document.
-    bool open(QString const& filename, Module &mod);
+    //
+    // Completes opening a module loaded by the given loader, which must have
+    // finished. On success the loaded data replaces the module's data and true
+    // is returned. On failure the document is reverted to a new document. A
+    // cancelled load leaves the document as is and returns false.
+    //
+    bool open(ModuleLoader &loader, Module &mod);
 
     //
     // saves the document to the previously loaded/saved file
@@ -29,6 +35,20 @@ public:
     //
     bool save(QString const& filename, Module &mod);
 
+    //
+    // Saves the document to the previously loaded/saved file on a worker
+    // thread. The module is snapshotted and marked clean, the returned saver
+    // has been started and must be passed to finishSave once it has finished.
+    // nullptr is returned if the document has no file.
+    //
+    ModuleSaver* saveInBackground(Module &mod, QObject *parent = nullptr);
+
+    //
+    // Completes a save started by saveInBackground. If the save failed, the
+    // module is marked as modified again and false is returned.
+    //
+    bool finishSave(ModuleSaver &saver, Module &mod);
+
     //
     // Saves a copy of the given module data using this module's file info.
     // The file path of the saved copy is returned on success, amy empty string is
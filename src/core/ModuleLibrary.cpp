@@ -0,0 +1,251 @@
+#include "core/ModuleLibrary.hpp"
+
+#include "core/ModuleLoader.hpp"
+#include "core/ModuleMetadata.hpp"
+#include "core/SongIndex.hpp"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+#define TU ModuleLibraryTU
+namespace TU {
+
+constexpr quint32 CACHE_MAGIC = 0x54424C43; // "TBLC"
+// increment when the layout of the cache changes, old caches are discarded
+constexpr quint32 CACHE_VERSION = 1;
+
+static QString infoStr(trackerboy::InfoStr const& str) {
+    return QString::fromUtf8(str.data(), (int)str.length());
+}
+
+template <class Table>
+static int tableCount(Table const& table) {
+    int count = 0;
+    for (int id = 0; id < (int)trackerboy::InstrumentTable::MAX_SIZE; ++id) {
+        if (table.getShared((uint8_t)id) != nullptr) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+static bool pathLess(ModuleLibrary::Entry const& entry, QString const& path) {
+    return entry.path < path;
+}
+
+}
+
+static QDataStream& operator<<(QDataStream &stream, ModuleLibrary::Song const& song) {
+    stream << song.name << song.patterns << song.rowsPerPattern << song.frames << song.loops;
+    return stream;
+}
+
+static QDataStream& operator>>(QDataStream &stream, ModuleLibrary::Song &song) {
+    stream >> song.name >> song.patterns >> song.rowsPerPattern >> song.frames >> song.loops;
+    return stream;
+}
+
+static QDataStream& operator<<(QDataStream &stream, ModuleLibrary::Entry const& entry) {
+    stream << entry.path << entry.size << entry.modified << entry.valid;
+    stream << entry.title << entry.artist << entry.copyright;
+    stream << entry.framerate << entry.instrumentCount << entry.waveCount;
+    stream << (quint32)entry.songs.size();
+    for (auto const& song : entry.songs) {
+        stream << song;
+    }
+    return stream;
+}
+
+static QDataStream& operator>>(QDataStream &stream, ModuleLibrary::Entry &entry) {
+    stream >> entry.path >> entry.size >> entry.modified >> entry.valid;
+    stream >> entry.title >> entry.artist >> entry.copyright;
+    stream >> entry.framerate >> entry.instrumentCount >> entry.waveCount;
+    quint32 songCount;
+    stream >> songCount;
+    // a module has at most 256 songs, anything more is a corrupted cache
+    if (songCount > 256) {
+        stream.setStatus(QDataStream::ReadCorruptData);
+        return stream;
+    }
+    entry.songs.resize(songCount);
+    for (auto &song : entry.songs) {
+        stream >> song;
+    }
+    return stream;
+}
+
+
+double ModuleLibrary::Entry::duration(Song const& song) const {
+    if (framerate <= 0.0f) {
+        return 0.0;
+    }
+    return song.frames / (double)framerate;
+}
+
+bool ModuleLibrary::Entry::matches(QString const& text) const {
+    if (text.isEmpty()) {
+        return true;
+    }
+
+    auto contains = [&text](QString const& str) {
+        return str.contains(text, Qt::CaseInsensitive);
+    };
+
+    if (contains(title) || contains(artist) || contains(copyright) || contains(QFileInfo(path).fileName())) {
+        return true;
+    }
+    return std::any_of(songs.begin(), songs.end(),
+        [&contains](Song const& song) {
+            return contains(song.name);
+        });
+}
+
+ModuleLibrary::ModuleLibrary() :
+    mEntries()
+{
+}
+
+QString ModuleLibrary::defaultCachePath() {
+    return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(QStringLiteral("library.cache"));
+}
+
+bool ModuleLibrary::load(QString const& cachePath) {
+    mEntries.clear();
+
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic, version, count;
+    stream >> magic >> version >> count;
+    if (stream.status() != QDataStream::Ok || magic != TU::CACHE_MAGIC || version != TU::CACHE_VERSION) {
+        return false;
+    }
+
+    std::vector<Entry> entries;
+    for (quint32 i = 0; i < count; ++i) {
+        Entry entry;
+        stream >> entry;
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+        entries.push_back(std::move(entry));
+    }
+
+    setEntries(std::move(entries));
+    return true;
+}
+
+bool ModuleLibrary::save(QString const& cachePath) const {
+    QDir().mkpath(QFileInfo(cachePath).absolutePath());
+
+    // the cache is shared by the GUI and command line, write it atomically
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << TU::CACHE_MAGIC << TU::CACHE_VERSION << (quint32)mEntries.size();
+    for (auto const& entry : mEntries) {
+        stream << entry;
+    }
+
+    return stream.status() == QDataStream::Ok && file.commit();
+}
+
+std::vector<ModuleLibrary::Entry> const& ModuleLibrary::entries() const {
+    return mEntries;
+}
+
+void ModuleLibrary::setEntries(std::vector<Entry> &&entries) {
+    mEntries = std::move(entries);
+    std::sort(mEntries.begin(), mEntries.end(),
+        [](Entry const& lhs, Entry const& rhs) {
+            return lhs.path < rhs.path;
+        });
+}
+
+ModuleLibrary::Entry const* ModuleLibrary::find(QString const& path) const {
+    auto iter = std::lower_bound(mEntries.begin(), mEntries.end(), path, TU::pathLess);
+    if (iter != mEntries.end() && iter->path == path) {
+        return &*iter;
+    }
+    return nullptr;
+}
+
+std::vector<ModuleLibrary::Entry const*> ModuleLibrary::query(QString const& text) const {
+    std::vector<Entry const*> results;
+    for (auto const& entry : mEntries) {
+        if (entry.valid && entry.matches(text)) {
+            results.push_back(&entry);
+        }
+    }
+    return results;
+}
+
+ModuleLibrary::Entry ModuleLibrary::index(QString const& path, qint64 size, qint64 modified) {
+    Entry entry;
+    entry.path = path;
+    entry.size = size;
+    entry.modified = modified;
+
+    // the header rules out files that are not modules, or are from a newer
+    // version of Trackerboy, without loading them. Older revisions have a
+    // different header, those are left for the loader to upgrade
+    ModuleMetadata metadata;
+    if (!metadata.read(path)) {
+        auto const upgradable = metadata.error == ModuleMetadata::Error::unsupportedRevision &&
+                                metadata.revisionMajor < ModuleMetadata::SUPPORTED_REVISION;
+        if (!upgradable) {
+            return entry;
+        }
+    }
+
+    ModuleLoader loader(path);
+    loader.load();
+    auto data = loader.takeData();
+    if (!data) {
+        return entry;
+    }
+
+    trackerboy::Module &mod = *data;
+    entry.valid = true;
+    entry.title = TU::infoStr(mod.title());
+    entry.artist = TU::infoStr(mod.artist());
+    entry.copyright = TU::infoStr(mod.copyright());
+    entry.framerate = mod.framerate();
+    entry.instrumentCount = TU::tableCount(mod.instrumentTable());
+    entry.waveCount = TU::tableCount(mod.waveformTable());
+
+    auto const& songs = mod.songs();
+    auto const songCount = (int)songs.size();
+    entry.songs.resize(songCount);
+    for (int i = 0; i < songCount; ++i) {
+        auto const song = songs.get(i);
+        auto &songEntry = entry.songs[i];
+        songEntry.name = QString::fromStdString(song->name());
+        songEntry.patterns = (int)song->order().size();
+        songEntry.rowsPerPattern = (int)song->patterns().length();
+
+        SongIndex songIndex;
+        songIndex.build(mod, *song);
+        songEntry.frames = songIndex.length();
+        songEntry.loops = songIndex.loopVisit() != -1;
+    }
+
+    return entry;
+}
+
+#undef TU
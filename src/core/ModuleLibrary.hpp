@@ -0,0 +1,111 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+#include <vector>
+
+//
+// Index of module files found in a set of directories. Each entry holds
+// information extracted from the module so that modules can be browsed and
+// searched without opening them one by one. The index is persisted to a cache
+// file, entries are keyed by path, size and modification time so that a
+// rescan only needs to index new or changed files (see LibraryScanner).
+//
+class ModuleLibrary {
+
+public:
+
+    struct Song {
+        QString name;
+        int patterns = 0;
+        int rowsPerPattern = 0;
+        // number of frames until the song loops or halts
+        int frames = 0;
+        bool loops = false;
+    };
+
+    struct Entry {
+        QString path;
+        qint64 size = 0;
+        // modification time, in milliseconds since epoch
+        qint64 modified = 0;
+
+        // false if the file could not be loaded
+        bool valid = false;
+
+        QString title;
+        QString artist;
+        QString copyright;
+        float framerate = 0.0f;
+        int instrumentCount = 0;
+        int waveCount = 0;
+        std::vector<Song> songs;
+
+        //
+        // Estimated duration of the given song, in seconds. For looping songs
+        // this is the duration of a single play.
+        //
+        double duration(Song const& song) const;
+
+        //
+        // Determines if the entry matches the given search text. The text is
+        // matched, case insensitive, against the title, artist, copyright,
+        // song names and file name.
+        //
+        bool matches(QString const& text) const;
+    };
+
+    ModuleLibrary();
+
+    //
+    // Default location of the cache file, in the user's cache directory.
+    //
+    static QString defaultCachePath();
+
+    //
+    // Loads entries from the given cache file, replacing the current entries.
+    // false is returned if the cache could not be read or is from an
+    // incompatible version, in which case the library is emptied.
+    //
+    bool load(QString const& cachePath);
+
+    //
+    // Writes all entries to the given cache file.
+    //
+    bool save(QString const& cachePath) const;
+
+    //
+    // All entries, sorted by path.
+    //
+    std::vector<Entry> const& entries() const;
+
+    //
+    // Replaces all entries, typically with the results of a LibraryScanner.
+    //
+    void setEntries(std::vector<Entry> &&entries);
+
+    //
+    // Gets the entry for the given path, nullptr if the path is not indexed.
+    //
+    Entry const* find(QString const& path) const;
+
+    //
+    // Gets all valid entries that match the given search text. An empty text
+    // matches every entry.
+    //
+    std::vector<Entry const*> query(QString const& text) const;
+
+    //
+    // Extracts the information for the module at the given path by loading it
+    // and playing each song once, without output, to determine its length.
+    // Files whose header (see ModuleMetadata) shows they cannot be loaded are
+    // rejected without loading. Safe to call from any thread.
+    //
+    static Entry index(QString const& path, qint64 size, qint64 modified);
+
+private:
+
+    std::vector<Entry> mEntries;
+
+};
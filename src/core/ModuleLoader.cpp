@@ -0,0 +1,229 @@
+#include "core/ModuleLoader.hpp"
+
+#include <QFile>
+#include <QtDebug>
+
+#include <algorithm>
+#include <exception>
+#include <istream>
+#include <memory>
+#include <streambuf>
+
+#define TU ModuleLoaderTU
+namespace TU {
+
+constexpr qint64 PROGRESS_UNIT = 1024;
+
+//
+// Input stream buffer for a QFile. If the file could be memory mapped, the
+// get area points directly into the mapping, otherwise the file is read into
+// an intermediate buffer. In both cases the file is consumed in blocks so that
+// progress is reported after each block and reading stops early when the abort
+// flag is set, which makes deserialization fail on the next read.
+//
+template <class ProgressFn>
+class ProgressBuf : public std::streambuf {
+
+    static constexpr qint64 BLOCK_SIZE = 64 * 1024;
+
+public:
+    ProgressBuf(QFile &file, std::atomic_bool const& abort, ProgressFn progressFn) :
+        mFile(file),
+        mAbort(abort),
+        mProgressFn(progressFn),
+        mSize(file.size()),
+        mMap(nullptr),
+        mPos(0),
+        mBuffer()
+    {
+        if (mSize > 0) {
+            mMap = reinterpret_cast<char*>(mFile.map(0, mSize));
+        }
+        if (mMap == nullptr) {
+            // not mappable (ie a sequential device), fallback to buffered reads
+            mBuffer = std::make_unique<char[]>(BLOCK_SIZE);
+        }
+    }
+
+    ~ProgressBuf() {
+        if (mMap) {
+            mFile.unmap(reinterpret_cast<uchar*>(mMap));
+        }
+    }
+
+    bool readError() const {
+        return mFile.error() != QFileDevice::NoError;
+    }
+
+protected:
+
+    virtual int_type underflow() override {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+
+        if (mAbort.load(std::memory_order_relaxed)) {
+            return traits_type::eof();
+        }
+
+        char *block;
+        qint64 count;
+        if (mMap) {
+            block = mMap + mPos;
+            count = std::min(BLOCK_SIZE, mSize - mPos);
+            mPos += std::max(count, qint64(0));
+        } else {
+            block = mBuffer.get();
+            count = mFile.read(block, BLOCK_SIZE);
+            mPos = mFile.pos();
+        }
+        if (count <= 0) {
+            return traits_type::eof();
+        }
+        setg(block, block, block + count);
+        mProgressFn(mPos);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+
+        // logical position is the end of the block minus what is left in it
+        qint64 const current = mPos - (egptr() - gptr());
+        qint64 target;
+        switch (dir) {
+            case std::ios_base::beg:
+                target = off;
+                break;
+            case std::ios_base::cur:
+                if (off == 0) {
+                    // tellg(), no need to drop the block
+                    return pos_type(current);
+                }
+                target = current + off;
+                break;
+            default:
+                target = mSize + off;
+                break;
+        }
+
+        if (target < 0 || target > mSize) {
+            return pos_type(off_type(-1));
+        }
+        if (mMap == nullptr && !mFile.seek(target)) {
+            return pos_type(off_type(-1));
+        }
+        mPos = target;
+        setg(nullptr, nullptr, nullptr);
+        return pos_type(target);
+    }
+
+    virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which) override {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+
+private:
+    QFile &mFile;
+    std::atomic_bool const& mAbort;
+    ProgressFn mProgressFn;
+
+    qint64 const mSize;
+    // start of the file mapping, or nullptr if not mapped
+    char *mMap;
+    // file offset of the end of the current block
+    qint64 mPos;
+    std::unique_ptr<char[]> mBuffer;
+
+};
+
+static int toProgress(qint64 bytes) {
+    return (int)((bytes + PROGRESS_UNIT - 1) / PROGRESS_UNIT);
+}
+
+}
+
+
+ModuleLoader::ModuleLoader(QString const& path, QObject *parent) :
+    QThread(parent),
+    mPath(path),
+    mData(),
+    mError(trackerboy::FormatError::none),
+    mIoError(false),
+    mAbort(false)
+{
+}
+
+QString const& ModuleLoader::path() const {
+    return mPath;
+}
+
+void ModuleLoader::cancel() {
+    mAbort = true;
+}
+
+bool ModuleLoader::isCancelled() const {
+    return mAbort;
+}
+
+trackerboy::FormatError ModuleLoader::error() const {
+    return mError;
+}
+
+bool ModuleLoader::hasIoError() const {
+    return mIoError;
+}
+
+std::unique_ptr<trackerboy::Module> ModuleLoader::takeData() {
+    return std::move(mData);
+}
+
+void ModuleLoader::run() {
+    load();
+}
+
+void ModuleLoader::load() {
+    mData.reset();
+    mError = trackerboy::FormatError::none;
+
+    QFile file(mPath);
+    mIoError = !file.open(QIODevice::ReadOnly);
+    if (mIoError) {
+        return;
+    }
+
+    emit progressMax(TU::toProgress(file.size()));
+
+    int lastProgress = -1;
+    auto onProgress = [this, &lastProgress](qint64 bytes) {
+        auto const amount = TU::toProgress(bytes);
+        if (amount != lastProgress) {
+            lastProgress = amount;
+            emit progress(amount);
+        }
+    };
+    TU::ProgressBuf buf(file, mAbort, onProgress);
+    std::istream in(&buf);
+
+    auto data = std::make_unique<trackerboy::Module>();
+    try {
+        mError = data->deserialize(in);
+    } catch (std::exception const& e) {
+        // an exception here would otherwise terminate the application from
+        // this thread, so treat the module as corrupted instead
+        qCritical().noquote() << "[ModuleLoader] exception while loading" << mPath << ":" << e.what();
+        mError = trackerboy::FormatError::invalid;
+    }
+
+    if (mAbort) {
+        return;
+    }
+
+    mIoError = in.fail() || buf.readError();
+    if (mError == trackerboy::FormatError::none) {
+        mData = std::move(data);
+    }
+}
+
+#undef TU
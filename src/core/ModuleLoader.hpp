@@ -0,0 +1,79 @@
+#pragma once
+
+#include "trackerboy/data/Module.hpp"
+
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+
+//
+// Worker thread for loading a module file. The module is deserialized into
+// a fresh trackerboy::Module so that the document being edited is untouched
+// until loading completes. Once finished, pass the loader to
+// ModuleFile::open on the GUI thread to swap the loaded data in.
+//
+// The file is memory mapped when possible so the deserializer reads straight
+// from the page cache. Use ModuleMetadata when only the module's information
+// is needed.
+//
+class ModuleLoader : public QThread {
+    Q_OBJECT
+
+public:
+    explicit ModuleLoader(QString const& path, QObject *parent = nullptr);
+
+    //
+    // Path of the module file being loaded
+    //
+    QString const& path() const;
+
+    //
+    // Loads the module on the calling thread. run() just calls this method.
+    //
+    void load();
+
+    //
+    // Requests the load to stop. Safe to call from any thread. A cancelled
+    // load does not report an error.
+    //
+    void cancel();
+
+    bool isCancelled() const;
+
+    //
+    // Result of deserialization, FormatError::none on success.
+    //
+    trackerboy::FormatError error() const;
+
+    //
+    // Returns true if the file could not be opened or read
+    //
+    bool hasIoError() const;
+
+    //
+    // Takes ownership of the loaded module data. nullptr is returned if the
+    // load did not succeed or the data was already taken.
+    //
+    std::unique_ptr<trackerboy::Module> takeData();
+
+signals:
+    // progress is reported in kibibytes read from the file
+    void progressMax(int max);
+    void progress(int amount);
+
+protected:
+    virtual void run() override;
+
+private:
+
+    QString mPath;
+
+    std::unique_ptr<trackerboy::Module> mData;
+    trackerboy::FormatError mError;
+    bool mIoError;
+
+    std::atomic_bool mAbort;
+
+};
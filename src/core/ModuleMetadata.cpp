@@ -0,0 +1,129 @@
+#include "core/ModuleMetadata.hpp"
+
+#include <QFile>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#define TU ModuleMetadataTU
+namespace TU {
+
+//
+// Header layout for major revision 1, all integers are little endian. This
+// must be kept in sync with libtrackerboy's fileformat.
+//
+// offset  size  field
+//      0    12  signature
+//     12    12  libtrackerboy version (3 x u32)
+//     24     1  revision major
+//     25     1  revision minor
+//     26     2  reserved
+//     28    32  title
+//     60    32  artist
+//     92    32  copyright
+//    124     1  instrument count
+//    125     1  song count - 1
+//    126     1  waveform count
+//    127     1  system
+//    128     2  custom framerate
+//    130    30  reserved
+//
+constexpr char SIGNATURE[12] = { '\0', 'T', 'R', 'A', 'C', 'K', 'E', 'R', 'B', 'O', 'Y', '\0' };
+
+constexpr int OFFSET_REV_MAJOR = 24;
+constexpr int OFFSET_REV_MINOR = 25;
+constexpr int OFFSET_TITLE = 28;
+constexpr int OFFSET_ARTIST = 60;
+constexpr int OFFSET_COPYRIGHT = 92;
+constexpr int OFFSET_ICOUNT = 124;
+constexpr int OFFSET_SCOUNT = 125;
+constexpr int OFFSET_WCOUNT = 126;
+constexpr int OFFSET_SYSTEM = 127;
+constexpr int OFFSET_FRAMERATE = 128;
+constexpr int INFO_SIZE = 32;
+
+// same framerates used by libtrackerboy for the DMG and SGB systems
+constexpr float FRAMERATE_DMG = 59.7f;
+constexpr float FRAMERATE_SGB = 61.1f;
+
+static QString infoStr(char const *header, int offset) {
+    // info strings are utf-8 and padded with nul bytes
+    auto const str = header + offset;
+    return QString::fromUtf8(str, (int)strnlen(str, INFO_SIZE));
+}
+
+static uint8_t u8(char const *header, int offset) {
+    return static_cast<uint8_t>(header[offset]);
+}
+
+}
+
+
+bool ModuleMetadata::read(QString const& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = Error::unreadable;
+        return false;
+    }
+
+    std::array<char, HEADER_SIZE> header;
+    if (file.read(header.data(), HEADER_SIZE) != HEADER_SIZE) {
+        error = Error::unreadable;
+        return false;
+    }
+    return parse(header.data());
+}
+
+bool ModuleMetadata::parse(char const *header) {
+    if (std::memcmp(header, TU::SIGNATURE, sizeof(TU::SIGNATURE))) {
+        error = Error::notModule;
+        return false;
+    }
+
+    revisionMajor = TU::u8(header, TU::OFFSET_REV_MAJOR);
+    revisionMinor = TU::u8(header, TU::OFFSET_REV_MINOR);
+    if (revisionMajor != SUPPORTED_REVISION) {
+        // older revisions have a different header layout and newer ones
+        // are unknown
+        error = Error::unsupportedRevision;
+        return false;
+    }
+    error = Error::none;
+
+    title = TU::infoStr(header, TU::OFFSET_TITLE);
+    artist = TU::infoStr(header, TU::OFFSET_ARTIST);
+    copyright = TU::infoStr(header, TU::OFFSET_COPYRIGHT);
+
+    instrumentCount = TU::u8(header, TU::OFFSET_ICOUNT);
+    songCount = TU::u8(header, TU::OFFSET_SCOUNT) + 1;
+    waveCount = TU::u8(header, TU::OFFSET_WCOUNT);
+
+    switch (TU::u8(header, TU::OFFSET_SYSTEM)) {
+        case 1:
+            system = trackerboy::System::sgb;
+            break;
+        case 2:
+            system = trackerboy::System::custom;
+            break;
+        default:
+            system = trackerboy::System::dmg;
+            break;
+    }
+    customFramerate = TU::u8(header, TU::OFFSET_FRAMERATE) | (TU::u8(header, TU::OFFSET_FRAMERATE + 1) << 8);
+
+    return true;
+}
+
+float ModuleMetadata::framerate() const {
+    switch (system) {
+        case trackerboy::System::sgb:
+            return TU::FRAMERATE_SGB;
+        case trackerboy::System::custom:
+            return (float)customFramerate;
+        default:
+            return TU::FRAMERATE_DMG;
+    }
+}
+
+#undef TU
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "trackerboy/data/Module.hpp"
+
+#include <QString>
+
+//
+// Information about a module file that is available from its header. Reading
+// the metadata only reads the first 160 bytes of the file, no songs,
+// instruments or waveforms are deserialized, making it suitable for scanning
+// large numbers of modules.
+//
+struct ModuleMetadata {
+
+    enum class Error {
+        none,
+        unreadable,             // the file could not be opened or is too small
+        notModule,              // the signature does not match
+        unsupportedRevision     // see revisionMajor
+    };
+
+    // reason the last read or parse failed
+    Error error = Error::none;
+
+    QString title;
+    QString artist;
+    QString copyright;
+
+    // file format revision, only valid when the signature matched
+    int revisionMajor = 0;
+    int revisionMinor = 0;
+
+    int songCount = 0;
+    int instrumentCount = 0;
+    int waveCount = 0;
+
+    trackerboy::System system = trackerboy::System::dmg;
+    int customFramerate = 0;
+
+    //
+    // Reads the header of the module file at the given path. false is returned
+    // if the file could not be read, is not a module, or has a header revision
+    // that is not supported (in which case loading the module with
+    // ModuleLoader is the only option).
+    //
+    bool read(QString const& path);
+
+    //
+    // Parses a header from the given buffer, which must be at least
+    // HEADER_SIZE bytes. See read().
+    //
+    bool parse(char const *header);
+
+    //
+    // Framerate of the module, in Hz
+    //
+    float framerate() const;
+
+    static constexpr int HEADER_SIZE = 160;
+
+    // the only major revision whose header layout is known
+    static constexpr int SUPPORTED_REVISION = 1;
+
+};
@@ -0,0 +1,113 @@
+#include "core/ModuleSaver.hpp"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtDebug>
+
+#include <sstream>
+
+#define TU ModuleSaverTU
+namespace TU {
+
+//
+// Copies the file at the given path to path.bak, replacing any existing
+// backup.
+//
+static void backup(QString const& filename) {
+    static constexpr auto errorPrefix = "failed to backup module:";
+
+    // backup the current file if it exists
+    QFileInfo info(filename);
+    if (info.exists() && info.isFile()) {
+        // Qt doesn't have an overwrite file copy function so
+        // we'll have to remove first and then copy
+
+        QFileInfo backupInfo(filename + ".bak");
+        QString backupPath = backupInfo.filePath();
+        if (backupInfo.exists()) {
+            if (!backupInfo.isFile()) {
+                // ERROR! the backup dest is not a file!
+                qWarning() << errorPrefix << "backup destination in use";
+                return;
+            }
+            // remove old backup
+            if (!QFile::remove(backupPath)) {
+                // ERROR! failed to remove existing backup
+                qWarning() << errorPrefix << "cannot remove existing backup";
+                return;
+            }
+        }
+        if (!QFile::copy(filename, backupPath)) {
+            // ERROR! failed to backup module
+            qWarning() << errorPrefix << "cannot copy existing module";
+            return;
+        }
+        qInfo() << "module backup saved to" << backupPath;
+    }
+}
+
+}
+
+
+ModuleSaver::ModuleSaver(Module &mod, QString const& path, bool backup, QObject *parent) :
+    QThread(parent),
+    mPath(path),
+    mBackup(backup),
+    mSnapshot(),
+    mSnapshotValid(false),
+    mSuccess(false)
+{
+    // models write any uncommitted data first
+    mod.beginSave();
+
+    // serializing to memory is quick compared to writing to disk, so the
+    // module (and the render thread) is only locked for a short time
+    std::ostringstream out(std::ios::binary | std::ios::out);
+    {
+        QMutexLocker locker(&mod.mutex());
+        mSnapshotValid = mod.data().serialize(out) == trackerboy::FormatError::none;
+    }
+    if (mSnapshotValid) {
+        mSnapshot = out.str();
+    }
+}
+
+QString const& ModuleSaver::path() const {
+    return mPath;
+}
+
+bool ModuleSaver::succeeded() const {
+    return mSuccess;
+}
+
+void ModuleSaver::run() {
+    save();
+}
+
+void ModuleSaver::save() {
+    mSuccess = false;
+    if (!mSnapshotValid) {
+        return;
+    }
+
+    if (mBackup) {
+        TU::backup(mPath);
+    }
+
+    // QSaveFile writes to a temporary file and renames it to the destination
+    // on commit. If anything fails, the existing file is left untouched
+    QSaveFile file(mPath);
+    if (file.open(QIODevice::WriteOnly)) {
+        auto const size = (qint64)mSnapshot.size();
+        if (file.write(mSnapshot.data(), size) == size) {
+            mSuccess = file.commit();
+        }
+    }
+
+    if (!mSuccess) {
+        qWarning().noquote() << "[ModuleSaver] failed to write" << mPath << ":" << file.errorString();
+    }
+}
+
+#undef TU
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "core/Module.hpp"
+
+#include <QString>
+#include <QThread>
+
+#include <string>
+
+//
+// Worker thread for writing a module to disk. The module is serialized to
+// memory on construction while the module's mutex is held, afterwards the
+// module can be freely edited while the snapshot is written to a temporary
+// file and renamed over the destination, so that an interrupted save never
+// leaves a truncated module behind.
+//
+class ModuleSaver : public QThread {
+    Q_OBJECT
+
+public:
+    //
+    // Takes a snapshot of the module. Must be constructed on the GUI thread
+    // as Module::beginSave is called.
+    //
+    ModuleSaver(Module &mod, QString const& path, bool backup, QObject *parent = nullptr);
+
+    //
+    // Destination path of the module file
+    //
+    QString const& path() const;
+
+    //
+    // Writes the snapshot on the calling thread. run() just calls this method.
+    //
+    void save();
+
+    //
+    // Returns true if the snapshot was successfully written, valid once
+    // the save has completed.
+    //
+    bool succeeded() const;
+
+protected:
+    virtual void run() override;
+
+private:
+
+    QString mPath;
+    bool mBackup;
+
+    std::string mSnapshot;
+    bool mSnapshotValid;
+
+    bool mSuccess;
+
+};
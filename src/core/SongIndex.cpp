@@ -0,0 +1,181 @@
+
+#include "core/SongIndex.hpp"
+
+#include "trackerboy/apu/DefaultApu.hpp"
+#include "trackerboy/engine/Engine.hpp"
+#include "trackerboy/Synth.hpp"
+
+#include <algorithm>
+
+#define TU SongIndexTU
+namespace TU {
+
+// nothing is synthesized, so use a low rate to keep the apu's buffers small
+constexpr int INDEX_SAMPLERATE = 8000;
+
+// frames stepped per lock of the module when building on a worker thread
+constexpr int BURST_FRAMES = 1024;
+
+// stop indexing songs that neither loop nor halt after this many minutes
+constexpr int MAX_MINUTES = 60;
+
+}
+
+SongIndex::SongIndex() :
+    mVisits(),
+    mFirstVisit(),
+    mLength(0),
+    mLoopVisit(-1)
+{
+}
+
+void SongIndex::build(trackerboy::Module const& mod, trackerboy::Song const& song) {
+    build(mod, song, nullptr, nullptr);
+}
+
+bool SongIndex::build(
+    trackerboy::Module const& mod,
+    trackerboy::Song const& song,
+    QMutex &mutex,
+    std::function<bool()> const& abort
+) {
+    return build(mod, song, &mutex, abort);
+}
+
+bool SongIndex::build(
+    trackerboy::Module const& mod,
+    trackerboy::Song const& song,
+    QMutex *mutex,
+    std::function<bool()> const& abort
+) {
+    mVisits.clear();
+    mFirstVisit.clear();
+    mLength = 0;
+    mLoopVisit = -1;
+
+    // the synth sets up the apu but is never run, the apu only latches the
+    // engine's register writes
+    trackerboy::DefaultApu apu;
+    trackerboy::Synth synth(apu, TU::INDEX_SAMPLERATE, mod.framerate());
+    trackerboy::Engine engine(apu, &mod);
+    engine.setSong(&song);
+    engine.play(0, 0);
+
+    auto const maxFrames = (int)(mod.framerate() * 60 * TU::MAX_MINUTES);
+
+    trackerboy::Frame frame;
+    int lastOrder = -1;
+    int lastRow = -1;
+    // steps a frame, true is returned when the length is known
+    auto step = [&](int frameNo) {
+        engine.step(frame);
+        if (frame.halted) {
+            mLength = frameNo;
+            return true;
+        }
+
+        if (frame.startedNewRow) {
+            int const order = frame.order;
+            int const row = frame.row;
+            // a new pattern starts when the order changes or the row goes
+            // backwards (pattern jumped to itself)
+            if (order != lastOrder || row <= lastRow) {
+                auto &first = mFirstVisit[order];
+                if (first != -1) {
+                    // back to a pattern we've already played, the song loops
+                    mLoopVisit = first;
+                    mLength = frameNo;
+                    return true;
+                }
+                first = (int)mVisits.size();
+                mVisits.push_back({ order, row, frameNo });
+            }
+            lastOrder = order;
+            lastRow = row;
+        }
+        return false;
+    };
+
+    bool done = false;
+    for (int frameNo = 0; !done && frameNo < maxFrames; ) {
+        if (mutex) {
+            mutex->lock();
+        }
+        if (abort && abort()) {
+            if (mutex) {
+                mutex->unlock();
+            }
+            return false;
+        }
+        if (frameNo == 0) {
+            // the order may be resized between bursts, so size this with the
+            // first lock held
+            mFirstVisit.assign(song.order().size(), -1);
+        }
+
+        auto const burstEnd = mutex ? std::min(frameNo + TU::BURST_FRAMES, maxFrames) : maxFrames;
+        for (; !done && frameNo < burstEnd; ++frameNo) {
+            done = step(frameNo);
+        }
+
+        if (mutex) {
+            mutex->unlock();
+        }
+    }
+
+    if (!done) {
+        mLength = maxFrames;
+    }
+    return true;
+}
+
+std::vector<SongIndex::Visit> const& SongIndex::visits() const {
+    return mVisits;
+}
+
+int SongIndex::frameOf(int order) const {
+    if (order < 0 || order >= (int)mFirstVisit.size()) {
+        return -1;
+    }
+    auto const visit = mFirstVisit[order];
+    return visit == -1 ? -1 : mVisits[visit].frame;
+}
+
+int SongIndex::length() const {
+    return mLength;
+}
+
+int SongIndex::loopVisit() const {
+    return mLoopVisit;
+}
+
+int SongIndex::loopLength() const {
+    if (mLoopVisit == -1) {
+        return 0;
+    }
+    return mLength - mVisits[mLoopVisit].frame;
+}
+
+bool SongIndex::section(int first, int last, int &startFrame, int &frames) const {
+    if (first < 0 || first >= (int)mFirstVisit.size() || mFirstVisit[first] == -1) {
+        return false;
+    }
+
+    // since each pattern is only visited once before the loop point, the
+    // section ends at the next visit outside the range, or at the loop point
+    // (where playback returns to an already played pattern)
+    auto const begin = mFirstVisit[first];
+    startFrame = mVisits[begin].frame;
+    auto endFrame = mLength;
+    for (auto i = (size_t)begin + 1; i < mVisits.size(); ++i) {
+        auto const order = mVisits[i].order;
+        if (order < first || order > last) {
+            endFrame = mVisits[i].frame;
+            break;
+        }
+    }
+    frames = endFrame - startFrame;
+    return true;
+}
+
+#undef TU
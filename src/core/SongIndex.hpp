@@ -0,0 +1,104 @@
+#pragma once
+
+#include "trackerboy/data/Module.hpp"
+#include "trackerboy/data/Song.hpp"
+
+#include <QMutex>
+
+#include <functional>
+#include <vector>
+
+//
+// Index of pattern positions in a song. The index is built by stepping an
+// engine through the song once, without synthesizing, and recording the
+// engine frame each pattern starts on along with where the song loops back to.
+//
+// The index is used for seeking: an engine is stepped up to the desired
+// pattern so that speed, volume and effect state match what they would be
+// when playing from the start.
+//
+class SongIndex {
+
+public:
+
+    //
+    // A pattern that was played, in order of playback.
+    //
+    struct Visit {
+        int order;  // index in the song order
+        int row;    // starting row, nonzero when entered by a Dxx effect
+        int frame;  // number of frames from the start of the song
+    };
+
+    SongIndex();
+
+    //
+    // Builds the index for the given song. The caller must ensure that the
+    // module is not modified during the build.
+    //
+    void build(trackerboy::Module const& mod, trackerboy::Song const& song);
+
+    //
+    // Builds the index on a worker thread while the module may be edited.
+    // The module is only locked with the given mutex for short bursts of
+    // frames. Before each burst, with the mutex held, abort is called and the
+    // build stops if it returns true. false is returned if the build was
+    // stopped, the index is then incomplete.
+    //
+    bool build(
+        trackerboy::Module const& mod,
+        trackerboy::Song const& song,
+        QMutex &mutex,
+        std::function<bool()> const& abort
+    );
+
+    std::vector<Visit> const& visits() const;
+
+    //
+    // Frame the given pattern is first played on, -1 if the pattern is never
+    // reached when playing from the start.
+    //
+    int frameOf(int order) const;
+
+    //
+    // Number of frames until the song loops or halts.
+    //
+    int length() const;
+
+    //
+    // Index in visits() of where the song loops back to, or -1 if the song
+    // halts.
+    //
+    int loopVisit() const;
+
+    //
+    // Number of frames in the looped portion of the song, 0 if the song
+    // halts.
+    //
+    int loopLength() const;
+
+    //
+    // Locates the section starting at the first play of order first and
+    // ending when playback leaves the range [first, last] or returns to a
+    // pattern already played in the section. false is returned if the first
+    // pattern is never reached.
+    //
+    bool section(int first, int last, int &startFrame, int &frames) const;
+
+private:
+
+    bool build(
+        trackerboy::Module const& mod,
+        trackerboy::Song const& song,
+        QMutex *mutex,
+        std::function<bool()> const& abort
+    );
+
+    std::vector<Visit> mVisits;
+    // index in mVisits for each order, -1 if not visited
+    std::vector<int> mFirstVisit;
+
+    int mLength;
+    int mLoopVisit;
+
+};
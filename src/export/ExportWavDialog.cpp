@@ -1,11 +1,14 @@
 
 #include "export/ExportWavDialog.hpp"
 
+#include "audio/Wav.hpp"
 #include "core/Module.hpp"
 #include "core/ModuleFile.hpp"
+#include "core/SongIndex.hpp"
 #include "export/WavExporter.hpp"
 
 #include <QCheckBox>
+#include <QComboBox>
 #include <QDialogButtonBox>
 #include <QFileDialog>
 #include <QFileInfo>
@@ -47,6 +50,15 @@ ExportWavDialog::ExportWavDialog(
     durationLayout->addWidget(mTimeRadio, 1, 0);
     durationLayout->addWidget(mTimeEdit, 1, 1);
     durationLayout->addWidget(new QLabel(tr("mm:ss")), 1, 2);
+    mSectionRadio = new QRadioButton(tr("Play patterns"));
+    mSectionFromSpin = new QSpinBox;
+    mSectionToSpin = new QSpinBox;
+    auto sectionLayout = new QHBoxLayout;
+    sectionLayout->addWidget(mSectionFromSpin, 1);
+    sectionLayout->addWidget(new QLabel(tr("to")));
+    sectionLayout->addWidget(mSectionToSpin, 1);
+    durationLayout->addWidget(mSectionRadio, 2, 0);
+    durationLayout->addLayout(sectionLayout, 2, 1);
     mDurationGroup->setLayout(durationLayout);
 
     mChannelsGroup = new QGroupBox(tr("Channels"));
@@ -115,6 +127,15 @@ ExportWavDialog::ExportWavDialog(
 
     mDestinationStack->addWidget(singleContainer);
     mDestinationStack->addWidget(separateContainer);
+
+    auto formatLayout = new QHBoxLayout;
+    mFormatCombo = new QComboBox;
+    mFormatCombo->addItem(tr("32-bit float"), (int)Wav::Format::float32);
+    mFormatCombo->addItem(tr("24-bit PCM"), (int)Wav::Format::pcm24);
+    mFormatCombo->addItem(tr("16-bit PCM"), (int)Wav::Format::pcm16);
+    formatLayout->addWidget(new QLabel(tr("Format")));
+    formatLayout->addWidget(mFormatCombo, 1);
+    destinationLayout->addLayout(formatLayout);
     mDestinationGroup->setLayout(destinationLayout);
 
     mProgress = new QProgressBar;
@@ -138,6 +159,14 @@ ExportWavDialog::ExportWavDialog(
 
     mLoopRadio->setChecked(true);
     mLoopSpin->setRange(1, 100);
+    {
+        auto const lastPattern = (int)mModule.song()->order().size() - 1;
+        for (auto spin : { mSectionFromSpin, mSectionToSpin }) {
+            spin->setRange(0, lastPattern);
+            spin->setDisplayIntegerBase(16);
+        }
+        mSectionToSpin->setValue(lastPattern);
+    }
     mTimeEdit->setInputMask(QStringLiteral("99:99"));
     mTimeEdit->setMaxLength(5);
     mProgress->setAlignment(Qt::AlignVCenter | Qt::AlignHCenter);
@@ -150,6 +179,16 @@ ExportWavDialog::ExportWavDialog(
             mLoopRadio->setChecked(true);
         });
     
+    connect(mSectionFromSpin, qOverload<int>(&QSpinBox::valueChanged), this,
+        [this](int value) {
+            mSectionToSpin->setMinimum(value);
+            mSectionRadio->setChecked(true);
+        });
+    connect(mSectionToSpin, qOverload<int>(&QSpinBox::valueChanged), this,
+        [this]() {
+            mSectionRadio->setChecked(true);
+        });
+
     connect(mTimeEdit, &QLineEdit::textEdited, this,
         [this](QString const& text) {
             mTimeRadio->setChecked(false);
@@ -260,10 +299,15 @@ void ExportWavDialog::accept() {
                 });
         }
 
-        if (mLoopRadio->isChecked()) {
-            mExporter->setDuration(mLoopSpin->value());
+        if (mSectionRadio->isChecked()) {
+            mExporter->setSection(mSectionFromSpin->value(), mSectionToSpin->value(), mModule.songIndex());
         } else {
-            mExporter->setDuration(std::chrono::seconds(mTimeEditDuration));
+            mExporter->setSection(0, 0, nullptr);
+            if (mLoopRadio->isChecked()) {
+                mExporter->setDuration(mLoopSpin->value());
+            } else {
+                mExporter->setDuration(std::chrono::seconds(mTimeEditDuration));
+            }
         }
 
         {
@@ -292,6 +336,8 @@ void ExportWavDialog::accept() {
             mExporter->setDestination(mSingleDestination->text());
         }
 
+        mExporter->setFormat((Wav::Format)mFormatCombo->currentData().toInt());
+
         mStatusLabel->setText(tr("Exporting..."));
         mProgress->setValue(0);
         setGroupsEnabled(false);
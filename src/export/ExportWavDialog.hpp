@@ -6,6 +6,7 @@ class ModuleFile;
 class WavExporter;
 
 class QCheckBox;
+class QComboBox;
 #include <QDialog>
 class QDialogButtonBox;
 class QGroupBox;
@@ -50,8 +51,11 @@ private:
 
     QRadioButton *mLoopRadio;
     QRadioButton *mTimeRadio;
+    QRadioButton *mSectionRadio;
     QSpinBox *mLoopSpin;
     QLineEdit *mTimeEdit;
+    QSpinBox *mSectionFromSpin;
+    QSpinBox *mSectionToSpin;
     std::array<QCheckBox*, 4> mChannelChecks;
 
     QCheckBox *mSeparateChannelsCheck;
@@ -59,6 +63,7 @@ private:
     QLineEdit *mSingleDestination;
     QLineEdit *mSeparateDestination;
     QLineEdit *mSeparatePrefix;
+    QComboBox *mFormatCombo;
 
     QProgressBar *mProgress;
     QLabel *mStatusLabel;
@@ -0,0 +1,168 @@
+
+#include "export/HeadlessRenderer.hpp"
+
+#include "core/ModuleFile.hpp"
+#include "export/WavExporter.hpp"
+
+#include <QFileInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <cstdio>
+
+#define TU HeadlessRendererTU
+namespace TU {
+
+static void report(QString const& msg) {
+    std::fputs(qPrintable(msg), stderr);
+    std::fputc('\n', stderr);
+}
+
+static QString errorString(trackerboy::FormatError error) {
+    switch (error) {
+        case trackerboy::FormatError::invalidSignature:
+            return HeadlessRenderer::tr("the file is not a trackerboy module");
+        case trackerboy::FormatError::invalidRevision:
+            return HeadlessRenderer::tr("the module is from a newer version of Trackerboy");
+        case trackerboy::FormatError::cannotUpgrade:
+            return HeadlessRenderer::tr("failed to upgrade the module");
+        case trackerboy::FormatError::duplicateId:
+        case trackerboy::FormatError::invalid:
+        case trackerboy::FormatError::unknownChannel:
+            return HeadlessRenderer::tr("the module is corrupted");
+        default:
+            return HeadlessRenderer::tr("the file could not be read");
+    }
+}
+
+}
+
+HeadlessRenderer::HeadlessRenderer(Options const& options, QObject *parent) :
+    QObject(parent),
+    mOptions(options),
+    mMaxActive(1),
+    mFailures(0),
+    mPending(),
+    mNextPending(0),
+    mActive()
+{
+    // a separate export already renders its channels in parallel
+    auto const threadsPerJob = mOptions.separate ? 4 : 1;
+    mMaxActive = std::max(1, QThread::idealThreadCount() / threadsPerJob);
+}
+
+HeadlessRenderer::~HeadlessRenderer() {
+    for (auto &active : mActive) {
+        active->exporter->cancel();
+        active->exporter->wait();
+    }
+}
+
+void HeadlessRenderer::addJob(QString const& input, QString const& output) {
+    mPending.push_back({ input, output });
+}
+
+int HeadlessRenderer::failures() const {
+    return mFailures;
+}
+
+void HeadlessRenderer::start() {
+    startJobs();
+}
+
+void HeadlessRenderer::startJobs() {
+    while ((int)mActive.size() < mMaxActive && mNextPending < mPending.size()) {
+        auto const& job = mPending[mNextPending++];
+        if (!startJob(job)) {
+            ++mFailures;
+        }
+    }
+
+    if (mActive.empty()) {
+        emit finished();
+    }
+}
+
+bool HeadlessRenderer::startJob(Job const& job) {
+    auto active = std::make_unique<ActiveJob>();
+    active->job = job;
+    active->mod = std::make_unique<Module>();
+
+    auto &mod = *active->mod;
+    // no event loop to keep responsive here, so load on this thread
+    ModuleLoader loader(job.input);
+    loader.load();
+    ModuleFile file;
+    if (!file.open(loader, mod)) {
+        TU::report(QStringLiteral("%1: %2").arg(job.input, TU::errorString(file.lastError())));
+        return false;
+    }
+
+    auto const songCount = (int)mod.data().songs().size();
+    if (mOptions.song < 0 || mOptions.song >= songCount) {
+        TU::report(tr("%1: song %2 does not exist (module has %3 song(s))")
+                   .arg(job.input).arg(mOptions.song).arg(songCount));
+        return false;
+    }
+    mod.setSong(mOptions.song);
+
+    auto const patternCount = (int)mod.song()->order().size();
+    if (mOptions.sectionFirst >= patternCount) {
+        TU::report(tr("%1: pattern %2 does not exist (song has %3 pattern(s))")
+                   .arg(job.input).arg(mOptions.sectionFirst).arg(patternCount));
+        return false;
+    }
+
+    // the exporter uses the module's current song
+    auto exporter = new WavExporter(mod, mOptions.samplerate, this);
+    exporter->setDuration(mOptions.loops);
+    exporter->setChannels(ChannelOutput::AllOn);
+    exporter->setSeparate(mOptions.separate);
+    exporter->setFormat(mOptions.format);
+    if (mOptions.sectionFirst != -1) {
+        exporter->setSection(
+            mOptions.sectionFirst,
+            std::min(mOptions.sectionLast, patternCount - 1),
+            mod.songIndex()
+        );
+    }
+    exporter->setDestination(job.output);
+    if (mOptions.separate) {
+        exporter->setSeparatePrefix(QFileInfo(job.input).completeBaseName());
+    }
+    active->exporter = exporter;
+
+    connect(exporter, &WavExporter::finished, this,
+        [this, exporter]() {
+            jobFinished(exporter);
+        });
+
+    mActive.push_back(std::move(active));
+    exporter->start();
+    return true;
+}
+
+void HeadlessRenderer::jobFinished(WavExporter *exporter) {
+    auto iter = std::find_if(mActive.begin(), mActive.end(),
+        [exporter](auto const& active) {
+            return active->exporter == exporter;
+        });
+    if (iter == mActive.end()) {
+        return;
+    }
+
+    auto const& job = (*iter)->job;
+    if (exporter->failed()) {
+        ++mFailures;
+        TU::report(tr("%1: failed to write %2").arg(job.input, job.output));
+    } else {
+        TU::report(tr("%1 -> %2").arg(job.input, job.output));
+    }
+
+    exporter->deleteLater();
+    mActive.erase(iter);
+
+    startJobs();
+}
+
+#undef TU
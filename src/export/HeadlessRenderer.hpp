@@ -0,0 +1,98 @@
+#pragma once
+
+#include "audio/Wav.hpp"
+#include "core/Module.hpp"
+
+#include <QObject>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+class WavExporter;
+
+//
+// Renders modules to wav files without any widgets, used by the --render
+// command line mode. Each module is loaded into its own Module and exported
+// by its own WavExporter, so multiple modules are rendered at once.
+//
+class HeadlessRenderer : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    struct Options {
+        // index of the song to render
+        int song = 0;
+        int samplerate = 44100;
+        // number of times to play the song
+        int loops = 1;
+        // export each channel to its own file
+        bool separate = false;
+        Wav::Format format = Wav::Format::float32;
+        // range of patterns to export, or -1 for the entire song
+        int sectionFirst = -1;
+        int sectionLast = -1;
+    };
+
+    explicit HeadlessRenderer(Options const& options, QObject *parent = nullptr);
+    ~HeadlessRenderer();
+
+    //
+    // Adds a module to render. For separate exports, output is the directory
+    // to put each channel's file in, otherwise it is the wav file to create.
+    //
+    void addJob(QString const& input, QString const& output);
+
+    //
+    // Number of jobs that could not be rendered.
+    //
+    int failures() const;
+
+    //
+    // Begins rendering. The finished signal is emitted when all jobs have
+    // completed.
+    //
+    void start();
+
+signals:
+
+    void finished();
+
+private:
+    Q_DISABLE_COPY(HeadlessRenderer)
+
+    struct Job {
+        QString input;
+        QString output;
+    };
+
+    struct ActiveJob {
+        Job job;
+        std::unique_ptr<Module> mod;
+        WavExporter *exporter;
+    };
+
+    //
+    // Starts pending jobs until the concurrency limit is reached.
+    //
+    void startJobs();
+
+    //
+    // Loads the job's module and starts its export. false is returned if the
+    // module could not be loaded.
+    //
+    bool startJob(Job const& job);
+
+    void jobFinished(WavExporter *exporter);
+
+    Options mOptions;
+    int mMaxActive;
+    int mFailures;
+
+    std::vector<Job> mPending;
+    size_t mNextPending;
+    std::vector<std::unique_ptr<ActiveJob>> mActive;
+
+};
@@ -1,11 +1,16 @@
 
 #include "export/WavExporter.hpp"
 
-#include "audio/Wav.hpp"
+#include "trackerboy/apu/DefaultApu.hpp"
+#include "trackerboy/engine/Engine.hpp"
+#include "trackerboy/Synth.hpp"
 
 #include <QDir>
 #include <QFileInfo>
+#include <QThreadPool>
 
+#include <algorithm>
+#include <array>
 #include <memory>
 
 
@@ -16,18 +21,20 @@ WavExporter::WavExporter(
     QObject *parent
 ) :
     QThread(parent),
+    mModule(mod),
+    mSong(mod.song()),
     mSamplerate(samplerate),
-    mApu(),
-    mSynth(mApu, samplerate, mod.data().framerate()),
-    mEngine(mApu, &mod.data()),
     mDuration(0),
     mChannels(ChannelOutput::AllOn),
     mSeparate(false),
+    mFormat(Wav::Format::float32),
+    mSectionFirst(0),
+    mSectionLast(0),
+    mIndex(),
     mDestination(),
     mFailed(false),
     mAbort(false)
 {
-    mEngine.setSong(mod.song());
 }
 
 void WavExporter::setDuration(trackerboy::Player::Duration duration) {
@@ -43,7 +50,6 @@ bool WavExporter::failed() const {
 }
 
 void WavExporter::cancel() {
-    QMutexLocker locker(&mMutex);
     mAbort = true;
 }
 
@@ -59,6 +65,16 @@ void WavExporter::setSeparatePrefix(QString const& prefix) {
     mSeparatePrefix = prefix;
 }
 
+void WavExporter::setFormat(Wav::Format format) {
+    mFormat = format;
+}
+
+void WavExporter::setSection(int first, int last, std::shared_ptr<SongIndex const> index) {
+    mSectionFirst = first;
+    mSectionLast = last;
+    mIndex = std::move(index);
+}
+
 #define TU WavExporterTU
 namespace TU {
 
@@ -67,6 +83,9 @@ struct Batch {
     ChannelOutput::Flags channels;
 };
 
+// how often, in milliseconds, progress is reported while the batches render
+constexpr int PROGRESS_INTERVAL = 50;
+
 }
 
 
@@ -102,68 +121,148 @@ void WavExporter::run() {
         batches[0].channels = mChannels;
     }
 
-    // temporary buffer for transferring samples from apu to the wav file
-    auto buffersize = mSynth.framesize() * 2;
-    auto buffer = std::make_unique<float[]>(buffersize);
+    mFailed = false;
+    mAbort = false;
 
+    // each batch is independent from the others, so render them all at once
+    std::array<std::atomic_int, 4> batchProgress{};
+    std::atomic_int progressMaxTotal(0);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(std::max(1, std::min(batchCount, QThread::idealThreadCount())));
     for (int i = 0; i < batchCount; ++i) {
+        pool.start([this, &batch = batches[i], &progress = batchProgress[i], &progressMaxTotal]() {
+            renderBatch(batch.filename, batch.channels, progress, progressMaxTotal);
+        });
+    }
+
+    // aggregate progress from all batches while we wait
+    int lastMax = -1;
+    int lastProgress = -1;
+    auto report = [&]() {
+        auto const max = progressMaxTotal.load();
+        if (max != lastMax) {
+            lastMax = max;
+            emit progressMax(max);
+        }
+        int total = 0;
+        for (int i = 0; i < batchCount; ++i) {
+            total += batchProgress[i].load();
+        }
+        if (total != lastProgress) {
+            lastProgress = total;
+            emit progress(total);
+        }
+    };
+
+    while (!pool.waitForDone(TU::PROGRESS_INTERVAL)) {
+        report();
+    }
+    report();
 
-        trackerboy::Player player(mEngine);
+}
+
+void WavExporter::renderBatch(
+    QString const& filename,
+    ChannelOutput::Flags channels,
+    std::atomic_int &progress,
+    std::atomic_int &progressMax
+) {
+    auto const& data = mModule.data();
+
+    trackerboy::DefaultApu apu;
+    trackerboy::Synth synth(apu, mSamplerate, data.framerate());
+    trackerboy::Engine engine(apu, &data);
+    engine.setSong(mSong);
+
+    trackerboy::Player player(engine);
+    if (mIndex) {
+        engine.play(0, 0);
+    } else {
         player.start(mDuration);
+    }
 
-        auto const channels = batches[i].channels;
-        for (int ch = 0; ch < 4; ++ch) {
-            if (channels.testFlag((ChannelOutput::Flag)(1 << ch))) {
-                mEngine.lock(static_cast<trackerboy::ChType>(ch));
-            } else {
-                mEngine.unlock(static_cast<trackerboy::ChType>(ch));
-            }
+    for (int ch = 0; ch < 4; ++ch) {
+        if (channels.testFlag((ChannelOutput::Flag)(1 << ch))) {
+            engine.lock(static_cast<trackerboy::ChType>(ch));
+        } else {
+            engine.unlock(static_cast<trackerboy::ChType>(ch));
         }
+    }
+
+    // file writes are done on a separate thread so that rendering does not
+    // wait on I/O
+    Wav wav(filename.toStdString(), 2, mSamplerate, mFormat, true);
+    if (!wav.good()) {
+        mFailed = true;
+        return;
+    }
 
+    // temporary buffer for transferring samples from apu to the wav file
+    auto buffer = std::make_unique<float[]>(synth.framesize() * 2);
 
-        Wav wav(batches[i].filename.toStdString(), 2, mSamplerate);
-        if (!wav.stream().good()) {
+    if (mIndex) {
+        int startFrame;
+        int frames;
+        if (!mIndex->section(mSectionFirst, mSectionLast, startFrame, frames)) {
             mFailed = true;
             return;
         }
+        progressMax += frames;
+
+        trackerboy::Frame frame;
+        // replay up to the section by stepping the engine only, like a seek
+        // in the Renderer. The registers it writes carry over to the first
+        // frame of the section, which is the first to be synthesized
+        for (int i = 0; i < startFrame && !mAbort; ++i) {
+            engine.step(frame);
+        }
 
-        emit progressMax(player.progressMax());
-        auto lastProgress = player.progress();
-        emit progress(lastProgress);
-
-        for (;;) {
-
-            mMutex.lock();
-            if (mAbort) {
-                mAbort = false;
-                mMutex.unlock();
-                break;
-            }
-            mMutex.unlock();
-
-            auto currentProgress = player.progress();
-            if (currentProgress != lastProgress) {
-                lastProgress = currentProgress;
-                emit progress(currentProgress);
-            }
-
-            player.step();
-            if (!player.isPlaying()) {
-                break;
-            }
-            mSynth.run();
+        for (int i = 0; i < frames && !mAbort; ++i) {
+            progress = i;
+            engine.step(frame);
+            synth.run();
 
-            auto samplesRead = mApu.readSamples(buffer.get(), mSynth.framesize());
+            auto samplesRead = apu.readSamples(buffer.get(), synth.framesize());
             wav.write(buffer.get(), samplesRead);
-            if (!wav.stream().good()) {
+            if (!wav.good()) {
                 mFailed = true;
                 return;
             }
+        }
+
+        progress = frames;
+        if (!wav.close()) {
+            mFailed = true;
+        }
+        return;
+    }
+
+    progressMax += player.progressMax();
+
+    while (!mAbort) {
+
+        progress = player.progress();
 
+        player.step();
+        if (!player.isPlaying()) {
+            break;
         }
+        synth.run();
 
-        mFailed = false;
+        auto samplesRead = apu.readSamples(buffer.get(), synth.framesize());
+        wav.write(buffer.get(), samplesRead);
+        if (!wav.good()) {
+            mFailed = true;
+            return;
+        }
+
+    }
 
+    progress = player.progress();
+    // the last buffer is written here, so this can fail too
+    if (!wav.close()) {
+        mFailed = true;
     }
 }
 
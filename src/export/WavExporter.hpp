@@ -1,18 +1,19 @@
-
 #pragma once
 
+#include "audio/Wav.hpp"
 #include "core/Module.hpp"
 #include "core/ChannelOutput.hpp"
+#include "core/SongIndex.hpp"
 
-#include "trackerboy/apu/DefaultApu.hpp"
 #include "trackerboy/export/Player.hpp"
-#include "trackerboy/Synth.hpp"
 
 #include <QThread>
-#include <QMutex>
+
+#include <atomic>
 
 //
-// Worker thread for exporting a module to a wav file
+// Worker thread for exporting a module to a wav file. When exporting channels
+// to separate files, each file is rendered in parallel on a thread pool.
 //
 class WavExporter : public QThread {
     Q_OBJECT
@@ -34,6 +35,16 @@ public:
 
     void setSeparatePrefix(QString const& prefix);
 
+    void setFormat(Wav::Format format);
+
+    //
+    // Exports patterns first through last instead of the entire song. The
+    // song is replayed silently up to the first pattern so that the section
+    // starts with the correct engine state. The duration setting is ignored
+    // for sections. Pass a null index to export the entire song.
+    //
+    void setSection(int first, int last, std::shared_ptr<SongIndex const> index);
+
     bool failed() const;
 
     void cancel();
@@ -46,22 +57,39 @@ protected:
     virtual void run() override;
 
 private:
-    QMutex mMutex;
+
+    //
+    // Renders the song with the given channels enabled to a wav file. Each
+    // call uses its own apu, synth and engine so this function can be called
+    // from multiple threads. The progress of the render is stored in the given
+    // atomics, progressMax is incremented once the render begins.
+    //
+    void renderBatch(
+        QString const& filename,
+        ChannelOutput::Flags channels,
+        std::atomic_int &progress,
+        std::atomic_int &progressMax
+    );
+
+    Module const& mModule;
+    trackerboy::Song const* mSong;
 
     int mSamplerate;
-    trackerboy::DefaultApu mApu;
-    trackerboy::Synth mSynth;
-    trackerboy::Engine mEngine;
 
     trackerboy::Player::Duration mDuration;
 
     ChannelOutput::Flags mChannels;
     bool mSeparate;
+    Wav::Format mFormat;
+
+    int mSectionFirst;
+    int mSectionLast;
+    std::shared_ptr<SongIndex const> mIndex;
 
     QString mDestination;
     QString mSeparatePrefix;
 
-    bool mFailed;
-    bool mAbort;
+    std::atomic_bool mFailed;
+    std::atomic_bool mAbort;
 
 };
@@ -3,6 +3,8 @@
 
 #include <QTimerEvent>
 
+#include <algorithm>
+
 #define TU AudioDiagDialogTU
 namespace TU {
 
@@ -24,7 +26,19 @@ AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
     mElapsedLabel(),
     mPeriodLabel(),
     mPeriodWrittenLabel(),
+    mRenderModeLabel(),
+    mLatencyLabel(),
     mClearButton(tr("Clear")),
+    mJitterGroup(tr("Period jitter")),
+    mJitterLayout(),
+    mJitterBars(),
+    mJitterMaxLabel(),
+    mThreadGroup(tr("Render thread")),
+    mThreadLayout(),
+    mPriorityLabel(),
+    mCpuLabel(),
+    mMemoryLabel(),
+    mThreadErrorLabel(),
     mButtonLayout(),
     mAutoRefreshCheck(tr("Auto refresh")),
     mIntervalSpin(),
@@ -37,9 +51,33 @@ AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
     mRenderLayout.addRow(tr("Elapsed"), &mElapsedLabel);
     mRenderLayout.addRow(tr("Refresh rate"), &mPeriodLabel);
     mRenderLayout.addRow(tr("Samples written"), &mPeriodWrittenLabel);
-    mRenderLayout.setWidget(6, QFormLayout::LabelRole, &mClearButton);
+    mRenderLayout.addRow(tr("Render mode"), &mRenderModeLabel);
+    mRenderLayout.addRow(tr("Latency"), &mLatencyLabel);
+    mRenderLayout.setWidget(8, QFormLayout::LabelRole, &mClearButton);
     mRenderGroup.setLayout(&mRenderLayout);
 
+    for (int i = 0; i < Renderer::JitterStats::BINS; ++i) {
+        QString label;
+        if (i == Renderer::JitterStats::BINS - 1) {
+            label = tr(">= %1 ms").arg(Renderer::JitterStats::BIN_LIMITS[i - 1] / 1000.0);
+        } else {
+            label = tr("< %1 ms").arg(Renderer::JitterStats::BIN_LIMITS[i] / 1000.0);
+        }
+        auto &bar = mJitterBars[i];
+        bar.setAlignment(Qt::AlignCenter);
+        bar.setFormat(QStringLiteral("%v"));
+        mJitterLayout.addRow(label, &bar);
+    }
+    mJitterLayout.addRow(tr("Max"), &mJitterMaxLabel);
+    mJitterGroup.setLayout(&mJitterLayout);
+
+    mThreadLayout.addRow(tr("Priority"), &mPriorityLabel);
+    mThreadLayout.addRow(tr("Core"), &mCpuLabel);
+    mThreadLayout.addRow(tr("Memory"), &mMemoryLabel);
+    mThreadLayout.addRow(&mThreadErrorLabel);
+    mThreadGroup.setLayout(&mThreadLayout);
+    mThreadErrorLabel.setWordWrap(true);
+
     mButtonLayout.addWidget(&mAutoRefreshCheck);
     mButtonLayout.addWidget(&mIntervalSpin);
     mButtonLayout.addWidget(&mRefreshButton);
@@ -47,6 +85,8 @@ AudioDiagDialog::AudioDiagDialog(Renderer &renderer, QWidget *parent) :
     mButtonLayout.addWidget(&mCloseButton);
 
     mLayout.addWidget(&mRenderGroup, 1);
+    mLayout.addWidget(&mJitterGroup);
+    mLayout.addWidget(&mThreadGroup);
     mLayout.addLayout(&mButtonLayout);
     mLayout.setSizeConstraint(QLayout::SizeConstraint::SetFixedSize);
     setLayout(&mLayout);
@@ -133,6 +173,74 @@ void AudioDiagDialog::refresh() {
     mBufferProgress.setValue(bufferStat.usage);
     mPeriodLabel.setText(tr("%1 ms").arg(bufferStat.lastPeriodMs, 0, 'f', 3));
     mPeriodWrittenLabel.setText(QString::number(bufferStat.writesSinceLastPeriod));
+
+    switch (mRenderer.renderMode()) {
+        case SoundConfig::RenderMode::pull:
+            mRenderModeLabel.setText(tr("Device callback"));
+            break;
+        case SoundConfig::RenderMode::clock:
+            mRenderModeLabel.setText(tr("Render thread"));
+            break;
+        default:
+            mRenderModeLabel.setText(tr("Timer"));
+            break;
+    }
+    mLatencyLabel.setText(tr("%1 ms").arg(bufferStat.latencyMs, 0, 'f', 1));
+
+    auto const jitter = mRenderer.statJitter();
+    unsigned total = 0;
+    for (auto count : jitter.counts) {
+        total += count;
+    }
+    for (int i = 0; i < Renderer::JitterStats::BINS; ++i) {
+        // bars are relative to the total number of periods
+        mJitterBars[i].setMaximum(std::max(1, (int)total));
+        mJitterBars[i].setValue((int)jitter.counts[i]);
+    }
+    mJitterMaxLabel.setText(tr("%1 ms").arg(jitter.maxMs, 0, 'f', 3));
+
+    refreshScheduling();
+}
+
+void AudioDiagDialog::refreshScheduling() {
+    auto const status = mRenderer.schedulingStatus();
+    if (!status.applied) {
+        auto const text = mRenderer.renderMode() == SoundConfig::RenderMode::pull
+            ? tr("Managed by device") : tr("Not started");
+        mPriorityLabel.setText(text);
+        mCpuLabel.setText(text);
+        mMemoryLabel.setText(text);
+        mThreadErrorLabel.clear();
+        mThreadErrorLabel.setVisible(false);
+        return;
+    }
+
+    switch (status.priority) {
+        case ThreadScheduling::Priority::realtime:
+            mPriorityLabel.setText(tr("Real-time (%1)").arg(status.level));
+            break;
+        case ThreadScheduling::Priority::raised:
+            mPriorityLabel.setText(tr("Raised"));
+            break;
+        default:
+            mPriorityLabel.setText(tr("Normal"));
+            break;
+    }
+
+    mCpuLabel.setText(status.cpu == -1 ? tr("Any") : QString::number(status.cpu));
+
+    if (status.processLocked) {
+        mMemoryLabel.setText(tr("Locked"));
+    } else if (status.stackLocked) {
+        mMemoryLabel.setText(tr("Stack locked"));
+    } else if (status.prefaulted) {
+        mMemoryLabel.setText(tr("Pre-faulted"));
+    } else {
+        mMemoryLabel.setText(tr("Not locked"));
+    }
+
+    mThreadErrorLabel.setText(status.errors);
+    mThreadErrorLabel.setVisible(!status.errors.isEmpty());
 }
 
 void AudioDiagDialog::setRunningLabel(bool const isRunning) {
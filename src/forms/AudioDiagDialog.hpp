@@ -43,6 +43,8 @@ private:
 
     void setElapsed(long const msecs);
 
+    void refreshScheduling();
+
     Renderer &mRenderer;
     int mTimerId;
     bool mLastIsRunning;
@@ -57,7 +59,19 @@ private:
                 QLabel mElapsedLabel;
                 QLabel mPeriodLabel;
                 QLabel mPeriodWrittenLabel;
+                QLabel mRenderModeLabel;
+                QLabel mLatencyLabel;
                 QPushButton mClearButton;
+        QGroupBox mJitterGroup;
+            QFormLayout mJitterLayout;
+                QProgressBar mJitterBars[Renderer::JitterStats::BINS];
+                QLabel mJitterMaxLabel;
+        QGroupBox mThreadGroup;
+            QFormLayout mThreadLayout;
+                QLabel mPriorityLabel;
+                QLabel mCpuLabel;
+                QLabel mMemoryLabel;
+                QLabel mThreadErrorLabel;
         QHBoxLayout mButtonLayout;
             QCheckBox mAutoRefreshCheck;
             QSpinBox mIntervalSpin;
@@ -0,0 +1,232 @@
+#include "forms/LibraryDialog.hpp"
+
+#include "core/LibraryScanner.hpp"
+#include "utils/connectutils.hpp"
+#include "utils/string.hpp"
+
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QSettings>
+#include <QStringBuilder>
+#include <QVBoxLayout>
+
+#include <memory>
+#include <utility>
+
+#define TU LibraryDialogTU
+namespace TU {
+
+static auto const KEY_LIBRARY = QStringLiteral("Library");
+static auto const KEY_DIRECTORIES = QStringLiteral("directories");
+
+enum Column {
+    ColumnTitle,
+    ColumnArtist,
+    ColumnSongs,
+    ColumnDuration,
+    ColumnFile,
+
+    ColumnCount
+};
+
+}
+
+
+LibraryDialog::LibraryDialog(QWidget *parent) :
+    PersistantDialog(parent, Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowCloseButtonHint),
+    mLibrary(),
+    mScanner(nullptr)
+{
+    setWindowTitle(tr("Module library"));
+
+    auto layout = new QVBoxLayout;
+
+    auto directoryLayout = new QHBoxLayout;
+    mDirectoryList = new QListWidget;
+    mDirectoryList->setMaximumHeight(mDirectoryList->fontMetrics().height() * 5);
+    auto directoryButtonLayout = new QVBoxLayout;
+    mAddButton = new QPushButton(tr("Add folder..."));
+    mRemoveButton = new QPushButton(tr("Remove folder"));
+    mRemoveButton->setEnabled(false);
+    directoryButtonLayout->addWidget(mAddButton);
+    directoryButtonLayout->addWidget(mRemoveButton);
+    directoryButtonLayout->addStretch();
+    directoryLayout->addWidget(mDirectoryList, 1);
+    directoryLayout->addLayout(directoryButtonLayout);
+
+    mSearchEdit = new QLineEdit;
+    mSearchEdit->setPlaceholderText(tr("Search title, artist, songs or filename"));
+    mSearchEdit->setClearButtonEnabled(true);
+
+    mResults = new QTreeWidget;
+    mResults->setColumnCount(TU::ColumnCount);
+    mResults->setHeaderLabels({ tr("Title"), tr("Artist"), tr("Songs"), tr("Duration"), tr("File") });
+    mResults->setRootIsDecorated(false);
+    mResults->setUniformRowHeights(true);
+    mResults->setSortingEnabled(true);
+    mResults->sortByColumn(TU::ColumnTitle, Qt::AscendingOrder);
+    mResults->header()->setStretchLastSection(true);
+
+    auto bottomLayout = new QHBoxLayout;
+    mProgress = new QProgressBar;
+    mProgress->setVisible(false);
+    mRescanButton = new QPushButton(tr("Rescan"));
+    auto closeButton = new QPushButton(tr("Close"));
+    bottomLayout->addWidget(mProgress, 1);
+    bottomLayout->addStretch();
+    bottomLayout->addWidget(mRescanButton);
+    bottomLayout->addWidget(closeButton);
+
+    layout->addWidget(new QLabel(tr("Folders")));
+    layout->addLayout(directoryLayout);
+    layout->addWidget(mSearchEdit);
+    layout->addWidget(mResults, 1);
+    layout->addLayout(bottomLayout);
+    setLayout(layout);
+
+    QSettings settings;
+    settings.beginGroup(TU::KEY_LIBRARY);
+    mDirectoryList->addItems(settings.value(TU::KEY_DIRECTORIES).toStringList());
+
+    lazyconnect(mAddButton, clicked, this, addDirectory);
+    lazyconnect(mRemoveButton, clicked, this, removeDirectory);
+    lazyconnect(mRescanButton, clicked, this, rescan);
+    lazyconnect(closeButton, clicked, this, accept);
+    lazyconnect(mSearchEdit, textChanged, this, updateResults);
+    connect(mDirectoryList, &QListWidget::currentRowChanged, this,
+        [this](int row) {
+            mRemoveButton->setEnabled(row != -1);
+        });
+    connect(mResults, &QTreeWidget::itemActivated, this,
+        [this](QTreeWidgetItem *item) {
+            emit openModule(item->data(TU::ColumnFile, Qt::UserRole).toString());
+        });
+
+    // show what we have from the last scan, then look for changes
+    mLibrary.load(ModuleLibrary::defaultCachePath());
+    updateResults();
+    rescan();
+}
+
+LibraryDialog::~LibraryDialog() {
+    if (mScanner) {
+        mScanner->cancel();
+        mScanner->wait();
+    }
+}
+
+void LibraryDialog::rescan() {
+    if (mScanner) {
+        return;
+    }
+
+    QStringList directories;
+    for (int i = 0; i < mDirectoryList->count(); ++i) {
+        directories.append(mDirectoryList->item(i)->text());
+    }
+
+    mScanner = new LibraryScanner(directories, mLibrary.entries(), this);
+    mProgress->setRange(0, 0);
+    mProgress->setValue(0);
+    mProgress->setVisible(true);
+    mRescanButton->setEnabled(false);
+
+    lazyconnect(mScanner, progressMax, mProgress, setMaximum);
+    lazyconnect(mScanner, progress, mProgress, setValue);
+    lazyconnect(mScanner, finished, this, onScanFinished);
+    mScanner->start();
+}
+
+void LibraryDialog::addDirectory() {
+    auto const dir = QFileDialog::getExistingDirectory(this, tr("Add folder to library"));
+    if (dir.isEmpty() || !mDirectoryList->findItems(dir, Qt::MatchExactly).isEmpty()) {
+        return;
+    }
+
+    mDirectoryList->addItem(dir);
+    saveDirectories();
+    rescan();
+}
+
+void LibraryDialog::removeDirectory() {
+    delete mDirectoryList->takeItem(mDirectoryList->currentRow());
+    saveDirectories();
+    rescan();
+}
+
+void LibraryDialog::saveDirectories() {
+    QStringList directories;
+    for (int i = 0; i < mDirectoryList->count(); ++i) {
+        directories.append(mDirectoryList->item(i)->text());
+    }
+
+    QSettings settings;
+    settings.beginGroup(TU::KEY_LIBRARY);
+    settings.setValue(TU::KEY_DIRECTORIES, directories);
+}
+
+void LibraryDialog::onScanFinished() {
+    std::unique_ptr<LibraryScanner> scanner(std::exchange(mScanner, nullptr));
+    // finished is emitted just before the thread exits
+    scanner->wait();
+
+    mProgress->setVisible(false);
+    mRescanButton->setEnabled(true);
+
+    if (!scanner->isCancelled()) {
+        auto const previousCount = mLibrary.entries().size();
+        mLibrary.setEntries(scanner->takeEntries());
+        // only rewrite the cache if modules were indexed or removed
+        if (scanner->indexedCount() || mLibrary.entries().size() != previousCount) {
+            mLibrary.save(ModuleLibrary::defaultCachePath());
+        }
+        updateResults();
+    }
+}
+
+void LibraryDialog::updateResults() {
+    mResults->setSortingEnabled(false);
+    mResults->clear();
+
+    auto const results = mLibrary.query(mSearchEdit->text());
+    QList<QTreeWidgetItem*> items;
+    items.reserve((qsizetype)results.size());
+    for (auto entry : results) {
+        auto item = new QTreeWidgetItem;
+        QFileInfo info(entry->path);
+        item->setText(TU::ColumnTitle, entry->title.isEmpty() ? info.completeBaseName() : entry->title);
+        item->setText(TU::ColumnArtist, entry->artist);
+        item->setData(TU::ColumnSongs, Qt::DisplayRole, (int)entry->songs.size());
+        item->setText(TU::ColumnFile, info.fileName());
+        item->setData(TU::ColumnFile, Qt::UserRole, entry->path);
+        item->setToolTip(TU::ColumnFile, entry->path);
+
+        // duration of the first song, list all songs in the tooltip
+        QString songsTip;
+        for (auto const& song : entry->songs) {
+            if (!songsTip.isEmpty()) {
+                songsTip += '\n';
+            }
+            songsTip += tr("%1 - %2 (%3 patterns%4)").arg(
+                song.name,
+                durationToString(entry->duration(song)),
+                QString::number(song.patterns),
+                song.loops ? tr(", loops") : QString()
+            );
+        }
+        if (!entry->songs.empty()) {
+            item->setText(TU::ColumnDuration, durationToString(entry->duration(entry->songs.front())));
+        }
+        item->setToolTip(TU::ColumnTitle, songsTip);
+        item->setToolTip(TU::ColumnSongs, songsTip);
+        item->setToolTip(TU::ColumnDuration, songsTip);
+        items.append(item);
+    }
+    mResults->addTopLevelItems(items);
+    mResults->setSortingEnabled(true);
+}
+
+#undef TU
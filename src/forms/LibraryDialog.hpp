@@ -0,0 +1,64 @@
+#pragma once
+
+#include "core/ModuleLibrary.hpp"
+#include "forms/PersistantDialog.hpp"
+
+#include <QLineEdit>
+#include <QListWidget>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QTreeWidget>
+
+class LibraryScanner;
+
+//
+// Browser for the module library. The user picks directories to index and
+// can search the modules found in them. The library is rescanned in the
+// background whenever the directories change.
+//
+class LibraryDialog : public PersistantDialog {
+
+    Q_OBJECT
+
+public:
+
+    explicit LibraryDialog(QWidget *parent = nullptr);
+    ~LibraryDialog();
+
+    //
+    // Scans the library directories for new or changed modules. Does nothing
+    // if a scan is already in progress.
+    //
+    void rescan();
+
+signals:
+    //
+    // Emitted when the user activates a module in the browser.
+    //
+    void openModule(QString const& path);
+
+private:
+    Q_DISABLE_COPY(LibraryDialog)
+
+    void addDirectory();
+
+    void removeDirectory();
+
+    void saveDirectories();
+
+    void onScanFinished();
+
+    void updateResults();
+
+    ModuleLibrary mLibrary;
+    LibraryScanner *mScanner;
+
+    QListWidget *mDirectoryList;
+    QPushButton *mAddButton;
+    QPushButton *mRemoveButton;
+    QLineEdit *mSearchEdit;
+    QTreeWidget *mResults;
+    QProgressBar *mProgress;
+    QPushButton *mRescanButton;
+
+};
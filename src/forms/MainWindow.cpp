@@ -19,6 +19,9 @@
 #include <QSplitter>
 #include <QTimerEvent>
 
+#include <memory>
+#include <utility>
+
 #define TU MainWindowTU
 
 namespace TU {
@@ -52,6 +55,8 @@ MainWindow::MainWindow() :
     mMidi(),
     mModule(),
     mModuleFile(),
+    mLoader(nullptr),
+    mSaver(nullptr),
     mErrorSinceLastConfig(false),
     mLastEngineFrame(),
     mFrameSkip(0),
@@ -63,7 +68,8 @@ MainWindow::MainWindow() :
     mInstrumentEditor(nullptr),
     mWaveEditor(nullptr),
     mHistoryDialog(nullptr),
-    mEffectsListDialog(nullptr)
+    mEffectsListDialog(nullptr),
+    mLibraryDialog(nullptr)
 {
 
     // create models
@@ -186,7 +192,13 @@ void MainWindow::panic(QString const& msg) {
 }
 
 void MainWindow::closeEvent(QCloseEvent *evt) {
+    finishAutosave();
     if (maybeSave()) {
+        if (mLoader) {
+            // abandon the module being opened
+            mLoader->cancel();
+            mLoader->wait();
+        }
         // user saved or discarded changes, close the window
         #ifdef QT_DEBUG
         if (mSaveConfig) {
@@ -216,9 +228,20 @@ void MainWindow::showEvent(QShowEvent *evt) {
 
 void MainWindow::timerEvent(QTimerEvent *evt) {
     if (evt->timerId() == mAutosaveTimer.timerId()) {
-        if (mModuleFile.hasFile()) {
+        // if the previous auto-save is still being written, try again on the
+        // next interval
+        if (mSaver == nullptr && mModuleFile.hasFile()) {
             qDebug() << "[MainWindow] Auto-saving...";
-            onFileSave();
+            // the module is written on a separate thread so that playback
+            // and editing are not interrupted
+            auto saver = mModuleFile.saveInBackground(*mModule, this);
+            mSaver = saver;
+            connect(saver, &ModuleSaver::finished, this,
+                [this, saver]() {
+                    if (mSaver == saver) {
+                        finishAutosave();
+                    }
+                });
             mAutosaveTimer.stop();
         }
     } else {
@@ -245,6 +268,17 @@ void MainWindow::dropEvent(QDropEvent* evt) {
 
 // PRIVATE METHODS -----------------------------------------------------------
 
+void MainWindow::finishAutosave() {
+    if (mSaver == nullptr) {
+        return;
+    }
+
+    std::unique_ptr<ModuleSaver> saver(std::exchange(mSaver, nullptr));
+    if (!mModuleFile.finishSave(*saver, *mModule)) {
+        statusBar()->showMessage(tr("Auto-save failed, could not write to %1").arg(saver->path()));
+    }
+}
+
 bool MainWindow::maybeSave() {
     if (mModule->isModified()) {
         // prompt the user if they want to save any changes
@@ -347,6 +381,7 @@ void MainWindow::setupUi() {
                 }
             }
             mPatternEditor->setInstrument(id);
+            updateMidiPreview();
         });
 
     connect(mWaveforms, &TableView::selectedItemChanged, this,
@@ -467,8 +502,8 @@ void MainWindow::setupUi() {
 
     lazyconnect(mSidebar->orderEditor()->grid(), patternJump, mRenderer, jumpToPattern);
 
-    lazyconnect(mPatternEditor, previewNote, mRenderer, instrumentPreview);
-    lazyconnect(mPatternEditor, stopNotePreview, mRenderer, stopPreview);
+    lazyconnect(mPatternEditor, previewNote, mRenderer, voicePreview);
+    lazyconnect(mPatternEditor, stopNotePreview, mRenderer, stopVoicePreview);
 
     lazyconnect(&mMidi, error, this, onMidiError);
 
@@ -491,8 +526,10 @@ void MainWindow::setupUi() {
     connect(mRenderer, &Renderer::frameSync, this, &MainWindow::onFrameSync);
     
     auto scope = mSidebar->scope();
-    scope->setBuffer(&mRenderer->visualizerBuffer());
-    connect(mRenderer, &Renderer::updateVisualizers, scope, qOverload<>(&AudioScope::update));
+    scope->setSource(&mRenderer->visualizerSnapshot());
+    mRenderer->setScopeWidth(scope->columns());
+    connect(scope, &AudioScope::columnsChanged, mRenderer, &Renderer::setScopeWidth);
+    connect(mRenderer, &Renderer::updateVisualizers, scope, &AudioScope::scheduleFrame);
 
     lazyconnect(mRenderer, isPlayingChanged, mPatternModel, setPlaying);
 
@@ -503,6 +540,12 @@ void MainWindow::setupUi() {
 
     lazyconnect(mPatternModel, patternCountChanged, this, onPatternCountChanged);
     lazyconnect(mPatternModel, cursorPatternChanged, this, onPatternCursorChanged);
+    connect(mPatternModel, &PatternModel::cursorChanged, this,
+        [this](PatternModel::CursorChangeFlags flags) {
+            if (flags.testFlag(PatternModel::CursorTrackChanged)) {
+                updateMidiPreview();
+            }
+        });
     connect(mPatternModel, &PatternModel::aboutToRemoveLastPattern, this,
         [this]() {
             mRenderer->jumpToPattern(0);
@@ -513,6 +556,7 @@ void MainWindow::setupUi() {
 
     onPatternCountChanged(mPatternModel->patterns());
     onPatternCursorChanged(mPatternModel->cursorPattern());
+    updateMidiPreview();
 }
 
 void MainWindow::initState() {
@@ -601,10 +645,23 @@ void MainWindow::handleFocusChange(QWidget *oldWidget, QWidget *newWidget) {
             widget = widget->parentWidget();
         }
         mMidi.setReceiver(receiver);
+        updateMidiPreview();
     }
 
 }
 
+void MainWindow::updateMidiPreview() {
+    // the renderer is always the sink so that controllers and the transport
+    // work regardless of focus
+    mMidi.setSink(mRenderer);
+    if (mMidi.receiver() == mPatternEditor) {
+        mRenderer->setMidiPreview(mPatternModel->cursorTrack(), mPatternEditor->instrument());
+    } else {
+        // the pianos preview through their own signals
+        mRenderer->setMidiPreview(-1, -1);
+    }
+}
+
 namespace TU {
 
 //
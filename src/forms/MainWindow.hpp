@@ -19,6 +19,7 @@
 #include "forms/TempoCalculator.hpp"
 #include "forms/CommentsDialog.hpp"
 #include "forms/EffectsListDialog.hpp"
+#include "forms/LibraryDialog.hpp"
 #include "midi/Midi.hpp"
 #include "widgets/PatternEditor.hpp"
 #include "widgets/Sidebar.hpp"
@@ -77,6 +78,7 @@ private:
     bool onFileSave();
     bool onFileSaveAs();
     void onFileRecent();
+    void onFileLoaded();
 
     void onModuleComments();
     void onModuleModuleProperties();
@@ -106,6 +108,7 @@ private:
     void showConfigDialog();
     void showUserManual();
     void showEffectsList();
+    void showLibrary();
     void showExportWavDialog();
     void showTempoCalculator();
     void showInstrumentEditor();
@@ -195,6 +198,13 @@ private:
     //
     bool maybeSave();
 
+    //
+    // Waits for the current auto-save, if any, to finish. Must be called
+    // before saving or replacing the module. If the auto-save failed, the
+    // module is marked as modified and the user is notified in the status bar.
+    //
+    void finishAutosave();
+
     //
     // Setups the UI, should only be called once and by the constructor
     //
@@ -235,6 +245,14 @@ private:
     //
     void handleFocusChange(QWidget *oldWidget, QWidget *newWidget);
 
+    //
+    // Notes for the pattern editor are previewed by the renderer directly
+    // from the MIDI thread. Updates the renderer's MIDI preview track and
+    // instrument for the current receiver, notes are not previewed by the
+    // renderer when a piano is the receiver.
+    //
+    void updateMidiPreview();
+
     //
     // Pushes the given filename to the recent files list. Each file that is
     // successfully opened and newly saved files should get added to this list
@@ -275,6 +293,10 @@ private:
 
     Module *mModule;
     ModuleFile mModuleFile;
+    // worker for the module being opened, nullptr when not opening a module
+    ModuleLoader *mLoader;
+    // worker for the auto-save in progress, nullptr when not saving
+    ModuleSaver *mSaver;
 
     InstrumentListModel *mInstrumentModel;
     SongListModel *mSongListModel;
@@ -300,6 +322,7 @@ private:
     WaveEditor *mWaveEditor;
     PersistantDialog *mHistoryDialog;
     EffectsListDialog *mEffectsListDialog;
+    LibraryDialog *mLibraryDialog;
 
     // toolbars
     QToolBar *mToolbarFile;
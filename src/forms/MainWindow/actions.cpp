@@ -57,6 +57,9 @@ void MainWindow::createActions(TableActions const& instrumentActions, TableActio
     act = setupAction(menuFile, tr("Export to WAV..."), tr("Exports the module to a WAV file"));
     connectActionToThis(act, showExportWavDialog);
 
+    act = setupAction(menuFile, tr("Module &library..."), tr("Browse and search modules in your folders"));
+    connectActionToThis(act, showLibrary);
+
     mRecentFilesSeparator = menuFile->addSeparator(); // ---------------------
     mRecentFilesSeparator->setVisible(false);
 
@@ -6,23 +6,33 @@
 #include "utils/string.hpp"
 #include "export/ExportWavDialog.hpp"
 #include "forms/ModulePropertiesDialog.hpp"
+#include "model/commands/memory.hpp"
 #include "widgets/TableView.hpp"
 
 #include <QApplication>
 #include <QElapsedTimer>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QStringBuilder>
 #include <QUndoView>
 #include <QShortcut>
 #include <QMenuBar>
+#include <QProgressDialog>
 #include <QDesktopServices>
 #include <QUrl>
 
+#include <array>
+#include <memory>
+#include <utility>
+
 #define TU MainWindowTU
 namespace TU {
 
 static const char* MODULE_FILE_FILTER = QT_TR_NOOP("Trackerboy module (*.tbm)");
 
+// milliseconds to wait before showing the progress dialog when opening a module
+static constexpr int OPEN_PROGRESS_DELAY = 300;
+
 }
 
 // action slots
@@ -32,6 +42,7 @@ void MainWindow::onFileNew() {
         return;
     }
 
+    finishAutosave();
     mRenderer->forceStop();
 
     mModule->clear();
@@ -63,14 +74,56 @@ void MainWindow::onFileOpen() {
 }
 
 void MainWindow::openFile(QString const& path) {
+    if (mLoader) {
+        // already opening a module
+        return;
+    }
+
+    finishAutosave();
     mRenderer->forceStop();
 
+    // the module is loaded on a separate thread, the current document remains
+    // until the load completes (see onFileLoaded)
+    mLoader = new ModuleLoader(path, this);
+
+    auto progress = new QProgressDialog(
+        tr("Opening %1...").arg(QFileInfo(path).fileName()),
+        tr("Cancel"),
+        0,
+        0,
+        this
+    );
+    progress->setWindowTitle(tr("Open module"));
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(TU::OPEN_PROGRESS_DELAY);
+    progress->setAutoReset(false);
+    progress->setAutoClose(false);
+
+    connect(mLoader, &ModuleLoader::progressMax, progress, &QProgressDialog::setMaximum);
+    connect(mLoader, &ModuleLoader::progress, progress, &QProgressDialog::setValue);
+    connect(progress, &QProgressDialog::canceled, mLoader, &ModuleLoader::cancel);
+    connect(mLoader, &ModuleLoader::finished, progress, &QProgressDialog::deleteLater);
+    connect(mLoader, &ModuleLoader::finished, this, &MainWindow::onFileLoaded);
+
     QApplication::setOverrideCursor(Qt::WaitCursor);
-    bool opened = mModuleFile.open(path, *mModule);
+    mLoader->start();
+}
+
+void MainWindow::onFileLoaded() {
     QApplication::restoreOverrideCursor();
 
+    std::unique_ptr<ModuleLoader> loader(std::exchange(mLoader, nullptr));
+    // finished is emitted just before the thread exits
+    loader->wait();
+    if (loader->isCancelled()) {
+        return;
+    }
+
+    mRenderer->forceStop();
+    bool opened = mModuleFile.open(*loader, *mModule);
+
     if (opened) {
-        pushRecentFile(path);
+        pushRecentFile(loader->path());
     } else {
         QMessageBox msgbox;
         msgbox.setIcon(QMessageBox::Critical);
@@ -108,6 +161,7 @@ void MainWindow::openFile(QString const& path) {
 }
 
 bool MainWindow::onFileSave() {
+    finishAutosave();
     if (mModuleFile.hasFile()) {
         return mModuleFile.save(*mModule);
     } else {
@@ -116,6 +170,7 @@ bool MainWindow::onFileSave() {
 }
 
 bool MainWindow::onFileSaveAs() {
+    finishAutosave();
 
     QString curPath;
     if (mModuleFile.hasFile()) {
@@ -357,6 +412,9 @@ Config::Categories MainWindow::applyConfig(Config const& config, Config::Categor
                 qCritical().noquote() << "[MIDI] Failed to initialize MIDI device:" << mMidi.lastError();
             }
         }
+        // keep the render running while listening so that notes are
+        // previewed without waiting on this thread
+        mRenderer->setMidiInputOpen(mMidi.isOpen());
     }
 
     return flags;
@@ -426,6 +484,19 @@ void MainWindow::showEffectsList() {
     mEffectsListDialog->show();
 }
 
+void MainWindow::showLibrary() {
+    if (mLibraryDialog == nullptr) {
+        mLibraryDialog = new LibraryDialog(this);
+        connect(mLibraryDialog, &LibraryDialog::openModule, this,
+            [this](QString const& path) {
+                if (maybeSave()) {
+                    openFile(path);
+                }
+            });
+    }
+    mLibraryDialog->show();
+}
+
 void MainWindow::showExportWavDialog() {
     ExportWavDialog dialog(*mModule, mModuleFile, mRenderer->samplerate(), this);
     dialog.exec();
@@ -483,8 +554,33 @@ void MainWindow::showHistory() {
     if (mHistoryDialog == nullptr) {
         mHistoryDialog = new PersistantDialog(this, Qt::WindowTitleHint | Qt::WindowSystemMenuHint | Qt::WindowCloseButtonHint);
         auto layout = new QVBoxLayout;
-        auto undoView = new QUndoView(mModule->undoGroup());
+        auto undoGroup = mModule->undoGroup();
+        auto undoView = new QUndoView(undoGroup);
         layout->addWidget(undoView);
+        // memory used by the current song's history
+        auto memoryLabel = new QLabel;
+        layout->addWidget(memoryLabel);
+        auto updateMemory = [undoGroup, memoryLabel]() {
+            auto stack = undoGroup->activeStack();
+            auto const bytes = stack ? stackMemoryUsage(stack) : 0;
+            memoryLabel->setText(tr("Memory usage: %1").arg(memoryLabel->locale().formattedDataSize((qint64)bytes)));
+        };
+        connect(undoGroup, &QUndoGroup::indexChanged, memoryLabel, updateMemory);
+        // merging into the top command (ie recording) grows the stack without
+        // changing the group's index, so listen to the active stack as well
+        auto stackConnections = std::make_shared<std::array<QMetaObject::Connection, 2>>();
+        auto watchStack = [memoryLabel, updateMemory, stackConnections](QUndoStack *stack) {
+            for (auto &connection : *stackConnections) {
+                QObject::disconnect(connection);
+            }
+            if (stack) {
+                (*stackConnections)[0] = connect(stack, &QUndoStack::indexChanged, memoryLabel, updateMemory);
+                (*stackConnections)[1] = connect(stack, &QUndoStack::cleanChanged, memoryLabel, updateMemory);
+            }
+            updateMemory();
+        };
+        connect(undoGroup, &QUndoGroup::activeStackChanged, memoryLabel, watchStack);
+        watchStack(undoGroup->activeStack());
         mHistoryDialog->setLayout(layout);
         mHistoryDialog->setWindowTitle(tr("History"));
     } 
@@ -36,6 +36,8 @@ static constexpr int PAINTABLE_CHARS_COUNT = sizeof(PAINTABLE_CHARS) - 1;
 CellPainter::CellPainter() :
     mCellHeight(0),
     mCellWidth(0),
+    mFont(),
+    mAtlas(),
     mCellScratch(1, '\0')
 {
 }
@@ -59,12 +61,21 @@ void CellPainter::setFont(QFont const& font) {
 
     // get the average character width
     mCellWidth = metrics.size(Qt::TextSingleLine, TU::PAINTABLE_CHARS).width() / TU::PAINTABLE_CHARS_COUNT;
+
+    mFont = font;
+    mAtlas.clear();
+}
+
+void CellPainter::buildAtlas(std::vector<QColor> const& colors, qreal devicePixelRatio) {
+    mAtlas.build(mFont, mCellWidth, mCellHeight, colors, devicePixelRatio);
 }
 
 
 int CellPainter::drawCell(QPainter &painter, char cell, int xpos, int ypos) const {
-    mCellScratch[0] = cell;
-    painter.drawText(xpos, ypos, mCellWidth, mCellHeight, Qt::AlignBottom, mCellScratch);
+    if (!mAtlas.draw(painter, cell, xpos, ypos)) {
+        mCellScratch[0] = cell;
+        painter.drawText(xpos, ypos, mCellWidth, mCellHeight, Qt::AlignBottom, mCellScratch);
+    }
     return xpos + mCellWidth;
 }
 
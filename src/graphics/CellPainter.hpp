@@ -1,10 +1,15 @@
 
 #pragma once
 
+#include "graphics/GlyphAtlas.hpp"
+
+#include <QColor>
 #include <QFont>
 #include <QPainter>
 #include <QString>
 
+#include <vector>
+
 //
 // Utility class for painting single characters in a grid of "cells". The size
 // of a cell is determined by the given font. 
@@ -18,8 +23,19 @@ public:
 
     int cellWidth() const;
 
+    //
+    // Sets the font and recalculates the cell size. The glyph atlas is
+    // cleared and must be rebuilt.
+    //
     void setFont(QFont const& font);
 
+    //
+    // Pre-renders the glyphs for each of the given pen colors. Cells drawn
+    // with one of these colors become pixmap blits, any other color is drawn
+    // as text.
+    //
+    void buildAtlas(std::vector<QColor> const& colors, qreal devicePixelRatio);
+
     //
     // Draws a cell at the given x and y coordinates. The x position of the
     // next cell is returned
@@ -41,6 +57,9 @@ private:
     int mCellHeight;
     int mCellWidth;
 
+    QFont mFont;
+    GlyphAtlas mAtlas;
+
     // 1-character string used by drawCell
     // this way we don't have to create a temporary QString every call
     // unnecessary if QString has small string optimization (don't think it does)
@@ -0,0 +1,121 @@
+
+#include "graphics/GlyphAtlas.hpp"
+
+#include <QString>
+
+#define TU GlyphAtlasTU
+namespace TU {
+
+// hexadecimal, 0-9, A-F
+// notes A to G, b, #, -, octaves 2-8
+// effects: BCDEFGHIJLPQRSTV012345
+// misc: ? . and space
+static const char ATLAS_CHARS[] = "0123456789ABCDEFGHIJLPQRSTVb#-.? ";
+static constexpr int ATLAS_CHARS_COUNT = sizeof(ATLAS_CHARS) - 1;
+
+}
+
+GlyphAtlas::GlyphAtlas() :
+    mPixmap(),
+    mDevicePixelRatio(1.0),
+    mCellWidth(0),
+    mCellHeight(0),
+    mColumns(),
+    mColors(),
+    mLastColor(0)
+{
+    mColumns.fill(-1);
+}
+
+void GlyphAtlas::build(
+    QFont const& font,
+    int cellWidth,
+    int cellHeight,
+    std::vector<QColor> const& colors,
+    qreal devicePixelRatio
+) {
+    clear();
+    if (cellWidth <= 0 || cellHeight <= 0 || colors.empty()) {
+        return;
+    }
+
+    mCellWidth = cellWidth;
+    mCellHeight = cellHeight;
+    mDevicePixelRatio = devicePixelRatio;
+    for (auto const& color : colors) {
+        mColors.push_back(color.rgba());
+    }
+
+    QSize const size(cellWidth * TU::ATLAS_CHARS_COUNT, cellHeight * (int)colors.size());
+    mPixmap = QPixmap(size * devicePixelRatio);
+    mPixmap.setDevicePixelRatio(devicePixelRatio);
+    mPixmap.fill(Qt::transparent);
+
+    QPainter painter(&mPixmap);
+    painter.setFont(font);
+    QString text(1, '\0');
+    int ypos = 0;
+    for (auto const& color : colors) {
+        painter.setPen(color);
+        int xpos = 0;
+        for (int i = 0; i < TU::ATLAS_CHARS_COUNT; ++i) {
+            text[0] = TU::ATLAS_CHARS[i];
+            // same rectangle and alignment that CellPainter uses for text
+            painter.drawText(xpos, ypos, cellWidth, cellHeight, Qt::AlignBottom, text);
+            xpos += cellWidth;
+        }
+        ypos += cellHeight;
+    }
+    painter.end();
+
+    for (int i = 0; i < TU::ATLAS_CHARS_COUNT; ++i) {
+        mColumns[(size_t)TU::ATLAS_CHARS[i]] = (signed char)i;
+    }
+}
+
+void GlyphAtlas::clear() {
+    mPixmap = QPixmap();
+    mColumns.fill(-1);
+    mColors.clear();
+    mLastColor = 0;
+}
+
+bool GlyphAtlas::isEmpty() const {
+    return mColors.empty();
+}
+
+bool GlyphAtlas::draw(QPainter &painter, char ch, int xpos, int ypos) const {
+    auto const index = (unsigned char)ch;
+    if (index >= mColumns.size() || mColumns[index] < 0) {
+        return false;
+    }
+
+    auto const row = colorIndex(painter.pen().color().rgba());
+    if (row < 0 || painter.device()->devicePixelRatio() != mDevicePixelRatio) {
+        return false;
+    }
+
+    auto const sourceWidth = mCellWidth * mDevicePixelRatio;
+    auto const sourceHeight = mCellHeight * mDevicePixelRatio;
+    painter.drawPixmap(
+        QRectF(xpos, ypos, mCellWidth, mCellHeight),
+        mPixmap,
+        QRectF(mColumns[index] * sourceWidth, row * sourceHeight, sourceWidth, sourceHeight)
+    );
+    return true;
+}
+
+int GlyphAtlas::colorIndex(QRgb color) const {
+    if (mLastColor < (int)mColors.size() && mColors[mLastColor] == color) {
+        return mLastColor;
+    }
+    for (int i = 0; i < (int)mColors.size(); ++i) {
+        if (mColors[i] == color) {
+            mLastColor = i;
+            return i;
+        }
+    }
+    return -1;
+}
+
+#undef TU
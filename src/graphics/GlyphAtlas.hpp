@@ -0,0 +1,71 @@
+
+#pragma once
+
+#include <QColor>
+#include <QFont>
+#include <QPainter>
+#include <QPixmap>
+#include <QRgb>
+
+#include <array>
+#include <vector>
+
+//
+// Pre-rendered set of the characters used by the tracker's grids. Each
+// character is rendered once for every color in the atlas, so drawing a cell
+// is just a pixmap blit instead of laying out text.
+//
+// The atlas must be rebuilt when the font, colors or device pixel ratio
+// change. Characters or colors that are not in the atlas cannot be drawn, in
+// which case the caller should fallback to drawing text.
+//
+class GlyphAtlas {
+
+public:
+
+    GlyphAtlas();
+
+    //
+    // Renders all glyphs for each of the given colors. Each glyph occupies
+    // a cellWidth x cellHeight cell, with text aligned to the bottom.
+    //
+    void build(
+        QFont const& font,
+        int cellWidth,
+        int cellHeight,
+        std::vector<QColor> const& colors,
+        qreal devicePixelRatio
+    );
+
+    //
+    // Removes all glyphs from the atlas
+    //
+    void clear();
+
+    bool isEmpty() const;
+
+    //
+    // Draws the glyph for the given character at the given position, using
+    // the painter's current pen color. Returns false if the atlas has no
+    // glyph for this character and color, or if the atlas was rendered for a
+    // different device pixel ratio than the painter's device.
+    //
+    bool draw(QPainter &painter, char ch, int xpos, int ypos) const;
+
+private:
+
+    int colorIndex(QRgb color) const;
+
+    QPixmap mPixmap;
+    qreal mDevicePixelRatio;
+    int mCellWidth;
+    int mCellHeight;
+
+    // atlas column for each character, -1 if not present
+    std::array<signed char, 128> mColumns;
+    // atlas row for each color
+    std::vector<QRgb> mColors;
+    // index of the last color drawn, consecutive cells tend to share colors
+    int mutable mLastColor;
+
+};
@@ -61,6 +61,26 @@ static char effectTypeToChar(trackerboy::EffectType et) {
     }
 }
 
+//
+// Packs everything about a row that affects its appearance
+//
+static RowCache::Content rowContent(PatternLayout const& l, trackerboy::Pattern const& pattern, int rowno) {
+    RowCache::Content content;
+    auto iter = content.begin();
+    for (int track = 0; track <= 3; ++track) {
+        auto const& trackdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), rowno);
+        *iter++ = trackdata.note;
+        *iter++ = trackdata.instrumentId;
+        for (auto const& effect : trackdata.effects) {
+            *iter++ = static_cast<uint8_t>(effect.type);
+            *iter++ = effect.param;
+        }
+        *iter++ = (uint8_t)l.effectsVisible(track);
+    }
+    *iter++ = l.rownoHex();
+    return content;
+}
+
 } // namespace TU
 
 // NOTE
@@ -82,7 +102,8 @@ PatternPainter::PatternPainter(QFont const& font) :
     mColorCursor(),
     mColorLine(),
     mRowColors(),
-    mPen()
+    mPen(),
+    mRowCache()
 {
     setFont(font);
 }
@@ -94,15 +115,18 @@ bool PatternPainter::flats() const {
 void PatternPainter::setFirstHighlight(int interval) {
     Q_ASSERT(interval >= 0);
     mHighlightInterval1 = interval;
+    mRowCache.clear();
 }
 
 void PatternPainter::setSecondHighlight(int interval) {
     Q_ASSERT(interval >= 0);
     mHighlightInterval2 = interval;
+    mRowCache.clear();
 }
 
 void PatternPainter::setFlats(bool flats) {
     mNoteTable = (flats) ? &NoteStrings::Flats : &NoteStrings::Sharps;
+    mRowCache.clear();
 }
 
 void PatternPainter::setColors(Palette const& colors) {
@@ -129,6 +153,20 @@ void PatternPainter::setColors(Palette const& colors) {
 
 }
 
+void PatternPainter::updateGlyphs(qreal devicePixelRatio) {
+    // cached rows were drawn with the old glyphs
+    mRowCache.clear();
+
+    // every pen color used for text by drawPattern
+    buildAtlas({
+        mForegroundColors[0],
+        mForegroundColors[1],
+        mForegroundColors[2],
+        mColorInstrument,
+        mColorEffect
+    }, devicePixelRatio);
+}
+
 void PatternPainter::drawRowBackground(QPainter &p, PatternLayout const& l, RowType type, int row) const {
     auto const _cellHeight = cellHeight();
     auto ypos = row * _cellHeight;
@@ -192,68 +230,118 @@ int PatternPainter::drawPattern(
     trackerboy::Pattern const& pattern,
     int rowStart,
     int rowEnd,
-    int ypos
+    int ypos,
+    int patternId
 ) const {
     auto const _cellHeight = cellHeight();
-    auto const start = l.patternStart();
 
     // text centering
     ypos++;
 
-    auto rownoDraw = l.rownoHex() ? &PatternPainter::drawHex : &PatternPainter::drawDec;
-
     for (int rowno = rowStart; rowno <= rowEnd; ++rowno) {
-        auto const& fgcolor = mForegroundColors[highlightIndex(rowno)];
-        p.setPen(mPen.get(fgcolor));
-        (*this.*rownoDraw)(p, rowno, PatternLayout::SPACING, ypos);
-        int xpos = start + PatternLayout::SPACING;
-        for (int track = 0; track <= 3; ++track) {
-            auto &trackdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), rowno);
-
-            auto note = trackdata.queryNote();
-            if (note) {
-                xpos = drawNote(p, *note, xpos, ypos);
-            } else {
-                xpos = drawNone(p, 3, xpos, ypos);
-            }
+        if (patternId < 0) {
+            drawRow(p, l, pattern, rowno, ypos);
+        } else {
+            drawCachedRow(p, l, pattern, patternId, rowno, ypos);
+        }
+        ypos += _cellHeight;
+    }
 
-            xpos += PatternLayout::SPACING;
-            auto instrument = trackdata.queryInstrument();
-            if (instrument) {
-                p.setPen(mPen.get(mColorInstrument));
-                xpos = drawHex(p, *instrument, xpos, ypos);
-                p.setPen(mPen.get(fgcolor));
-            } else {
-                xpos = drawNone(p, 2, xpos, ypos);
-            }
+    return ypos - 1;
+}
 
-            xpos += PatternLayout::SPACING;
+void PatternPainter::invalidateRows(int patternId, int rowStart, int rowEnd) {
+    mRowCache.invalidate(patternId, rowStart, rowEnd);
+}
+
+void PatternPainter::drawRow(
+    QPainter &p,
+    PatternLayout const& l,
+    trackerboy::Pattern const& pattern,
+    int rowno,
+    int ypos
+) const {
+    auto const start = l.patternStart();
+    auto rownoDraw = l.rownoHex() ? &PatternPainter::drawHex : &PatternPainter::drawDec;
 
-            auto const effectsVisible = l.effectsVisible(track);
-            for (int effect = 0; effect < effectsVisible; ++effect) {
-                auto effectdata = trackdata.effects[effect];
-                if (effectdata.type != trackerboy::EffectType::noEffect) {
-                    p.setPen(mPen.get(mColorEffect));
+    auto const& fgcolor = mForegroundColors[highlightIndex(rowno)];
+    p.setPen(mPen.get(fgcolor));
+    (*this.*rownoDraw)(p, rowno, PatternLayout::SPACING, ypos);
+    int xpos = start + PatternLayout::SPACING;
+    for (int track = 0; track <= 3; ++track) {
+        auto &trackdata = pattern.getTrackRow(static_cast<trackerboy::ChType>(track), rowno);
+
+        auto note = trackdata.queryNote();
+        if (note) {
+            xpos = drawNote(p, *note, xpos, ypos);
+        } else {
+            xpos = drawNone(p, 3, xpos, ypos);
+        }
 
-                    xpos = drawCell(p, TU::effectTypeToChar(effectdata.type), xpos, ypos);
+        xpos += PatternLayout::SPACING;
+        auto instrument = trackdata.queryInstrument();
+        if (instrument) {
+            p.setPen(mPen.get(mColorInstrument));
+            xpos = drawHex(p, *instrument, xpos, ypos);
+            p.setPen(mPen.get(fgcolor));
+        } else {
+            xpos = drawNone(p, 2, xpos, ypos);
+        }
+
+        xpos += PatternLayout::SPACING;
 
-                    p.setPen(mPen.get(fgcolor));
-                    xpos = drawHex(p, effectdata.param, xpos, ypos);
-                } else {
-                    xpos = drawNone(p, 3, xpos, ypos);
-                }
+        auto const effectsVisible = l.effectsVisible(track);
+        for (int effect = 0; effect < effectsVisible; ++effect) {
+            auto effectdata = trackdata.effects[effect];
+            if (effectdata.type != trackerboy::EffectType::noEffect) {
+                p.setPen(mPen.get(mColorEffect));
 
-                xpos += PatternLayout::SPACING;
+                xpos = drawCell(p, TU::effectTypeToChar(effectdata.type), xpos, ypos);
 
+                p.setPen(mPen.get(fgcolor));
+                xpos = drawHex(p, effectdata.param, xpos, ypos);
+            } else {
+                xpos = drawNone(p, 3, xpos, ypos);
             }
 
-            xpos += PatternLayout::LINE_WIDTH + PatternLayout::SPACING;
+            xpos += PatternLayout::SPACING;
+
         }
 
-        ypos += _cellHeight;
+        xpos += PatternLayout::LINE_WIDTH + PatternLayout::SPACING;
     }
 
-    return ypos - 1;
+}
+
+void PatternPainter::drawCachedRow(
+    QPainter &p,
+    PatternLayout const& l,
+    trackerboy::Pattern const& pattern,
+    int patternId,
+    int rowno,
+    int ypos
+) const {
+    auto const content = TU::rowContent(l, pattern, rowno);
+    auto const dpr = p.device()->devicePixelRatio();
+
+    // the pixmap starts 1 pixel above the text, for the centering offset
+    auto pixmap = mRowCache.find(patternId, rowno, content, dpr);
+    if (pixmap == nullptr) {
+        QPixmap rendered(QSize(l.patternStart() + l.rowWidth(), cellHeight() + 1) * dpr);
+        rendered.setDevicePixelRatio(dpr);
+        rendered.fill(Qt::transparent);
+        {
+            QPainter rowPainter(&rendered);
+            drawRow(rowPainter, l, pattern, rowno, 1);
+        }
+        pixmap = mRowCache.insert(patternId, rowno, content, rendered);
+        if (pixmap == nullptr) {
+            // too big for the cache
+            p.drawPixmap(0, ypos - 1, rendered);
+            return;
+        }
+    }
+    p.drawPixmap(0, ypos - 1, *pixmap);
 }
 
 void PatternPainter::drawSelection(QPainter &painter, QRect const& rect) const {
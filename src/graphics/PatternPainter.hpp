@@ -8,6 +8,7 @@
 #include "graphics/CachedPen.hpp"
 #include "graphics/CellPainter.hpp"
 #include "graphics/PatternLayout.hpp"
+#include "graphics/RowCache.hpp"
 
 #include "trackerboy/data/Pattern.hpp"
 
@@ -35,6 +36,12 @@ public:
 
     void setColors(Palette const& colors);
 
+    //
+    // Rebuilds the glyph atlas for the current font and text colors. Must be
+    // called after changing the font or colors.
+    //
+    void updateGlyphs(qreal devicePixelRatio);
+
     void setFirstHighlight(int interval);
 
     void setSecondHighlight(int interval);
@@ -60,16 +67,25 @@ public:
 
     //
     // Draws pattern data from the given pattern and range of rows starting
-    // at the given y position. The y position of the next row is returned
+    // at the given y position. The y position of the next row is returned.
+    // If patternId is not negative, rows are drawn from the row cache,
+    // patternId should then be the order index of the pattern.
     //
     int drawPattern(
         QPainter &p, PatternLayout const& l,
         trackerboy::Pattern const& pattern,
         int rowStart,
         int rowEnd,
-        int ypos
+        int ypos,
+        int patternId = -1
     ) const;
 
+    //
+    // Removes the given rows of a pattern from the row cache. Call this when
+    // the rows have been modified.
+    //
+    void invalidateRows(int patternId, int rowStart, int rowEnd);
+
     //
     // Draws the selection rectangle
     //
@@ -90,6 +106,24 @@ public:
 private:
 
     int highlightIndex(int rowno) const;
+
+    //
+    // Draws the text for a single row, ypos is the centered text position.
+    //
+    void drawRow(
+        QPainter &p, PatternLayout const& l,
+        trackerboy::Pattern const& pattern,
+        int rowno,
+        int ypos
+    ) const;
+
+    void drawCachedRow(
+        QPainter &p, PatternLayout const& l,
+        trackerboy::Pattern const& pattern,
+        int patternId,
+        int rowno,
+        int ypos
+    ) const;
     
     int mHighlightInterval1;
     int mHighlightInterval2;
@@ -110,5 +144,7 @@ private:
 
     CachedPen mutable mPen;
 
+    RowCache mutable mRowCache;
+
 
 };
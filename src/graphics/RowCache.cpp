@@ -0,0 +1,43 @@
+
+#include "graphics/RowCache.hpp"
+
+RowCache::RowCache(qsizetype budget) :
+    mCache(budget),
+    mDevicePixelRatio(1.0)
+{
+}
+
+QPixmap const* RowCache::find(int pattern, int row, Content const& content, qreal devicePixelRatio) {
+    if (devicePixelRatio != mDevicePixelRatio) {
+        // moved to a different screen, nothing in the cache is usable
+        mCache.clear();
+        mDevicePixelRatio = devicePixelRatio;
+        return nullptr;
+    }
+
+    auto entry = mCache.object({ pattern, row });
+    if (entry && entry->content == content) {
+        return &entry->pixmap;
+    }
+    return nullptr;
+}
+
+QPixmap const* RowCache::insert(int pattern, int row, Content const& content, QPixmap const& pixmap) {
+    auto const cost = (qsizetype)pixmap.width() * pixmap.height() * pixmap.depth() / 8;
+    auto entry = new Entry{ content, pixmap };
+    // QCache takes ownership, the entry is deleted immediately if too big
+    if (mCache.insert({ pattern, row }, entry, cost)) {
+        return &entry->pixmap;
+    }
+    return nullptr;
+}
+
+void RowCache::invalidate(int pattern, int rowStart, int rowEnd) {
+    for (auto row = rowStart; row <= rowEnd; ++row) {
+        mCache.remove({ pattern, row });
+    }
+}
+
+void RowCache::clear() {
+    mCache.clear();
+}
@@ -0,0 +1,78 @@
+
+#pragma once
+
+#include <QCache>
+#include <QPixmap>
+
+#include <array>
+#include <cstdint>
+
+//
+// LRU cache of rendered pattern rows. Rows are identified by their pattern
+// (order index) and row number, and each entry stores the packed row data it
+// was rendered from. A lookup only succeeds if the row's current content
+// matches, so stale entries are never drawn even if an invalidation was
+// missed.
+//
+// The cache is bounded by the total size of the pixmaps it holds.
+//
+class RowCache {
+
+public:
+
+    //
+    // Everything that determines how a row is drawn, besides the style of the
+    // painter: 8 bytes of track data per track, the effect columns visible
+    // per track and the row number format.
+    //
+    using Content = std::array<uint8_t, 4 * 8 + 5>;
+
+    // 32 MiB, enough for a few 256-row patterns on a 4K display
+    static constexpr qsizetype DEFAULT_BUDGET = 32 * 1024 * 1024;
+
+    explicit RowCache(qsizetype budget = DEFAULT_BUDGET);
+
+    //
+    // Gets the cached pixmap for the row if it exists and was rendered from
+    // the given content. If the device pixel ratio differs from the one the
+    // cache was populated with, the cache is cleared.
+    //
+    QPixmap const* find(int pattern, int row, Content const& content, qreal devicePixelRatio);
+
+    //
+    // Adds a rendered row, possibly evicting the least recently used rows.
+    // nullptr is returned if the pixmap exceeds the budget by itself.
+    //
+    QPixmap const* insert(int pattern, int row, Content const& content, QPixmap const& pixmap);
+
+    //
+    // Removes a range of rows for a pattern, call when they are modified.
+    //
+    void invalidate(int pattern, int rowStart, int rowEnd);
+
+    void clear();
+
+private:
+
+    struct Key {
+        int pattern;
+        int row;
+
+        bool operator==(Key const& other) const {
+            return pattern == other.pattern && row == other.row;
+        }
+
+        friend size_t qHash(Key const& key, size_t seed = 0) {
+            return ::qHash(((quint64)(unsigned)key.pattern << 32) | (unsigned)key.row, seed);
+        }
+    };
+
+    struct Entry {
+        Content content;
+        QPixmap pixmap;
+    };
+
+    QCache<Key, Entry> mCache;
+    qreal mDevicePixelRatio;
+
+};
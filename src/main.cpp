@@ -1,12 +1,19 @@
 
+#include "core/LibraryScanner.hpp"
+#include "core/ModuleLibrary.hpp"
+#include "export/HeadlessRenderer.hpp"
 #include "forms/MainWindow.hpp"
+#include "utils/string.hpp"
 
 #include <QApplication>
 #include <QCommandLineParser>
+#include <QCoreApplication>
 #include <QDateTime>
+#include <QDir>
 #include <QFontDatabase>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QElapsedTimer>
 #include <QMessageBox>
 #include <QPointer>
@@ -52,6 +59,9 @@ static std::string demangle(const char* name) {
 
 constexpr int EXIT_BAD_ARGUMENTS = -1;
 constexpr int EXIT_BAD_ALLOC = 1;
+constexpr int EXIT_RENDER_FAILED = 2;
+
+#define main_tr(str) QCoreApplication::translate("main", str)
 
 //
 // Singleton class for a custom Qt message handler. This message handler wraps
@@ -127,8 +137,241 @@ public:
 
 
 
+static void setupApplication() {
+    QCoreApplication::setOrganizationName("Trackerboy");
+    QCoreApplication::setApplicationName("Trackerboy");
+    QCoreApplication::setApplicationVersion(VERSION_STR);
+    // use INI on all systems, much easier to edit by hand
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+}
+
+//
+// Checks if the given option (ie --render) was given, this must be done before
+// constructing the application since headless modes do not use QApplication.
+//
+static bool hasArgument(int argc, char *argv[], char const *option) {
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], option) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+// Parses an integer option, false is returned if the value was not a number
+// or was less than min.
+//
+static bool parseIntOption(QCommandLineParser const& parser, QCommandLineOption const& option, int min, int &result) {
+    if (!parser.isSet(option)) {
+        return true;
+    }
+    bool ok;
+    auto const value = parser.value(option).toInt(&ok);
+    if (!ok || value < min) {
+        fprintf(stderr, "invalid value for --%s: %s\n", qPrintable(option.names().first()), qPrintable(parser.value(option)));
+        return false;
+    }
+    result = value;
+    return true;
+}
+
+//
+// Headless mode, renders the given modules to wav and exits without creating
+// any windows. Intended for batch exports and scripting.
+//
+static int renderMain(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    setupApplication();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(main_tr("Game Boy music tracker (headless render mode)"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("module_file", main_tr("Module file(s) to render"), "module_file...");
+
+    QCommandLineOption renderOption("render", main_tr("Render the given modules to wav files and exit"));
+    QCommandLineOption songOption("song", main_tr("Index of the song to render (default: 0)"), "index");
+    QCommandLineOption outOption(
+        QStringList{ "o", "out" },
+        main_tr("Output file. When rendering multiple modules or separate channels, this is the output directory (default: next to the module)"),
+        "path"
+    );
+    QCommandLineOption samplerateOption("samplerate", main_tr("Output samplerate in Hz (default: 44100)"), "rate");
+    QCommandLineOption loopsOption("loops", main_tr("Number of times to play the song (default: 1)"), "count");
+    QCommandLineOption separateOption("separate", main_tr("Export each channel to a separate file"));
+    QCommandLineOption patternsOption(
+        "patterns",
+        main_tr("Only render patterns first through last, instead of the whole song (ignores --loops)"),
+        "first-last"
+    );
+    QCommandLineOption formatOption("format", main_tr("Sample format: f32, s24 or s16 (default: f32)"), "format");
+    parser.addOptions({ renderOption, songOption, outOption, samplerateOption, loopsOption, separateOption, patternsOption, formatOption });
+
+    parser.process(app);
+
+    HeadlessRenderer::Options options;
+    if (!parseIntOption(parser, songOption, 0, options.song) ||
+        !parseIntOption(parser, samplerateOption, 1, options.samplerate) ||
+        !parseIntOption(parser, loopsOption, 1, options.loops)) {
+        return EXIT_BAD_ARGUMENTS;
+    }
+    options.separate = parser.isSet(separateOption);
+    if (parser.isSet(patternsOption)) {
+        auto const range = parser.value(patternsOption).split('-');
+        bool ok = range.size() == 2;
+        if (ok) {
+            bool lastOk;
+            options.sectionFirst = range[0].toInt(&ok);
+            options.sectionLast = range[1].toInt(&lastOk);
+            ok = ok && lastOk && options.sectionFirst >= 0 && options.sectionLast >= options.sectionFirst;
+        }
+        if (!ok) {
+            fprintf(stderr, "invalid value for --patterns: %s\n", qPrintable(parser.value(patternsOption)));
+            return EXIT_BAD_ARGUMENTS;
+        }
+    }
+    if (parser.isSet(formatOption)) {
+        auto const format = parser.value(formatOption);
+        if (format == QLatin1String("f32")) {
+            options.format = Wav::Format::float32;
+        } else if (format == QLatin1String("s24")) {
+            options.format = Wav::Format::pcm24;
+        } else if (format == QLatin1String("s16")) {
+            options.format = Wav::Format::pcm16;
+        } else {
+            fprintf(stderr, "invalid value for --format: %s\n", qPrintable(format));
+            return EXIT_BAD_ARGUMENTS;
+        }
+    }
+
+    auto const inputs = parser.positionalArguments();
+    if (inputs.isEmpty()) {
+        fputs("no module files given\n", stderr);
+        fputs(qPrintable(parser.helpText()), stderr);
+        return EXIT_BAD_ARGUMENTS;
+    }
+
+    auto const out = parser.value(outOption);
+    // the output path is a directory when it could be used by multiple
+    // inputs or when it is where the channel files go
+    auto const outIsDir = !out.isEmpty() && (inputs.size() > 1 || options.separate);
+    if (outIsDir && !QDir().mkpath(out)) {
+        fprintf(stderr, "could not create output directory: %s\n", qPrintable(out));
+        return EXIT_BAD_ARGUMENTS;
+    }
+
+    HeadlessRenderer renderer(options);
+    // output file (or channel file prefix for separate exports) -> input, so
+    // that two inputs with the same base name do not overwrite each other
+    QHash<QString, QString> outputs;
+    for (auto const& input : inputs) {
+        QFileInfo info(input);
+        QString output;
+        if (options.separate) {
+            output = outIsDir ? out : info.absolutePath();
+        } else if (out.isEmpty()) {
+            output = info.dir().filePath(info.completeBaseName() + QStringLiteral(".wav"));
+        } else if (outIsDir) {
+            output = QDir(out).filePath(info.completeBaseName() + QStringLiteral(".wav"));
+        } else {
+            output = out;
+        }
+
+        auto const key = options.separate
+            ? QFileInfo(QDir(output), info.completeBaseName()).absoluteFilePath()
+            : QFileInfo(output).absoluteFilePath();
+        auto const other = outputs.constFind(key);
+        if (other != outputs.cend()) {
+            fprintf(stderr, "%s and %s would both be rendered to %s\n",
+                    qPrintable(*other), qPrintable(input), qPrintable(output));
+            return EXIT_BAD_ARGUMENTS;
+        }
+        outputs.insert(key, input);
+
+        renderer.addJob(input, output);
+    }
+
+    QObject::connect(&renderer, &HeadlessRenderer::finished, &app,
+        [&app, &renderer]() {
+            app.exit(renderer.failures() ? EXIT_RENDER_FAILED : 0);
+        });
+    // start from the event loop so that exit() works if every job fails
+    QMetaObject::invokeMethod(&renderer, &HeadlessRenderer::start, Qt::QueuedConnection);
+
+    return app.exec();
+}
+
+//
+// Headless library mode, updates the library cache with the given directories
+// and prints the modules matching the query, one per line with tab separated
+// fields: path, title, artist, song count, duration of the first song,
+// instrument count and waveform count.
+//
+static int libraryMain(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    setupApplication();
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(main_tr("Game Boy music tracker (headless library mode)"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument("directory", main_tr("Directories to scan for modules, if none are given only the cache is searched"), "[directory...]");
+
+    QCommandLineOption libraryOption("library", main_tr("Scan and search the module library and exit"));
+    QCommandLineOption queryOption(
+        QStringList{ "q", "query" },
+        main_tr("Only list modules whose title, artist, copyright, song names or filename contain text"),
+        "text"
+    );
+    QCommandLineOption cacheOption("cache", main_tr("Library cache file to use (default: the cache shared with the library browser)"), "path");
+    parser.addOptions({ libraryOption, queryOption, cacheOption });
+
+    parser.process(app);
+
+    auto const cachePath = parser.isSet(cacheOption) ? parser.value(cacheOption) : ModuleLibrary::defaultCachePath();
+    ModuleLibrary library;
+    library.load(cachePath);
+
+    auto const directories = parser.positionalArguments();
+    if (!directories.isEmpty()) {
+        LibraryScanner scanner(directories, library.entries());
+        // the cache may have entries for other directories (ie the library
+        // browser's), which must survive the scan
+        scanner.setPartial(true);
+        scanner.start();
+        scanner.wait();
+        library.setEntries(scanner.takeEntries());
+        if (!library.save(cachePath)) {
+            fprintf(stderr, "could not write library cache: %s\n", qPrintable(cachePath));
+        }
+        fprintf(stderr, "%d module(s) in library, %d indexed\n", (int)library.entries().size(), scanner.indexedCount());
+    }
+
+    QTextStream out(stdout);
+    for (auto entry : library.query(parser.value(queryOption))) {
+        auto const duration = entry->songs.empty() ? 0.0 : entry->duration(entry->songs.front());
+        out << entry->path << '\t'
+            << entry->title << '\t'
+            << entry->artist << '\t'
+            << (int)entry->songs.size() << '\t'
+            << durationToString(duration) << '\t'
+            << entry->instrumentCount << '\t'
+            << entry->waveCount << '\n';
+    }
+
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
 
+    if (hasArgument(argc, argv, "--render")) {
+        return renderMain(argc, argv);
+    }
+    if (hasArgument(argc, argv, "--library")) {
+        return libraryMain(argc, argv);
+    }
+
     int code;
 
     #ifndef QT_NO_INFO_OUTPUT
@@ -137,19 +380,17 @@ int main(int argc, char *argv[]) {
     #endif
 
     Application app(argc, argv);
-    QCoreApplication::setOrganizationName("Trackerboy");
-    QCoreApplication::setApplicationName("Trackerboy");
-    QCoreApplication::setApplicationVersion(VERSION_STR);
-    // use INI on all systems, much easier to edit by hand
-    QSettings::setDefaultFormat(QSettings::IniFormat);
-
-#define main_tr(str) QCoreApplication::translate("main", str)
+    setupApplication();
 
     QCommandLineParser parser;
     parser.setApplicationDescription(main_tr("Game Boy music tracker"));
     parser.addHelpOption();
     parser.addVersionOption();
     parser.addPositionalArgument("[module_file]", main_tr("(Optional) the module file to open"));
+    // only listed for the help text, headless modes are handled by renderMain
+    // and libraryMain
+    parser.addOption({ "render", main_tr("Render modules to wav without opening a window (see --render --help)") });
+    parser.addOption({ "library", main_tr("Scan and search the module library without opening a window (see --library --help)") });
 
     parser.process(app);
 
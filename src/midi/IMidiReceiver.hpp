@@ -2,16 +2,19 @@
 #pragma once
 
 //
-// Interface for receiving MIDI input messages
+// Interface for receiving MIDI input messages in the GUI thread. previewed is
+// true when the Midi class's sink accepted the message and has started (or
+// stopped) the note's preview, otherwise the receiver handles the preview.
+// Receivers the sink does not preview for may ignore it.
 //
 class IMidiReceiver {
 
 
 public:
 
-    virtual void midiNoteOn(int note) = 0;
+    virtual void midiNoteOn(int note, bool previewed) = 0;
 
-    virtual void midiNoteOff() = 0;
+    virtual void midiNoteOff(bool previewed) = 0;
 
 protected:
     IMidiReceiver() = default;
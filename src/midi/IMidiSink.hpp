@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+//
+// Interface for receiving MIDI messages directly from the MIDI input thread,
+// bypassing the Qt event queue. Implementations must not block or allocate in
+// midiMessage.
+//
+class IMidiSink {
+
+public:
+
+    struct Message {
+
+        enum class Type : uint8_t {
+            noteOff,
+            noteOn,
+            controller,     // controller, value (0-127)
+            pitchBend,      // value (-8192 to 8191)
+            clock,          // timing clock, 24 per quarter note
+            start,
+            resume,         // MIDI continue
+            stop,
+            songPosition    // value, in MIDI beats (16th notes)
+        };
+
+        Type type = Type::noteOff;
+        // trackerboy note, a noteOff message only stops this note
+        uint8_t note = 0;
+        // controller number, for controller messages
+        uint8_t controller = 0;
+        int value = 0;
+        // time the message was received, in seconds. The epoch is arbitrary,
+        // only the difference between two messages is meaningful.
+        double time = 0.0;
+    };
+
+    //
+    // Called from the MIDI input thread for every supported message. false
+    // is returned if the message could not be accepted, in which case it is
+    // dropped.
+    //
+    virtual bool midiMessage(Message const& msg) = 0;
+
+protected:
+    IMidiSink() = default;
+    virtual ~IMidiSink() = default;
+
+};
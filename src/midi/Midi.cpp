@@ -25,51 +25,11 @@ static void logError(const char* str, RtMidiError const& err) {
 }
 
 //
-// Custom event for a MIDI input message
+// Custom event type for notifying the GUI thread that note messages are
+// queued. Since this event is only used internally by the Midi class, just
+// use the first User event id.
 //
-class MidiEvent : public QEvent {
-
-public:
-
-    enum Message {
-        NoteOn,
-        NoteOff
-    };
-
-    explicit MidiEvent(Message msg, int note = -1) :
-        QEvent(getType()),
-        mMessage(msg),
-        mNote(note)
-    {
-
-    }
-
-    //
-    // Get the type of the message that was received
-    //
-    Message message() const {
-        return mMessage;
-    }
-
-    //
-    // Get the note pressed if the message type was NoteOn
-    //
-    int note() const {
-        return mNote;
-    }
-
-    static constexpr Type getType() {
-        // since this event is only used internally by the Midi class, just
-        // use the first User event id. 
-        return QEvent::User;
-    }
-
-private:
-    Message const mMessage;
-    int const mNote;
-
-
-};
+constexpr auto NOTIFY_EVENT = QEvent::User;
 
 }
 
@@ -78,9 +38,13 @@ Midi::Midi(QObject *parent) :
     QObject(parent),
     mReceiver(nullptr),
     mNoteDown(false),
+    mSink(nullptr),
+    mNoteQueue(),
+    mNotifyPending(false),
     mMidiIn(),
     mMutex(),
-    mLastNotePitch(-1)
+    mLastNotePitch(-1),
+    mTime(0.0)
 {
 }
 
@@ -145,8 +109,12 @@ bool Midi::open(MidiEnumerator::Device const& device) {
 
 
         mLastNotePitch = -1;
+        mTime = 0.0;
         // setup callbacks and open the port
         mMidiIn->setCallback(midiInCallback, this);
+        // timing messages are needed for syncing to an external clock,
+        // sysex and active sensing are still ignored
+        mMidiIn->ignoreTypes(true, false, true);
         mMidiIn->openPort(port);
         // set the callback after opening, this way if we fail to open the error will be handled here
         mMidiIn->setErrorCallback(midiErrorCallback, this);
@@ -167,7 +135,7 @@ void Midi::setReceiver(IMidiReceiver *receiver) {
             // force the note off
             // if we don't do this, the previous receiver won't get the next noteOff message
             // and the note will be held indefinitely
-            mReceiver->midiNoteOff();
+            mReceiver->midiNoteOff(false);
             mNoteDown = false;
         }
         mReceiver = receiver;
@@ -175,26 +143,33 @@ void Midi::setReceiver(IMidiReceiver *receiver) {
     }
 }
 
+IMidiReceiver* Midi::receiver() const {
+    return mReceiver;
+}
+
+void Midi::setSink(IMidiSink *sink) {
+    mSink.store(sink, std::memory_order_release);
+}
+
 void Midi::customEvent(QEvent *evt) {
-    if (evt->type() == TU::MidiEvent::getType()) {
-        auto midiEvt = static_cast<TU::MidiEvent*>(evt);
-        switch (midiEvt->message()) {
-            case TU::MidiEvent::NoteOff:
-                if (mReceiver) {
-                    mReceiver->midiNoteOff();
-                    mNoteDown = false;
-                }
-                break;
-            case TU::MidiEvent::NoteOn:
-                if (mReceiver) {
-                    mReceiver->midiNoteOn(midiEvt->note());
-                    mNoteDown = true;
-                }
-                break;
-            default:
-                break;
+    if (evt->type() == TU::NOTIFY_EVENT) {
+        // clear the flag before draining, any message queued after this
+        // point will post a new event
+        mNotifyPending.store(false, std::memory_order_release);
+
+        NoteMessage msg;
+        while (mNoteQueue.pop(msg)) {
+            if (mReceiver == nullptr) {
+                continue;
+            }
+            if (msg.note == -1) {
+                mReceiver->midiNoteOff(msg.previewed);
+                mNoteDown = false;
+            } else {
+                mReceiver->midiNoteOn(msg.note, msg.previewed);
+                mNoteDown = true;
+            }
         }
-
     }
 }
 
@@ -234,40 +209,104 @@ void Midi::midiInCallback(double deltatime, std::vector<unsigned char> *message,
 }
 
 void Midi::handleMidiIn(double deltatime, std::vector<unsigned char> &message) {
-    Q_UNUSED(deltatime)
+    mTime += deltatime;
 
     auto const msgSize = message.size();
     if (msgSize == 0) {
         return; // shouldn't happen but just in case do nothing
     }
     
-    auto const status = message[0];
-    switch (status & 0xF0) {
-        case MidiNoteOff:
-            // message should be three bytes
+    // controller, pitch bend and transport messages only go to the sink
+    IMidiSink::Message sinkMsg;
+    switch (message[0]) {
+        case MidiClock:
+            sinkMsg.type = IMidiSink::Message::Type::clock;
+            sendToSink(sinkMsg);
+            return;
+        case MidiStart:
+            sinkMsg.type = IMidiSink::Message::Type::start;
+            sendToSink(sinkMsg);
+            return;
+        case MidiContinue:
+            sinkMsg.type = IMidiSink::Message::Type::resume;
+            sendToSink(sinkMsg);
+            return;
+        case MidiStop:
+            sinkMsg.type = IMidiSink::Message::Type::stop;
+            sendToSink(sinkMsg);
+            return;
+        case MidiSongPosition:
             if (msgSize == 3) {
-                if (mLastNotePitch == (int)message[1]) {
-                    mLastNotePitch = -1;
-                    QCoreApplication::postEvent(this, new TU::MidiEvent(TU::MidiEvent::NoteOff), Qt::HighEventPriority);
-                }
+                sinkMsg.type = IMidiSink::Message::Type::songPosition;
+                sinkMsg.value = message[1] | (message[2] << 7);
+                sendToSink(sinkMsg);
             }
+            return;
+        default:
             break;
+    }
+
+    auto const status = message[0] & 0xF0;
+    if (msgSize != 3) {
+        return;
+    }
+    switch (status) {
+        case MidiController:
+            sinkMsg.type = IMidiSink::Message::Type::controller;
+            sinkMsg.controller = message[1];
+            sinkMsg.value = message[2];
+            sendToSink(sinkMsg);
+            return;
+        case MidiPitch:
+            sinkMsg.type = IMidiSink::Message::Type::pitchBend;
+            sinkMsg.value = (message[1] | (message[2] << 7)) - 8192;
+            sendToSink(sinkMsg);
+            return;
         case MidiNoteOn:
-            // message should be three bytes
-            if (msgSize == 3) {
-                mLastNotePitch = (int)message[1];
-                // 69 is A-4
-                // 36 is C-2
-                int trackerboyNote = std::clamp((int)message[1] - 36, 0, (int)trackerboy::NOTE_LAST);
-                QCoreApplication::postEvent(this, new TU::MidiEvent(TU::MidiEvent::NoteOn, trackerboyNote), Qt::HighEventPriority);
-            }
+        case MidiNoteOff:
             break;
         default:
-            break; // ignore everything else
+            return; // ignore everything else
+    }
+
+    auto const pitch = (int)message[1];
+    // a note on with a velocity of 0 is a note off
+    auto const isNoteOn = status == MidiNoteOn && message[2] != 0;
+    // 69 is A-4
+    // 36 is C-2
+    auto const trackerboyNote = std::clamp(pitch - 36, 0, (int)trackerboy::NOTE_LAST);
+
+    // the sink gets every note, so that chords can be previewed
+    sinkMsg.type = isNoteOn ? IMidiSink::Message::Type::noteOn : IMidiSink::Message::Type::noteOff;
+    sinkMsg.note = (uint8_t)trackerboyNote;
+    auto const previewed = sendToSink(sinkMsg);
+
+    // the receiver only gets the noteOff for the last note on
+    NoteMessage note;
+    note.previewed = previewed;
+    if (isNoteOn) {
+        mLastNotePitch = pitch;
+        note.note = trackerboyNote;
+    } else if (mLastNotePitch == pitch) {
+        mLastNotePitch = -1;
+    } else {
+        return;
+    }
+
+    if (mNoteQueue.push(note) && !mNotifyPending.exchange(true, std::memory_order_acq_rel)) {
+        QCoreApplication::postEvent(this, new QEvent(TU::NOTIFY_EVENT), Qt::HighEventPriority);
     }
 
 }
 
+bool Midi::sendToSink(IMidiSink::Message &msg) {
+    if (auto sink = mSink.load(std::memory_order_acquire); sink) {
+        msg.time = mTime;
+        return sink->midiMessage(msg);
+    }
+    return false;
+}
+
 void Midi::midiErrorCallback(RtMidiError::Type type, const std::string &errorText, void *userData) {
     static_cast<Midi*>(userData)->handleMidiError(type, errorText);
 }
@@ -3,6 +3,8 @@
 
 #include "midi/MidiEnumerator.hpp"
 #include "midi/IMidiReceiver.hpp"
+#include "midi/IMidiSink.hpp"
+#include "utils/SpscQueue.hpp"
 
 #include "RtMidi.h"
 
@@ -20,12 +22,15 @@
 #define OPTIONAL(T) std::optional<T>
 #endif
 
+#include <atomic>
 #include <vector>
 
 
 //
 // Midi class. Notifies an IMidiReceiver whenever a MIDI note message
-// is received.
+// is received. If a sink is set, note messages are also forwarded to it
+// directly from the MIDI input thread so that previews do not have to wait
+// on the GUI event loop.
 //
 class Midi : public QObject {
 
@@ -61,6 +66,18 @@ public:
     //
     void setReceiver(IMidiReceiver *receiver);
 
+    //
+    // Gets the current receiver
+    //
+    IMidiReceiver* receiver() const;
+
+    //
+    // Set the sink that will preview notes as soon as they are received,
+    // nullptr for none. The receiver is still notified of every note message.
+    // Controller, pitch bend and transport messages are only sent to the sink.
+    //
+    void setSink(IMidiSink *sink);
+
     
 signals:
     //
@@ -75,14 +92,31 @@ protected:
 private:
     Q_DISABLE_COPY(Midi)
 
+    struct NoteMessage {
+        // trackerboy note, or -1 for note off
+        int note = -1;
+        // true if the sink has handled the preview
+        bool previewed = false;
+    };
+
     IMidiReceiver *mReceiver;
     bool mNoteDown;
 
+    std::atomic<IMidiSink*> mSink;
+
+    // note messages for the GUI thread, a single event is posted for every
+    // burst of messages so that the event queue does not get flooded
+    SpscQueue<NoteMessage, 64> mNoteQueue;
+    std::atomic_bool mNotifyPending;
+
     // callback functions
     // note that these functions are called from a separate thread
 
     static void midiInCallback(double deltatime, std::vector<unsigned char> *message, void *userData);
     void handleMidiIn(double deltatime, std::vector<unsigned char> &message);
+    // timestamps the message and sends it to the sink, if set. Returns true
+    // if the sink accepted it
+    bool sendToSink(IMidiSink::Message &msg);
 
     static void midiErrorCallback(RtMidiError::Type type, const std::string &errorText, void *userData);
     void handleMidiError(RtMidiError::Type type, const std::string &errorText);
@@ -96,11 +130,15 @@ private:
     QString mLastErrorString;
 
     // MIDI pitch of the last note on message, we only send the noteOff signal
-    // when we get a note off message with this pitch
+    // to the receiver when we get a note off message with this pitch. The sink
+    // gets all note off messages.
     int mLastNotePitch;
 
     // end of mutex requirement
 
+    // accumulated deltatime of received messages, MIDI thread only
+    double mTime;
+
 
 };
 
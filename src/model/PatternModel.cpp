@@ -67,14 +67,26 @@ trackerboy::Pattern* PatternModel::previousPattern() {
     return mPatternPrev ? &*mPatternPrev : nullptr;
 }
 
+trackerboy::Pattern const* PatternModel::previousPattern() const {
+    return mPatternPrev ? &*mPatternPrev : nullptr;
+}
+
 trackerboy::Pattern& PatternModel::currentPattern() {
     return mPatternCurr;
 }
 
+trackerboy::Pattern const& PatternModel::currentPattern() const {
+    return mPatternCurr;
+}
+
 trackerboy::Pattern* PatternModel::nextPattern() {
     return mPatternNext ? &*mPatternNext : nullptr;
 }
 
+trackerboy::Pattern const* PatternModel::nextPattern() const {
+    return mPatternNext ? &*mPatternNext : nullptr;
+}
+
 trackerboy::Order& PatternModel::order() {
     return source()->order();
 }
@@ -429,8 +441,15 @@ void PatternModel::setCursorPatternImpl(int pattern, CursorChangeFlags &flags) {
         return;
     }
 
+    auto const oldPattern = mCursorPattern;
     mCursorPattern = pattern;
-    setPatterns(pattern, flags);
+    if (oldPattern >= 0 && (pattern == oldPattern + 1 || pattern == oldPattern - 1)) {
+        // moving to an adjacent pattern (ie following playback), reuse the
+        // accessors we already have
+        shiftPatterns(pattern, pattern > oldPattern, flags);
+    } else {
+        setPatterns(pattern, flags);
+    }
     emit cursorPatternChanged(pattern);
     deselect();
 }
@@ -512,8 +531,42 @@ void PatternModel::setPatterns(int pattern, CursorChangeFlags &flags) {
     // update the current pattern
     auto oldsize = mPatternCurr.totalRows();
     mPatternCurr = song->getPattern(pattern);
-    auto newsize = mPatternCurr.totalRows();
+    patternsReplaced(oldsize, flags);
+}
+
+void PatternModel::shiftPatterns(int pattern, bool forward, CursorChangeFlags &flags) {
+    auto song = source();
+    auto oldsize = mPatternCurr.totalRows();
 
+    if (mShowPreviews) {
+        // the old current pattern becomes a preview, and the preview we are
+        // moving to becomes the current one
+        if (forward) {
+            mPatternPrev.emplace(std::move(mPatternCurr));
+            mPatternCurr = mPatternNext ? std::move(*mPatternNext) : song->getPattern(pattern);
+            if (pattern + 1 < patterns()) {
+                mPatternNext.emplace(song->getPattern(pattern + 1));
+            } else {
+                mPatternNext.reset();
+            }
+        } else {
+            mPatternNext.emplace(std::move(mPatternCurr));
+            mPatternCurr = mPatternPrev ? std::move(*mPatternPrev) : song->getPattern(pattern);
+            if (pattern > 0) {
+                mPatternPrev.emplace(song->getPattern(pattern - 1));
+            } else {
+                mPatternPrev.reset();
+            }
+        }
+    } else {
+        mPatternCurr = song->getPattern(pattern);
+    }
+
+    patternsReplaced(oldsize, flags);
+}
+
+void PatternModel::patternsReplaced(int oldsize, CursorChangeFlags &flags) {
+    auto newsize = mPatternCurr.totalRows();
     if (oldsize != newsize) {
         emit patternSizeChanged(newsize);
     }
@@ -556,11 +609,7 @@ int PatternModel::cursorEffectNo() {
 void PatternModel::invalidate(int pattern, bool updatePatterns) {
 
     // check if the pattern being invalidated is accessible
-    bool isInvalid = (mCursorPattern == pattern) ||
-                     (mPatternPrev && pattern == mCursorPattern - 1) ||
-                     (mPatternNext && pattern == mCursorPattern + 1);
-
-    if (isInvalid) {
+    if (patternIsAccessible(pattern)) {
         // pattern is now invalid, either reset the pattern accessors
         // or send the invalidated signal
         if (updatePatterns) {
@@ -576,6 +625,18 @@ void PatternModel::invalidate(int pattern, bool updatePatterns) {
 
 }
 
+void PatternModel::invalidateRows(int pattern, int rowStart, int rowEnd) {
+    if (patternIsAccessible(pattern)) {
+        emit rowsInvalidated(pattern, rowStart, rowEnd);
+    }
+}
+
+bool PatternModel::patternIsAccessible(int pattern) const {
+    return (mCursorPattern == pattern) ||
+           (mPatternPrev && pattern == mCursorPattern - 1) ||
+           (mPatternNext && pattern == mCursorPattern + 1);
+}
+
 bool PatternModel::selectionDataIsEmpty() {
     if (mHasSelection) {
         auto iter = mSelection.iterator();
@@ -653,35 +714,26 @@ void PatternModel::setNote(std::optional<uint8_t> note, std::optional<uint8_t> i
     }
     // edit the instrument if the instrument has a value and the it does not equal the current instrument
     auto const editInstrument = instrument && oldInstrument != instrument;
-    int editCount = editNote + editInstrument;
-    if (editCount) {
-        QUndoCommand *parent = nullptr;
-        QUndoCommand *cmd = nullptr;
-
-        if (editCount == 2) {
-            parent = new QUndoCommand;
-        }
+    if (editNote || editInstrument) {
+        // both edits go in a single command so that note entry can be merged
+        TrackEditCmd *cmd = nullptr;
 
         if (editNote) {
             cmd = new NoteEditCmd(
                 *this,
                 trackerboy::TrackRow::convertColumn(note),
-                trackerboy::TrackRow::convertColumn(oldNote),
-                parent
+                trackerboy::TrackRow::convertColumn(oldNote)
             );
         }
 
         if (editInstrument) {
-            cmd = new InstrumentEditCmd(
-                *this,
-                trackerboy::TrackRow::convertColumn(instrument),
-                trackerboy::TrackRow::convertColumn(oldInstrument),
-                parent
-            );
-        }
-
-        if (parent) {
-            cmd = parent;
+            auto const instrumentNew = trackerboy::TrackRow::convertColumn(instrument);
+            auto const instrumentOld = trackerboy::TrackRow::convertColumn(oldInstrument);
+            if (cmd) {
+                cmd->addEdit(TrackEditCmd::ColumnInstrument, instrumentNew, instrumentOld);
+            } else {
+                cmd = new InstrumentEditCmd(*this, instrumentNew, instrumentOld);
+            }
         }
 
         if (note) {
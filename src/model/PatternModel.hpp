@@ -46,13 +46,16 @@ public:
 
     // Data Access ============================================================
 
-    // TODO: make these accessors private (for command classes), add public const versions
+    // TODO: make the non-const accessors private (for command classes)
 
     trackerboy::Pattern* previousPattern();
+    trackerboy::Pattern const* previousPattern() const;
 
     trackerboy::Pattern& currentPattern();
+    trackerboy::Pattern const& currentPattern() const;
 
     trackerboy::Pattern* nextPattern();
+    trackerboy::Pattern const* nextPattern() const;
 
     trackerboy::Order& order();
     trackerboy::Order const& order() const;
@@ -266,6 +269,12 @@ signals:
     //
     void invalidated();
 
+    //
+    // emitted when only a range of rows in the given pattern have been
+    // modified. Views may redraw just those rows instead of everything.
+    //
+    void rowsInvalidated(int pattern, int rowStart, int rowEnd);
+
     void effectsVisibleChanged();
 
     void totalColumnsChanged(int columns);
@@ -303,6 +312,18 @@ private:
     void setCursorPatternImpl(int pattern, CursorChangeFlags &flags);
 
     void setPatterns(int pattern, CursorChangeFlags &flags);
+
+    //
+    // Moves the pattern accessors to an adjacent pattern, only the new
+    // preview pattern needs to be fetched from the song. forward is true
+    // if pattern is the next pattern, false if it is the previous one.
+    //
+    void shiftPatterns(int pattern, bool forward, CursorChangeFlags &flags);
+
+    //
+    // Called after the pattern accessors were replaced
+    //
+    void patternsReplaced(int oldsize, CursorChangeFlags &flags);
     void setPreviewPatterns(int pattern);
 
     void emitIfChanged(CursorChangeFlags flags);
@@ -321,6 +342,13 @@ private:
 
     void invalidate(int pattern, bool updatePatterns);
 
+    //
+    // Same as invalidate(pattern, false) but only the given rows were changed
+    //
+    void invalidateRows(int pattern, int rowStart, int rowEnd);
+
+    bool patternIsAccessible(int pattern) const;
+
     bool selectionDataIsEmpty();
 
     // called by insert, remove and duplicate commands
@@ -0,0 +1,26 @@
+
+#include "model/commands/memory.hpp"
+
+size_t commandMemoryUsage(QUndoCommand const *cmd) {
+    size_t size;
+    if (auto measured = dynamic_cast<MeasuredCommand const*>(cmd)) {
+        size = measured->memoryUsage();
+    } else {
+        // not measured, assume it is just the object
+        size = sizeof(QUndoCommand);
+    }
+    size += (size_t)cmd->text().capacity() * sizeof(QChar);
+
+    for (int i = 0; i < cmd->childCount(); ++i) {
+        size += commandMemoryUsage(cmd->child(i));
+    }
+    return size;
+}
+
+size_t stackMemoryUsage(QUndoStack const *stack) {
+    size_t size = 0;
+    for (int i = 0; i < stack->count(); ++i) {
+        size += commandMemoryUsage(stack->command(i));
+    }
+    return size;
+}
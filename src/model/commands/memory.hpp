@@ -0,0 +1,34 @@
+
+#pragma once
+
+#include <QUndoCommand>
+#include <QUndoStack>
+
+#include <cstddef>
+
+//
+// Interface for undo commands that can report the memory they use. Commands
+// that hold a variable amount of data should implement this so that the
+// history's memory usage can be reported accurately.
+//
+class MeasuredCommand {
+
+public:
+    virtual ~MeasuredCommand() = default;
+
+    //
+    // Size, in bytes, of the command's data, including any heap allocations
+    //
+    virtual size_t memoryUsage() const = 0;
+
+};
+
+//
+// Estimates the memory used by a command and all of its children.
+//
+size_t commandMemoryUsage(QUndoCommand const *cmd);
+
+//
+// Estimates the memory used by all commands in the given stack.
+//
+size_t stackMemoryUsage(QUndoStack const *stack);
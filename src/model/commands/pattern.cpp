@@ -2,72 +2,135 @@
 #include "model/commands/pattern.hpp"
 #include "model/PatternModel.hpp"
 
+#include <algorithm>
+#include <iterator>
+
 #define TU commandsPatternTU
 
-SelectionCmd::SelectionCmd(PatternModel &model) :
+namespace TU {
+
+static bool rowEquals(trackerboy::TrackRow const& lhs, trackerboy::TrackRow const& rhs) {
+    if (lhs.note != rhs.note || lhs.instrumentId != rhs.instrumentId) {
+        return false;
+    }
+    for (size_t i = 0; i < std::size(lhs.effects); ++i) {
+        if (lhs.effects[i].type != rhs.effects[i].type || lhs.effects[i].param != rhs.effects[i].param) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+SelectionCmd::SelectionCmd(PatternModel &model, bool updatePatterns) :
     mModel(model),
     mPattern((uint8_t)model.mCursorPattern),
-    mClip()
+    mSelection(model.mSelection),
+    mUpdatePatterns(updatePatterns),
+    mRecorded(false),
+    mChanges()
 {
-    mClip.save(model.mPatternCurr, model.mSelection);
 }
 
-void SelectionCmd::restore(bool update) {
-    auto pattern = mModel.source()->getPattern(mPattern);
+void SelectionCmd::redo() {
     {
         auto ctx = mModel.mModule.edit();
-        mClip.restore(pattern);
+        if (mRecorded) {
+            edit();
+        } else {
+            // first time, copy the selected rows so we can find out which
+            // ones the edit changed. Only those are kept.
+            auto const iter = mSelection.iterator();
+            std::vector<trackerboy::TrackRow> before;
+            before.reserve((size_t)(iter.trackEnd() - iter.trackStart() + 1) * iter.rows());
+            for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+                auto const& data = mModel.getTrack(mPattern, track);
+                for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+                    before.push_back(data[row]);
+                }
+            }
+
+            edit();
+
+            auto prev = before.cbegin();
+            for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+                auto const& data = mModel.getTrack(mPattern, track);
+                for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+                    if (!TU::rowEquals(*prev, data[row])) {
+                        mChanges.push_back({ (uint8_t)track, (uint8_t)row, *prev });
+                    }
+                    ++prev;
+                }
+            }
+            mChanges.shrink_to_fit();
+            mRecorded = true;
+        }
+    }
+
+    invalidate();
+}
+
+void SelectionCmd::undo() {
+    {
+        auto ctx = mModel.mModule.edit();
+        for (auto const& change : mChanges) {
+            mModel.getTrack(mPattern, change.track)[change.row] = change.data;
+        }
     }
 
-    mModel.invalidate(mPattern, update);
+    invalidate();
+}
+
+size_t SelectionCmd::memoryUsage() const {
+    return sizeof(*this) + mChanges.capacity() * sizeof(Change);
+}
+
+void SelectionCmd::invalidate() {
+    if (mUpdatePatterns) {
+        mModel.invalidate(mPattern, true);
+    } else {
+        auto const iter = mSelection.iterator();
+        mModel.invalidateRows(mPattern, iter.rowStart(), iter.rowEnd());
+    }
 }
 
 EraseCmd::EraseCmd(PatternModel &model) :
-    SelectionCmd(model)
+    SelectionCmd(model, true)
 {
 }
 
-void EraseCmd::redo() {
-    {
-        auto ctx = mModel.mModule.edit();
-        // clear all set data in the selection
-        auto const iter = mClip.selection().iterator();
+void EraseCmd::edit() {
+    // clear all set data in the selection
+    auto const iter = mSelection.iterator();
 
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            auto tmeta = iter.getTrackMeta(track);
-            auto &data = mModel.getTrack(mPattern, track);
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        auto tmeta = iter.getTrackMeta(track);
+        auto &data = mModel.getTrack(mPattern, track);
 
-            for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
-                auto &rowdata = data[row];
-                if (tmeta.hasColumn<PatternAnchor::SelectNote>()) {
-                    rowdata.note = 0;
-                }
+        for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+            auto &rowdata = data[row];
+            if (tmeta.hasColumn<PatternAnchor::SelectNote>()) {
+                rowdata.note = 0;
+            }
 
-                if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
-                    rowdata.instrumentId = 0;
-                }
+            if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
+                rowdata.instrumentId = 0;
+            }
 
-                if (tmeta.hasColumn<PatternAnchor::SelectEffect1>()) {
-                    rowdata.effects[0] = trackerboy::NO_EFFECT;
-                }
+            if (tmeta.hasColumn<PatternAnchor::SelectEffect1>()) {
+                rowdata.effects[0] = trackerboy::NO_EFFECT;
+            }
 
-                if (tmeta.hasColumn<PatternAnchor::SelectEffect2>()) {
-                    rowdata.effects[1] = trackerboy::NO_EFFECT;
-                }
+            if (tmeta.hasColumn<PatternAnchor::SelectEffect2>()) {
+                rowdata.effects[1] = trackerboy::NO_EFFECT;
+            }
 
-                if (tmeta.hasColumn<PatternAnchor::SelectEffect3>()) {
-                    rowdata.effects[2] = trackerboy::NO_EFFECT;
-                }
+            if (tmeta.hasColumn<PatternAnchor::SelectEffect3>()) {
+                rowdata.effects[2] = trackerboy::NO_EFFECT;
             }
         }
-
     }
-
-    mModel.invalidate(mPattern, true);
-}
-
-void EraseCmd::undo() {
-    restore(true);
 }
 
 PasteCmd::PasteCmd(
@@ -84,6 +147,10 @@ PasteCmd::PasteCmd(
     mPattern((uint8_t)model.mCursorPattern),
     mMix(mix)
 {
+    // the clips are at most an entire 256 row pattern each
+    static_assert(sizeof(PasteCmd) + 2 * 256 * 4 * sizeof(trackerboy::TrackRow) <= Module::UNDO_COMMAND_MAX_SIZE,
+                  "pasted clips exceed the undo command size");
+
     auto region = mSrc.selection();
     region.moveTo(pos);
     region.clamp(model.mPatternCurr.size() - 1);
@@ -110,6 +177,10 @@ void PasteCmd::undo() {
     mModel.invalidate(mPattern, true);
 }
 
+size_t PasteCmd::memoryUsage() const {
+    return sizeof(*this) + mSrc.dataSize() + mPast.dataSize();
+}
+
 ReverseCmd::ReverseCmd(PatternModel &model) :
     mModel(model),
     mSelection(model.mSelection),
@@ -168,41 +239,32 @@ void ReverseCmd::reverse() {
 }
 
 ReplaceInstrumentCmd::ReplaceInstrumentCmd(PatternModel &model, int instrument) :
-    SelectionCmd(model),
+    SelectionCmd(model, false),
     mInstrument(instrument)
 {
 
 }
 
-void ReplaceInstrumentCmd::redo() {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto const iter = mClip.selection().iterator();
+void ReplaceInstrumentCmd::edit() {
+    auto const iter = mSelection.iterator();
 
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            auto tmeta = iter.getTrackMeta(track);
-            auto &data = mModel.getTrack(mPattern, track);
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        auto tmeta = iter.getTrackMeta(track);
+        auto &data = mModel.getTrack(mPattern, track);
 
-            if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
-                for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
-                    auto &rowdata = data[row];
-                    if (rowdata.queryInstrument().has_value()) {
-                        rowdata.setInstrument((uint8_t)mInstrument);
-                    }
+        if (tmeta.hasColumn<PatternAnchor::SelectInstrument>()) {
+            for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+                auto &rowdata = data[row];
+                if (rowdata.queryInstrument().has_value()) {
+                    rowdata.setInstrument((uint8_t)mInstrument);
                 }
             }
         }
     }
-
-    mModel.invalidate(mPattern, false);
-}
-
-void ReplaceInstrumentCmd::undo() {
-    restore(false);
 }
 
 GrowCmd::GrowCmd(PatternModel& model) :
-    SelectionCmd(model)
+    SelectionCmd(model, true)
 {
 }
 
@@ -249,162 +311,245 @@ static void shrink(trackerboy::Track &track, int rowStart, int rowEnd) {
 
 }
 
-void GrowCmd::redo() {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto const iter = mClip.selection().iterator();
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            TU::grow(mModel.getTrack(mPattern, track), iter.rowStart(), iter.rowEnd());
-        }
+void GrowCmd::edit() {
+    auto const iter = mSelection.iterator();
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        TU::grow(mModel.getTrack(mPattern, track), iter.rowStart(), iter.rowEnd());
     }
-    mModel.invalidate(mPattern, true);
-}
-
-void GrowCmd::undo() {
-    restore(true);
 }
 
 ShrinkCmd::ShrinkCmd(PatternModel& model) :
-    SelectionCmd(model)
+    SelectionCmd(model, true)
 {
 }
 
-void ShrinkCmd::redo() {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto const iter = mClip.selection().iterator();
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            TU::shrink(mModel.getTrack(mPattern, track), iter.rowStart(), iter.rowEnd());
-        }
+void ShrinkCmd::edit() {
+    auto const iter = mSelection.iterator();
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        TU::shrink(mModel.getTrack(mPattern, track), iter.rowStart(), iter.rowEnd());
     }
-    mModel.invalidate(mPattern, true);
-}
-
-void ShrinkCmd::undo() {
-    restore(true);
 }
 
 TrackEditCmd::TrackEditCmd(
     PatternModel &model,
+    Column column,
+    uint8_t effectNo,
     uint8_t dataNew,
     uint8_t dataOld,
     QUndoCommand *parent
 ) :
     QUndoCommand(parent),
     mModel(model),
-    mTrack((uint8_t)(model.mCursor.track)),
-    mPattern((uint8_t)model.mCursorPattern),
-    mRow((uint8_t)model.mCursor.row),
-    mNewData(dataNew),
-    mOldData(dataOld)
+    mEdits(),
+    mTime(std::chrono::steady_clock::now())
 {
+    static_assert(sizeof(Edit) * MAX_EDITS <= Module::UNDO_COMMAND_MAX_SIZE, "merged edits exceed the undo command size");
+
+    mEdits.push_back({
+        (uint8_t)model.mCursorPattern,
+        (uint8_t)model.mCursor.track,
+        (uint8_t)model.mCursor.row,
+        column,
+        effectNo,
+        dataNew,
+        dataOld
+    });
 }
 
 void TrackEditCmd::redo() {
-    setData(mNewData);
+    apply<true>(mEdits.cbegin(), mEdits.cend());
 }
 
 void TrackEditCmd::undo() {
-    setData(mOldData);
+    apply<false>(mEdits.crbegin(), mEdits.crend());
 }
 
-trackerboy::TrackRow& TrackEditCmd::getRow() {
-    return mModel.source()->getRow(
-        static_cast<trackerboy::ChType>(mTrack),
-        mPattern,
-        (uint16_t)mRow
-    );
+size_t TrackEditCmd::memoryUsage() const {
+    return sizeof(*this) + mEdits.capacity() * sizeof(Edit);
 }
 
-void TrackEditCmd::setData(uint8_t data) {
-    auto &rowdata = mModel.source()->getRow(
-        static_cast<trackerboy::ChType>(mTrack),
-        mPattern,
-        (uint16_t)mRow
-    );
+int TrackEditCmd::id() const {
+    return ID;
+}
 
-    bool update;
-    {
-        auto ctx = mModel.mModule.edit();
-        update = edit(rowdata, data);
+bool TrackEditCmd::mergeWith(QUndoCommand const *other) {
+    // QUndoStack only calls this for commands with the same id
+    auto cmd = static_cast<TrackEditCmd const*>(other);
+    if (cmd->text() != text() || (int)(mEdits.size() + cmd->mEdits.size()) > MAX_EDITS) {
+        return false;
     }
 
-    mModel.invalidate(mPattern, update);
+    auto const elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(cmd->mTime - mTime);
+    bool const isBurst = mModel.isPlaying() && elapsed.count() <= MERGE_WINDOW;
+    if (!isBurst && !mEdits.back().sameCell(cmd->mEdits.front())) {
+        return false;
+    }
 
+    for (auto const& edit : cmd->mEdits) {
+        // edits to the same row are adjacent, check them for the same cell
+        bool merged = false;
+        for (auto iter = mEdits.rbegin(); iter != mEdits.rend(); ++iter) {
+            if (iter->pattern != edit.pattern || iter->track != edit.track || iter->row != edit.row) {
+                break;
+            }
+            if (iter->sameCell(edit)) {
+                iter->newData = edit.newData;
+                merged = true;
+                break;
+            }
+        }
+        if (!merged) {
+            mEdits.push_back(edit);
+        }
+    }
+    mTime = cmd->mTime;
+
+    if (mEdits.size() == 1 && mEdits[0].newData == mEdits[0].oldData) {
+        // the cell was changed back to what it was, drop the command
+        setObsolete(true);
+    }
+    return true;
 }
 
-// ===
+void TrackEditCmd::addEdit(Column column, uint8_t dataNew, uint8_t dataOld) {
+    auto edit = mEdits.front();
+    edit.column = column;
+    edit.newData = dataNew;
+    edit.oldData = dataOld;
+    mEdits.push_back(edit);
+}
 
-bool NoteEditCmd::edit(trackerboy::TrackRow &rowdata, uint8_t data) {
-    rowdata.note = data;
-    return false;
+bool TrackEditCmd::Edit::sameCell(Edit const& other) const {
+    return pattern == other.pattern &&
+           track == other.track &&
+           row == other.row &&
+           column == other.column &&
+           effectNo == other.effectNo;
 }
 
-// ===
+template <bool newData, class Iter>
+void TrackEditCmd::apply(Iter begin, Iter end) {
+
+    bool update = false;
+    {
+        auto ctx = mModel.mModule.edit();
+        auto song = mModel.source();
+        for (auto iter = begin; iter != end; ++iter) {
+            auto const& edit = *iter;
+            auto &rowdata = song->getRow(
+                static_cast<trackerboy::ChType>(edit.track),
+                edit.pattern,
+                (uint16_t)edit.row
+            );
+            auto const data = newData ? edit.newData : edit.oldData;
+
+            switch (edit.column) {
+                case ColumnNote:
+                    rowdata.note = data;
+                    break;
+                case ColumnInstrument:
+                    rowdata.instrumentId = data;
+                    break;
+                case ColumnEffectType: {
+                    auto &effect = rowdata.effects[edit.effectNo];
+                    auto oldtype = effect.type;
+                    auto type = static_cast<trackerboy::EffectType>(data);
+                    effect.type = type;
+                    update = update ||
+                             trackerboy::effectTypeShortensPattern(type) ||
+                             trackerboy::effectTypeShortensPattern(oldtype);
+                    break;
+                }
+                case ColumnEffectParam:
+                    rowdata.effects[edit.effectNo].param = data;
+                    break;
+            }
+        }
+    }
+
+    // notify the model, consecutive edits in the same pattern are reported
+    // as a single range of rows
+    auto iter = begin;
+    while (iter != end) {
+        int const pattern = iter->pattern;
+        int rowStart = iter->row;
+        int rowEnd = iter->row;
+        for (++iter; iter != end && iter->pattern == pattern; ++iter) {
+            rowStart = std::min(rowStart, (int)iter->row);
+            rowEnd = std::max(rowEnd, (int)iter->row);
+        }
+
+        if (update) {
+            mModel.invalidate(pattern, true);
+        } else {
+            mModel.invalidateRows(pattern, rowStart, rowEnd);
+        }
+    }
 
-bool InstrumentEditCmd::edit(trackerboy::TrackRow &rowdata, uint8_t data) {
-    rowdata.instrumentId = data;
-    return false;
 }
 
-// ===
+NoteEditCmd::NoteEditCmd(
+    PatternModel &model,
+    uint8_t dataNew,
+    uint8_t dataOld,
+    QUndoCommand *parent
+) :
+    TrackEditCmd(model, ColumnNote, 0, dataNew, dataOld, parent)
+{
+}
 
-EffectEditCmd::EffectEditCmd(
+InstrumentEditCmd::InstrumentEditCmd(
+    PatternModel &model,
+    uint8_t dataNew,
+    uint8_t dataOld,
+    QUndoCommand *parent
+) :
+    TrackEditCmd(model, ColumnInstrument, 0, dataNew, dataOld, parent)
+{
+}
+
+EffectTypeEditCmd::EffectTypeEditCmd(
     PatternModel &model,
     uint8_t effectNo,
     uint8_t newData,
     uint8_t oldData,
     QUndoCommand *parent
 ) :
-    TrackEditCmd(model, newData, oldData, parent),
-    mEffectNo(effectNo)
+    TrackEditCmd(model, ColumnEffectType, effectNo, newData, oldData, parent)
 {
 }
 
-bool EffectTypeEditCmd::edit(trackerboy::TrackRow &rowdata, uint8_t data)  {
-    auto &effect = rowdata.effects[mEffectNo];
-    auto oldtype = effect.type;
-    auto type = static_cast<trackerboy::EffectType>(data);
-    effect.type = type;
-    return trackerboy::effectTypeShortensPattern(type) || trackerboy::effectTypeShortensPattern(oldtype);
-}
-
-// ===
-
-bool EffectParamEditCmd::edit(trackerboy::TrackRow &rowdata, uint8_t data) {
-    rowdata.effects[mEffectNo].param = data;
-    return false;
+EffectParamEditCmd::EffectParamEditCmd(
+    PatternModel &model,
+    uint8_t effectNo,
+    uint8_t newData,
+    uint8_t oldData,
+    QUndoCommand *parent
+) :
+    TrackEditCmd(model, ColumnEffectParam, effectNo, newData, oldData, parent)
+{
 }
 
 TransposeCmd::TransposeCmd(PatternModel &model, int8_t transposeAmount) :
-    SelectionCmd(model),
+    SelectionCmd(model, false),
     mTransposeAmount(transposeAmount)
 {
 }
 
-void TransposeCmd::redo()  {
-    {
-        auto ctx = mModel.mModule.edit();
-        auto const iter = mClip.selection().iterator();
+void TransposeCmd::edit() {
+    auto const iter = mSelection.iterator();
 
-        for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
-            auto tmeta = iter.getTrackMeta(track);
-            if (!tmeta.hasColumn<PatternAnchor::SelectNote>()) {
-                continue;
-            }
+    for (auto track = iter.trackStart(); track <= iter.trackEnd(); ++track) {
+        auto tmeta = iter.getTrackMeta(track);
+        if (!tmeta.hasColumn<PatternAnchor::SelectNote>()) {
+            continue;
+        }
 
-            auto &data = mModel.getTrack(mPattern, track);
-            for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
-                data[row].transpose(mTransposeAmount);
-            }
+        auto &data = mModel.getTrack(mPattern, track);
+        for (auto row = iter.rowStart(); row <= iter.rowEnd(); ++row) {
+            data[row].transpose(mTransposeAmount);
         }
     }
-
-    mModel.invalidate(mPattern, false);
-}
-
-void TransposeCmd::undo() {
-    restore(false);
 }
 
 BackspaceCmd::BackspaceCmd(PatternModel &model, QUndoCommand *parent) :
@@ -4,33 +4,69 @@
 class PatternModel;
 
 #include "clipboard/PatternClip.hpp"
+#include "core/PatternSelection.hpp"
+#include "model/commands/memory.hpp"
 
 #include "trackerboy/data/TrackRow.hpp"
 
 #include <QUndoCommand>
 
+#include <chrono>
 #include <cstdint>
+#include <vector>
 
 
 //
-// Base class for commands that operate on a PatternSelection
+// Base class for commands that operate on a PatternSelection. Only the rows
+// that were actually changed by the command are saved for undo'ing, so a
+// command on a large selection that touches a few cells stays small.
 //
-class SelectionCmd : public QUndoCommand {
+class SelectionCmd : public QUndoCommand, public MeasuredCommand {
+
+public:
+
+    virtual void redo() override;
+
+    virtual void undo() override;
+
+    virtual size_t memoryUsage() const override;
 
 protected:
     PatternModel &mModel;
     uint8_t mPattern;
-    PatternClip mClip;
+    PatternSelection mSelection;
+
+    //
+    // initializes the command with the current selection. If updatePatterns
+    // is true, the model's pattern accessors are reset after redo/undo,
+    // otherwise only the selected rows are invalidated.
+    //
+    explicit SelectionCmd(PatternModel &model, bool updatePatterns);
 
     //
-    // initializes the command by saving a clip of the current selection
+    // Modifies the pattern data within the selection. The module is locked
+    // when this is called.
     //
-    explicit SelectionCmd(PatternModel &model);
+    virtual void edit() = 0;
+
+private:
+
+    void invalidate();
 
     //
-    // Restores the saved clip
+    // A track row that was changed by the command, the data is the row
+    // before the edit
     //
-    void restore(bool update);
+    struct Change {
+        uint8_t track;
+        uint8_t row;
+        trackerboy::TrackRow data;
+    };
+
+    bool const mUpdatePatterns;
+    // true once the changes were recorded on the first redo
+    bool mRecorded;
+    std::vector<Change> mChanges;
 
 };
 
@@ -43,16 +79,15 @@ public:
 
     EraseCmd(PatternModel &model);
 
-    virtual void redo() override;
-
-    virtual void undo() override;
+protected:
+    virtual void edit() override;
 
 };
 
 //
 // Command for pasting pattern data
 //
-class PasteCmd : public QUndoCommand {
+class PasteCmd : public QUndoCommand, public MeasuredCommand {
 
     PatternModel &mModel;
     PatternClip mSrc;
@@ -73,6 +108,8 @@ public:
 
     virtual void undo() override;
 
+    virtual size_t memoryUsage() const override;
+
 };
 
 //
@@ -113,10 +150,8 @@ public:
 
     explicit ReplaceInstrumentCmd(PatternModel &model, int instrument);
 
-    virtual void redo() override;
-    
-    virtual void undo() override;
-    
+protected:
+    virtual void edit() override;
 
 };
 
@@ -128,9 +163,8 @@ class GrowCmd : public SelectionCmd {
 public:
     explicit GrowCmd(PatternModel &model);
 
-    virtual void redo() override;
-
-    virtual void undo() override;
+protected:
+    virtual void edit() override;
 
 };
 
@@ -142,45 +176,94 @@ class ShrinkCmd : public SelectionCmd {
 public:
     explicit ShrinkCmd(PatternModel &model);
 
-    virtual void redo() override;
-
-    virtual void undo() override;
+protected:
+    virtual void edit() override;
 
 };
 
 
 //
-// Base command class for editing a column in a track row
+// Base command class for editing a column in a track row. Consecutive edits
+// to the same cell (ie typing both nibbles of an instrument) are merged into
+// a single command, as are bursts of edits made during playback so that live
+// recording does not flood the undo stack.
 //
-class TrackEditCmd : public QUndoCommand {
-
-protected:
-    PatternModel &mModel;
-    uint8_t const mTrack;
-    uint8_t const mPattern;
-    uint8_t const mRow;
-    uint8_t const mNewData;
-    uint8_t const mOldData;
+class TrackEditCmd : public QUndoCommand, public MeasuredCommand {
 
 public:
+
+    enum Column : uint8_t {
+        ColumnNote,
+        ColumnInstrument,
+        ColumnEffectType,
+        ColumnEffectParam
+    };
+
+    // id used by QUndoStack for merging
+    static constexpr int ID = 1;
+
+    //
+    // Edits made within this many milliseconds of each other, while playing,
+    // are merged into one command.
+    //
+    static constexpr int MERGE_WINDOW = 1000;
+
+    //
+    // Maximum number of edits a merged command can hold. Keeps the size of
+    // a single command bounded, see Module::UNDO_LIMIT
+    //
+    static constexpr int MAX_EDITS = 2048;
+
+    virtual void redo() override;
+
+    virtual void undo() override;
+
+    virtual int id() const override;
+
+    virtual size_t memoryUsage() const override;
+
+    virtual bool mergeWith(QUndoCommand const *other) override;
+
+    //
+    // Adds another column edit at the same position as the first one. Must
+    // be called before the command is pushed.
+    //
+    void addEdit(Column column, uint8_t dataNew, uint8_t dataOld);
+
+protected:
     explicit TrackEditCmd(
         PatternModel &model,
+        Column column,
+        uint8_t effectNo,
         uint8_t dataNew,
         uint8_t dataOld,
-        QUndoCommand *parent = nullptr
+        QUndoCommand *parent
     );
 
-    virtual void redo() override;
+private:
 
-    virtual void undo() override;
+    struct Edit {
+        uint8_t pattern;
+        uint8_t track;
+        uint8_t row;
+        Column column;
+        uint8_t effectNo;
+        uint8_t newData;
+        uint8_t oldData;
 
-protected:
-    trackerboy::TrackRow& getRow();
+        bool sameCell(Edit const& other) const;
+    };
 
-    virtual bool edit(trackerboy::TrackRow &rowdata, uint8_t data) = 0;
+    //
+    // Applies the edits, in order, with either the new or old data
+    //
+    template <bool newData, class Iter>
+    void apply(Iter begin, Iter end);
 
-private:
-    void setData(uint8_t data);
+    PatternModel &mModel;
+    std::vector<Edit> mEdits;
+    // time of the last merged edit
+    std::chrono::steady_clock::time_point mTime;
 
 };
 
@@ -189,10 +272,14 @@ private:
 //
 class NoteEditCmd : public TrackEditCmd {
 
-    using TrackEditCmd::TrackEditCmd;
+public:
+    explicit NoteEditCmd(
+        PatternModel &model,
+        uint8_t dataNew,
+        uint8_t dataOld,
+        QUndoCommand *parent = nullptr
+    );
 
-protected:
-    virtual bool edit(trackerboy::TrackRow &rowdata, uint8_t data) override;
 };
 
 //
@@ -200,20 +287,23 @@ protected:
 //
 class InstrumentEditCmd : public TrackEditCmd {
 
-    using TrackEditCmd::TrackEditCmd;
-
-protected:
-    virtual bool edit(trackerboy::TrackRow &rowdata, uint8_t data);
+public:
+    explicit InstrumentEditCmd(
+        PatternModel &model,
+        uint8_t dataNew,
+        uint8_t dataOld,
+        QUndoCommand *parent = nullptr
+    );
 
 };
 
 //
-// Base command class for editing an effect column
+// Command class for editing an effect type in a TrackRow
 //
-class EffectEditCmd : public TrackEditCmd {
+class EffectTypeEditCmd : public TrackEditCmd {
 
 public:
-    explicit EffectEditCmd(
+    explicit EffectTypeEditCmd(
         PatternModel &model,
         uint8_t effectNo,
         uint8_t newData,
@@ -221,31 +311,21 @@ public:
         QUndoCommand *parent = nullptr
     );
 
-protected:
-    uint8_t const mEffectNo;
-};
-
-//
-// Command class for editing an effect type in a TrackRow
-//
-class EffectTypeEditCmd : public EffectEditCmd {
-
-    using EffectEditCmd::EffectEditCmd;
-
-protected:
-    virtual bool edit(trackerboy::TrackRow &rowdata, uint8_t data) override;
-
 };
 
 //
 // Command class for editing an effect parameter in a TrackRow
 //
-class EffectParamEditCmd : public EffectEditCmd {
-
-    using EffectEditCmd::EffectEditCmd;
+class EffectParamEditCmd : public TrackEditCmd {
 
-protected:
-    virtual bool edit(trackerboy::TrackRow &rowdata, uint8_t data) override;
+public:
+    explicit EffectParamEditCmd(
+        PatternModel &model,
+        uint8_t effectNo,
+        uint8_t newData,
+        uint8_t oldData,
+        QUndoCommand *parent = nullptr
+    );
 
 };
 
@@ -260,9 +340,8 @@ public:
 
     explicit TransposeCmd(PatternModel &model, int8_t transposeAmount);
 
-    virtual void redo() override;
-
-    virtual void undo() override;
+protected:
+    virtual void edit() override;
 
 };
 
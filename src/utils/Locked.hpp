@@ -22,6 +22,10 @@ public:
         return &mRef;
     }
 
+    constexpr T& operator*() {
+        return mRef;
+    }
+
 private:
     // disable copy semantics, as copying a QMutexLocker makes no sense
     Q_DISABLE_COPY(Locked)
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+//
+// Fixed-capacity, lock-free queue for a single producer thread and a single
+// consumer thread. Neither push nor pop will ever block or allocate, making
+// this queue suitable for sending messages to a real-time thread.
+//
+// The capacity must be a power of two. One slot is always kept empty so the
+// queue can hold at most capacity - 1 elements.
+//
+// Only one thread may push and only one thread may pop at any given time.
+// Ownership of either end may be passed to another thread, provided that the
+// hand-off itself is synchronized (ie a mutex or a blocking queued
+// connection).
+//
+template <class T, size_t capacity>
+class SpscQueue {
+
+    static_assert(capacity >= 2 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+    static constexpr size_t MASK = capacity - 1;
+
+public:
+
+    SpscQueue() :
+        mHead(0),
+        mTail(0),
+        mSlots()
+    {
+    }
+
+    //
+    // Enqueues an item. false is returned if the queue is full, in which case
+    // the item is not moved.
+    //
+    bool push(T &&item) {
+        auto const tail = mTail.load(std::memory_order_relaxed);
+        auto const next = (tail + 1) & MASK;
+        if (next == mHead.load(std::memory_order_acquire)) {
+            return false;
+        }
+        mSlots[tail] = std::move(item);
+        mTail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool push(T const& item) {
+        T copy(item);
+        return push(std::move(copy));
+    }
+
+    //
+    // Dequeues an item, moving it into the given reference. false is returned
+    // if the queue was empty and item is left untouched.
+    //
+    bool pop(T &item) {
+        auto const head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(mSlots[head]);
+        // release any resources held by the moved-from slot
+        mSlots[head] = T();
+        mHead.store((head + 1) & MASK, std::memory_order_release);
+        return true;
+    }
+
+    //
+    // Determines if the queue is empty. The result is only exact when called
+    // from the consumer thread.
+    //
+    bool isEmpty() const {
+        return mHead.load(std::memory_order_acquire) == mTail.load(std::memory_order_acquire);
+    }
+
+private:
+    // head and tail are kept on separate cache lines to avoid false sharing
+    alignas(64) std::atomic_size_t mHead;
+    alignas(64) std::atomic_size_t mTail;
+    alignas(64) std::array<T, capacity> mSlots;
+
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+//
+// Wait-free triple buffer for publishing a value from one thread to another.
+// The writer fills the back buffer and publishes it, the reader always gets
+// the most recently published value. Neither side ever blocks the other, and
+// values published between reads are simply skipped.
+//
+// There must only be a single writer thread and a single reader thread.
+//
+template <class T>
+class TripleBuffer {
+
+    // the shared index has the "new data" flag stored in bit 2
+    static constexpr unsigned INDEX_MASK = 0x3;
+    static constexpr unsigned DIRTY_BIT = 0x4;
+
+public:
+
+    TripleBuffer() :
+        mBuffers(),
+        mBack(0),
+        mShared(1),
+        mFront(2)
+    {
+    }
+
+    //
+    // Writer side. Access the back buffer for modification. The contents of
+    // the back buffer are unspecified after a publish, so the entire value
+    // should be rewritten before publishing again.
+    //
+    T& back() {
+        return mBuffers[mBack];
+    }
+
+    //
+    // Writer side. Makes the back buffer available to the reader.
+    //
+    void publish() {
+        auto prev = mShared.exchange(mBack | DIRTY_BIT, std::memory_order_acq_rel);
+        mBack = prev & INDEX_MASK;
+    }
+
+    //
+    // Writer side. Convenience method, copies value to the back buffer and
+    // publishes it.
+    //
+    void write(T const& value) {
+        back() = value;
+        publish();
+    }
+
+    //
+    // Reader side. Gets the most recently published value. The returned
+    // reference remains valid until the next call to read().
+    //
+    T const& read() {
+        if (mShared.load(std::memory_order_relaxed) & DIRTY_BIT) {
+            auto prev = mShared.exchange(mFront, std::memory_order_acq_rel);
+            mFront = prev & INDEX_MASK;
+        }
+        return mBuffers[mFront];
+    }
+
+    //
+    // Reader side. Returns true if a new value has been published since the
+    // last read.
+    //
+    bool hasUpdate() const {
+        return mShared.load(std::memory_order_relaxed) & DIRTY_BIT;
+    }
+
+private:
+
+    std::array<T, 3> mBuffers;
+
+    // index of the buffer owned by the writer
+    unsigned mBack;
+    // index of the buffer in transit, plus dirty flag
+    alignas(64) std::atomic_uint mShared;
+    // index of the buffer owned by the reader
+    alignas(64) unsigned mFront;
+
+};
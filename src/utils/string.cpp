@@ -10,3 +10,10 @@ QString tempoToString(float tempo) {
 QString speedToString(float speed) {
     return QCoreApplication::tr("%1 FPR").arg(speed, 0, 'f', 3);
 }
+
+QString durationToString(double seconds) {
+    auto const total = (int)seconds;
+    return QStringLiteral("%1:%2")
+        .arg(total / 60, 2, 10, QChar('0'))
+        .arg(total % 60, 2, 10, QChar('0'));
+}
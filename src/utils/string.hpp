@@ -20,3 +20,11 @@ QString tempoToString(float tempo);
 // ie 4.125f -> "4.125 FPR"
 //
 QString speedToString(float speed);
+
+//
+// Converts the given duration, in seconds, to a human readable string in
+// the form mm:ss, rounded down to the nearest second.
+//
+// ie 125.8 -> "02:05"
+//
+QString durationToString(double seconds);
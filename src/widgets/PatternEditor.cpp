@@ -235,6 +235,12 @@ void PatternEditor::focusInEvent(QFocusEvent *evt) {
 void PatternEditor::focusOutEvent(QFocusEvent *evt) {
     Q_UNUSED(evt)
     mGrid->setEditorFocus(false);
+
+    // we won't get the release events for any held keys
+    if (!mPreviewKeys.isEmpty()) {
+        mPreviewKeys.clear();
+        emit stopNotePreview(-1);
+    }
 }
 
 void PatternEditor::keyPressEvent(QKeyEvent *evt) {
@@ -302,8 +308,9 @@ void PatternEditor::keyPressEvent(QKeyEvent *evt) {
             
             if (note) {
                 if (*note != trackerboy::NOTE_CUT) {
-                    if (mPreviewKey != key) {
-                        mPreviewKey = key;
+                    if (!mPreviewKeys.contains(key)) {
+                        // each held key gets its own voice
+                        mPreviewKeys.insert(key, *note);
                         emit previewNote(*note, mModel.cursorTrack(), mInstrument.value_or(-1));
                     }
                 }
@@ -373,9 +380,13 @@ void PatternEditor::keyPressEvent(QKeyEvent *evt) {
 }
 
 void PatternEditor::keyReleaseEvent(QKeyEvent *evt) {
-    if (!evt->isAutoRepeat() && evt->key() == mPreviewKey) {
-        mPreviewKey = Qt::Key_unknown;
-        emit stopNotePreview();
+    if (!evt->isAutoRepeat()) {
+        auto iter = mPreviewKeys.find(evt->key());
+        if (iter != mPreviewKeys.end()) {
+            auto const note = *iter;
+            mPreviewKeys.erase(iter);
+            emit stopNotePreview(note);
+        }
     }
 }
 
@@ -429,6 +440,10 @@ void PatternEditor::setEditStep(int step) {
     mEditStep = step;
 }
 
+int PatternEditor::instrument() const {
+    return mInstrument ? (int)*mInstrument : -1;
+}
+
 void PatternEditor::setInstrument(int id) {
     if (id == -1) {
         mInstrument.reset();
@@ -572,18 +587,23 @@ void PatternEditor::setCursorFromHScroll(int value) {
 
 }
 
-void PatternEditor::midiNoteOn(int note) {
+void PatternEditor::midiNoteOn(int note, bool previewed) {
     if (mModel.isRecording()) {
         mModel.setNote((uint8_t)note, mInstrument);
         stepDown();
     }
 
-    emit previewNote(note, mModel.cursorTrack(), mInstrument.value_or(-1));
+    if (!previewed) {
+        emit previewNote(note, mModel.cursorTrack(), mInstrument.value_or(-1));
+    }
 
 }
 
-void PatternEditor::midiNoteOff() {
-    emit stopNotePreview();
+void PatternEditor::midiNoteOff(bool previewed) {
+    if (!previewed) {
+        // only the last note's off is received, stop everything
+        emit stopNotePreview(-1);
+    }
 }
 
 #undef TU
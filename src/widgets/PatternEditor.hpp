@@ -9,6 +9,7 @@
 #include "widgets/grid/PatternGridHeader.hpp"
 
 #include <QFrame>
+#include <QHash>
 #include <QScrollBar>
 
 #include <cstdint>
@@ -42,12 +43,17 @@ public:
 
     void setPageStep(int pageStep);
 
-    virtual void midiNoteOn(int note) override;
+    virtual void midiNoteOn(int note, bool previewed) override;
 
-    virtual void midiNoteOff() override;
+    virtual void midiNoteOff(bool previewed) override;
 
     void setEditStep(int step);
 
+    //
+    // Gets the instrument id used when entering notes, -1 for none.
+    //
+    int instrument() const;
+
     void setInstrument(int id);
 
     void setKeyRepeat(bool repeat);
@@ -88,7 +94,10 @@ public:
 signals:
     void previewNote(int note, int track, int instrument);
 
-    void stopNotePreview();
+    //
+    // Stops the preview of the given note, or all previews for -1
+    //
+    void stopNotePreview(int note);
 
 protected:
 
@@ -134,7 +143,8 @@ private:
     int mPageStep;
     int mEditStep;
 
-    int mPreviewKey;
+    // keys being held for a note preview, mapped to the note previewed
+    QHash<int, int> mPreviewKeys;
     
     bool mIgnoreCursorChanges;
 
@@ -122,13 +122,19 @@ void PianoWidget::release() {
     emit keyUp();
 }
 
-void PianoWidget::midiNoteOn(int note) {
+void PianoWidget::midiNoteOn(int note, bool previewed) {
+    // the sink does not preview notes for pianos, the preview is done by
+    // our keyDown signal
+    Q_UNUSED(previewed)
+
     if (isEnabled()) {
         play(note);
     }
 }
 
-void PianoWidget::midiNoteOff() {
+void PianoWidget::midiNoteOff(bool previewed) {
+    Q_UNUSED(previewed)
+
     if (isEnabled()) {
         release();
     }
@@ -25,9 +25,9 @@ public:
     void play(int note);
     void release();
 
-    virtual void midiNoteOn(int note) override;
+    virtual void midiNoteOn(int note, bool previewed) override;
 
-    virtual void midiNoteOff() override;
+    virtual void midiNoteOff(bool previewed) override;
 
 signals:
     void keyDown(int note);
@@ -10,6 +10,7 @@
 #include <QtDebug>
 
 #include <algorithm>
+#include <utility>
 
 
 // Philisophy note
@@ -44,6 +45,8 @@ PatternGrid::PatternGrid(
     mShowShadow(true),
     mSelecting(false),
     mVisibleRows(0),
+    mCursorRow(model.cursorRow()),
+    mRepaintAll(true),
     mEditorFocus(false),
     mMousePos(),
     mSelectionStart(),
@@ -63,6 +66,8 @@ PatternGrid::PatternGrid(
     // these changes require a full redraw
     connect(&model, &PatternModel::invalidated, this, &PatternGrid::updateAll);
     connect(&model, &PatternModel::selectionChanged, this, &PatternGrid::updateAll);
+    // edits to a few rows only need those rows redrawn
+    connect(&model, &PatternModel::rowsInvalidated, this, &PatternGrid::updatePatternRows);
     // these we only need to redraw the cursor row
     connect(&model, &PatternModel::recordingChanged, this, &PatternGrid::updateCursorRow);
     
@@ -93,6 +98,7 @@ PatternGrid::~PatternGrid() {
 
 void PatternGrid::setColors(Palette const& colors) {
     mPainter.setColors(colors);
+    mPainter.updateGlyphs(devicePixelRatio());
 
     // update palette so the background is automatically drawn
     auto pal = palette();
@@ -185,7 +191,8 @@ void PatternGrid::dropEvent(QDropEvent *evt) {
 }
 
 void PatternGrid::paintEvent(QPaintEvent *evt) {
-    Q_UNUSED(evt)
+
+    mRepaintAll = false;
 
     QPainter painter(this);
 
@@ -194,10 +201,17 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
     auto const rowHeight = mPainter.cellHeight();
     auto const centerRow = mVisibleRows / 2;
 
+    // only the rows intersecting the dirty rectangle need to be drawn
+    auto const dirty = evt->rect();
+    auto const firstRow = std::max(0, dirty.top() / rowHeight);
+    auto const lastRow = std::min(mVisibleRows - 1, dirty.bottom() / rowHeight);
+
     auto const cursor = mModel.cursor();
-    auto patternPrev = mModel.previousPattern();
-    auto patternCurr = mModel.currentPattern();
-    auto patternNext = mModel.nextPattern();
+    auto const patternId = mModel.cursorPattern();
+    // read the model's patterns directly, no copies
+    auto const patternPrev = std::as_const(mModel).previousPattern();
+    auto const& patternCurr = std::as_const(mModel).currentPattern();
+    auto const patternNext = std::as_const(mModel).nextPattern();
     auto const rowsInPrevious = patternPrev ? patternPrev->totalRows() : 0;
     auto const rowsInCurrent = patternCurr.totalRows();
     auto const rowsInNext = patternNext ? patternNext->totalRows() : 0;
@@ -213,9 +227,9 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
 
     // [2] row background
     {
-        int rowsToDraw = mVisibleRows;
-        int relativeRowIndex = cursor.row - centerRow;
-        int ypos = 0;
+        int rowsToDraw = lastRow - firstRow + 1;
+        int relativeRowIndex = cursor.row - centerRow + firstRow;
+        int ypos = firstRow * rowHeight;
         int rowMin = -rowsInPrevious;
         int rowMax = rowsInCurrent + rowsInNext;
 
@@ -253,50 +267,52 @@ void PatternGrid::paintEvent(QPaintEvent *evt) {
 
     // [6] text
     {
-        int rowYpos = 0;
-        int rowsToDraw = mVisibleRows;
-        int relativeRowIndex = cursor.row - centerRow;
+        int rowYpos = firstRow * rowHeight;
+        int rowsToDraw = lastRow - firstRow + 1;
+        int relativeRowIndex = cursor.row - centerRow + firstRow;
 
         if (relativeRowIndex < 0) {
             // a negative row index means we draw from the previous pattern
+            int const rowsBefore = std::min(-relativeRowIndex, rowsToDraw);
             if (patternPrev) {
-                int rowno;
-                int rowIndexToPrev = relativeRowIndex + rowsInPrevious;
-                if (rowIndexToPrev < 0) {
+                int rowno = relativeRowIndex + rowsInPrevious;
+                int const rowEnd = rowno + rowsBefore - 1;
+                int ypos = rowYpos;
+                if (rowno < 0) {
                     // clamp
-                    rowYpos += -rowIndexToPrev * rowHeight;
+                    ypos += -rowno * rowHeight;
                     rowno = 0;
-                } else {
-                    rowno = rowIndexToPrev;
                 }
-                painter.setOpacity(0.5);
-                rowYpos = mPainter.drawPattern(painter, mLayout, *patternPrev, rowno, rowsInPrevious - 1, rowYpos);
-                painter.setOpacity(1.0);
-            } else {
-                // previews disabled or we don't have a previous pattern, just skip these rows
-                rowYpos += -relativeRowIndex * rowHeight;
+                if (rowno <= rowEnd) {
+                    painter.setOpacity(0.5);
+                    mPainter.drawPattern(painter, mLayout, *patternPrev, rowno, rowEnd, ypos, patternId - 1);
+                    painter.setOpacity(1.0);
+                }
             }
+            // previews disabled or we don't have a previous pattern, just skip these rows
 
-            rowsToDraw += relativeRowIndex;
+            rowYpos += rowsBefore * rowHeight;
+            rowsToDraw -= rowsBefore;
             relativeRowIndex = 0;
         }
 
         // draw the current pattern
-        int rowEnd = relativeRowIndex + rowsToDraw;
-        if (rowEnd >= rowsInCurrent) {
-            rowEnd = rowsInCurrent - 1;
+        if (rowsToDraw > 0 && relativeRowIndex < rowsInCurrent) {
+            int const rowEnd = std::min(relativeRowIndex + rowsToDraw, rowsInCurrent) - 1;
+            rowYpos = mPainter.drawPattern(painter, mLayout, patternCurr, relativeRowIndex, rowEnd, rowYpos, patternId);
+            rowsToDraw -= rowEnd - relativeRowIndex + 1;
+            relativeRowIndex = rowsInCurrent;
         }
-        rowYpos = mPainter.drawPattern(painter, mLayout, patternCurr, relativeRowIndex, rowEnd, rowYpos);
-        rowsToDraw -= rowEnd - relativeRowIndex;
 
         if (rowsToDraw > 0 && patternNext) {
             // we have extra rows and a next pattern, draw it
-            if (rowsToDraw > rowsInNext) {
-                rowsToDraw = rowsInNext;
+            int const rowno = relativeRowIndex - rowsInCurrent;
+            int const rowEnd = std::min(rowno + rowsToDraw, rowsInNext) - 1;
+            if (rowno <= rowEnd) {
+                painter.setOpacity(0.5);
+                mPainter.drawPattern(painter, mLayout, *patternNext, rowno, rowEnd, rowYpos, patternId + 1);
+                painter.setOpacity(1.0);
             }
-            painter.setOpacity(0.5);
-            mPainter.drawPattern(painter, mLayout, *patternNext, 0, rowsToDraw - 1, rowYpos);
-            painter.setOpacity(1.0);
         }
     }
 
@@ -462,9 +478,21 @@ void PatternGrid::mouseReleaseEvent(QMouseEvent *evt) {
 
 void PatternGrid::updateCursor(PatternModel::CursorChangeFlags flags) {
 
-    if (flags | (PatternModel::CursorRowChanged | PatternModel::CursorTrackChanged)) {
-        updateAll();
+    if (flags & PatternModel::CursorRowChanged) {
+        auto const cursorRow = mModel.cursorRow();
+        auto const rows = cursorRow - mCursorRow;
+        mCursorRow = cursorRow;
+
+        if (mRepaintAll || mHasDrag || rows >= mVisibleRows || -rows >= mVisibleRows) {
+            // everything changes anyways
+            mRepaintAll = true;
+            update();
+        } else if (rows != 0) {
+            scrollRows(rows);
+        }
+        calculateTrackerRow();
     } else {
+        // the cursor is only drawn in the center row
         updateCursorRow();
     }
 }
@@ -475,7 +503,71 @@ void PatternGrid::updateCursorRow() {
     update(rect);
 }
 
+void PatternGrid::updateRows(int first, int last) {
+    first = std::max(first, 0);
+    last = std::min(last, mVisibleRows - 1);
+    if (first <= last) {
+        auto const rowHeight = mPainter.cellHeight();
+        update(0, first * rowHeight, width(), (last - first + 1) * rowHeight);
+    }
+}
+
+void PatternGrid::updatePatternRows(int pattern, int rowStart, int rowEnd) {
+    mPainter.invalidateRows(pattern, rowStart, rowEnd);
+    auto const first = patternRowToGridRow(pattern, rowStart);
+    if (first) {
+        updateRows(*first, *first + rowEnd - rowStart);
+    }
+}
+
+void PatternGrid::scrollRows(int rows) {
+    auto const rowHeight = mPainter.cellHeight();
+    auto const centerRow = mVisibleRows / 2;
+
+    // the pixels for the old cursor row will be moved by the scroll, as will
+    // the player row. Qt repaints the exposed area for us
+    scroll(0, -rows * rowHeight);
+
+    // the cursor row background and cursor stay in the center
+    updateRows(centerRow, centerRow);
+    updateRows(centerRow - rows, centerRow - rows);
+
+    if (mTrackerRow) {
+        // the player row scrolled along with the pattern, calculateTrackerRow
+        // will repaint it if it actually moved
+        mTrackerRow = *mTrackerRow - rows;
+    }
+
+    if (mShowShadow) {
+        // the header shadow got scrolled too
+        auto const w = width();
+        update(0, 0, w, SHADOW_HEIGHT);
+        if (rows < 0) {
+            update(0, -rows * rowHeight, w, SHADOW_HEIGHT);
+        }
+    }
+}
+
+std::optional<int> PatternGrid::patternRowToGridRow(int pattern, int row) const {
+    auto const offset = mVisibleRows / 2 - mModel.cursorRow();
+    auto const currentPattern = mModel.cursorPattern();
+
+    if (pattern == currentPattern) {
+        return row + offset;
+    } else if (pattern == currentPattern - 1) {
+        auto patternPrev = mModel.previousPattern();
+        if (patternPrev) {
+            return offset - (patternPrev->totalRows() - row);
+        }
+    } else if (pattern == currentPattern + 1 && mModel.nextPattern()) {
+        return offset + mModel.currentPattern().totalRows() + row;
+    }
+    return std::nullopt;
+}
+
 void PatternGrid::updateAll() {
+    mRepaintAll = true;
+    mCursorRow = mModel.cursorRow();
     calculateTrackerRow();
     update();
 }
@@ -483,8 +575,8 @@ void PatternGrid::updateAll() {
 void PatternGrid::setPlaying(bool playing) {
     if (!playing && mTrackerRow) {
         // this just hides the player row if it was set
+        updateRows(*mTrackerRow, *mTrackerRow);
         mTrackerRow.reset();
-        update();
     }
 }
 
@@ -502,6 +594,7 @@ void PatternGrid::fontChanged() {
 
     mVisibleRows = mPainter.calculateRowsAvailable(height());
     mLayout.setCellSize(mPainter.cellWidth(), mPainter.cellHeight());
+    mPainter.updateGlyphs(devicePixelRatio());
     //auto const rownoWidth = mPainter.rownoWidth();
     //auto const trackWidth = mPainter.trackWidth();
     //mHeader.setWidths(rownoWidth, trackWidth);
@@ -533,35 +626,24 @@ void PatternGrid::clampCursor(PatternCursor &cursor) {
 }
 
 void PatternGrid::calculateTrackerRow() {
-    
-    if (!mModel.isFollowing() && mModel.isPlaying()) {
 
-        auto patternPrev = mModel.previousPattern();
-        auto patternNext = mModel.nextPattern();
-        auto const cursorRow = mModel.cursorRow();
-        int const centerRow = mVisibleRows / 2;
-        auto const trackerRowCursor = mModel.trackerCursorRow();
-        auto const trackerPattern = mModel.trackerCursorPattern();
-        auto const currentPattern = mModel.cursorPattern();
-        int trackerRow = -1;
-        if (currentPattern == trackerPattern) {
-            trackerRow = trackerRowCursor - (cursorRow - centerRow);
-        } else if (patternPrev && trackerPattern == currentPattern - 1) {
-            trackerRow = (centerRow - cursorRow) - (patternPrev->totalRows() - trackerRowCursor);
-        } else if (patternNext && trackerPattern == currentPattern + 1) {
-            trackerRow = (centerRow - cursorRow) + patternNext->totalRows() + trackerRowCursor;
+    std::optional<int> trackerRow;
+    if (!mModel.isFollowing() && mModel.isPlaying()) {
+        auto const row = patternRowToGridRow(mModel.trackerCursorPattern(), mModel.trackerCursorRow());
+        if (row && *row >= 0 && *row < mVisibleRows && *row != mVisibleRows / 2) {
+            trackerRow = row;
         }
+    }
 
-        if (trackerRow > 0 && trackerRow < mVisibleRows && trackerRow != centerRow) {
-            mTrackerRow = trackerRow;
-            update();
-            return;
+    if (trackerRow != mTrackerRow) {
+        // only the old and new player rows need to be redrawn
+        if (mTrackerRow) {
+            updateRows(*mTrackerRow, *mTrackerRow);
         }
-    } 
-
-    if (mTrackerRow) {
-        mTrackerRow.reset();
-        update();
+        if (trackerRow) {
+            updateRows(*trackerRow, *trackerRow);
+        }
+        mTrackerRow = trackerRow;
     }
 
 }
@@ -94,6 +94,29 @@ private:
 
     void updateCursor(PatternModel::CursorChangeFlags flags);
 
+    //
+    // Schedules a repaint for the given range of widget rows, inclusive.
+    // Rows outside the widget are ignored.
+    //
+    void updateRows(int first, int last);
+
+    //
+    // Schedules a repaint for the given rows in a pattern, if visible.
+    //
+    void updatePatternRows(int pattern, int rowStart, int rowEnd);
+
+    //
+    // Scrolls the widget contents by the given number of rows, only the rows
+    // that were exposed or have a different highlight get repainted.
+    //
+    void scrollRows(int rows);
+
+    //
+    // Converts a row in the given pattern to a row on the widget. An empty
+    // optional is returned if the pattern is not displayed.
+    //
+    std::optional<int> patternRowToGridRow(int pattern, int row) const;
+
     //
     // Called when appearance settings have changed, recalculates metrics and redraws
     // all rows.
@@ -126,11 +149,21 @@ private:
     // saved here so we don't have to calculate it every paint event
     std::optional<int> mTrackerRow;
 
+    // the cursor row that is drawn in the center row, used to determine how
+    // much to scroll when the cursor moves
+    int mCursorRow;
+
+    // set when a full repaint is pending, scrolling is pointless until then
+    bool mRepaintAll;
+
     bool mEditorFocus;
 
     // user must move this amount of pixels to begin selecting
     static constexpr auto SELECTION_DEAD_ZONE = 4;
 
+    // height, in pixels, of the shadow drawn under the header
+    static constexpr auto SHADOW_HEIGHT = 3;
+
     enum class MouseOperation {
         nothing,            // do nothing
         selectingRows,      // selecting whole rows
@@ -1,21 +1,34 @@
-
 #include "widgets/sidebar/AudioScope.hpp"
+#include "widgets/sidebar/ScopeRasterizer.hpp"
 
 #include <QGuiApplication>
 #include <QPainter>
-#include <QPen>
+#include <QResizeEvent>
+#include <QScreen>
+
+#include <algorithm>
+#include <cmath>
 
 #define TU AudioScopeTU
 namespace TU {
 
 constexpr int LINE_WIDTH = 1;
 
+// used when the refresh rate of the screen is unknown
+constexpr qreal DEFAULT_REFRESH_RATE = 60.0;
+
 }
 
 AudioScope::AudioScope(QWidget *parent) :
     QFrame(parent),
-    mBuffer(nullptr),
-    mLineColor(Qt::white)
+    mSource(nullptr),
+    mLineColor(Qt::white),
+    mRasterThread(),
+    mRasterizer(new ScopeRasterizer),
+    mFrameTimer(),
+    mDirty(false),
+    mPending(false),
+    mImage()
 {
     setAttribute(Qt::WA_StyledBackground);
     setAutoFillBackground(true);
@@ -34,12 +47,29 @@ AudioScope::AudioScope(QWidget *parent) :
     setLineWidth(TU::LINE_WIDTH);
     setFixedHeight(WAVE_HEIGHT * 2 + TU::LINE_WIDTH * 2);
 
+    mRasterizer->moveToThread(&mRasterThread);
+    connect(&mRasterThread, &QThread::finished, mRasterizer, &ScopeRasterizer::deleteLater);
+    connect(mRasterizer, &ScopeRasterizer::finished, this, &AudioScope::rasterFinished);
+    mRasterThread.setObjectName(QStringLiteral("scope raster thread"));
+    mRasterThread.start();
+
+    mFrameTimer.setTimerType(Qt::PreciseTimer);
+    connect(&mFrameTimer, &QTimer::timeout, this, &AudioScope::onFrameTimeout);
+
+}
+
+AudioScope::~AudioScope() {
+    mRasterThread.quit();
+    mRasterThread.wait();
 }
 
-void AudioScope::setBuffer(Guarded<VisualizerBuffer> *buffer) {
-    if (buffer != mBuffer) {
-        mBuffer = buffer;
-        update();
+void AudioScope::setSource(TripleBuffer<VisualizerBuffer::Snapshot> *source) {
+    if (source != mSource) {
+        mSource = source;
+        QMetaObject::invokeMethod(mRasterizer, [rasterizer = mRasterizer, source]() {
+            rasterizer->setSource(source);
+        });
+        scheduleFrame();
     }
 }
 
@@ -50,78 +80,74 @@ void AudioScope::setColors(Palette const& pal) {
 
     mLineColor = pal[Palette::ColorScopeLine];
 
-    update();
+    scheduleFrame();
 }
 
-void AudioScope::paintEvent(QPaintEvent *evt) {
-    QFrame::paintEvent(evt);
-
-    // it may be more efficient to do renderering in a separate thread
-    // we can convert a sample buffer to a buffer of QLines, then
-    // the paint event just draws the lines
+int AudioScope::columns() const {
+    return std::max(0, width() - (TU::LINE_WIDTH * 2));
+}
 
-    if (mBuffer == nullptr) {
-        // no buffer, draw nothing
-        drawSilence();
-        return;
+void AudioScope::scheduleFrame() {
+    mDirty = true;
+    if (!mFrameTimer.isActive()) {
+        auto rate = TU::DEFAULT_REFRESH_RATE;
+        if (auto scr = screen(); scr && scr->refreshRate() > 0.0) {
+            rate = scr->refreshRate();
+        }
+        mFrameTimer.start(std::max(1, (int)std::lround(1000.0 / rate)));
+        // draw the first frame right away instead of waiting for the timer
+        onFrameTimeout();
     }
+}
 
-    auto handle = mBuffer->access();
-    auto size = handle->size();
-    if (size == 0) {
-        // buffer is empty, draw nothing
-        drawSilence();
+void AudioScope::onFrameTimeout() {
+    if (mPending) {
+        // still drawing the last one, try again next refresh
         return;
     }
 
-    auto const w = width() - (TU::LINE_WIDTH * 2);
-    
-    QPainter painter(this);
-    painter.setRenderHint(QPainter::Antialiasing);
-    painter.setPen(mLineColor);
-
-    // pixels per sample
-    float ratio = (unsigned)size / (float)w;
-    float index = 0;
-
-    float prevLeft;
-    float prevRight;
-    sample(handle, 0.0f, ratio, prevLeft, prevRight);
-
-    int const end = w + TU::LINE_WIDTH;
-    for (int t = 1 + TU::LINE_WIDTH; t < end; ++t) {
-        index += ratio;
-        
-        float leftSample;
-        float rightSample;
-        sample(handle, index, ratio, leftSample, rightSample);
-
-        painter.drawLine(QLineF(t - 1, prevLeft, t, leftSample));
-        painter.drawLine(QLineF(t - 1, prevRight, t, rightSample));
-
-        prevLeft = leftSample;
-        prevRight = rightSample;
-
-        
+    if (mDirty) {
+        mDirty = false;
+        requestRaster();
+    } else {
+        // no new snapshots since the last frame, idle until there are
+        mFrameTimer.stop();
     }
-    
 }
 
-void AudioScope::drawSilence() {
-    QPainter painter(this);
-    painter.setPen(palette().color(QPalette::WindowText));
-    auto const x2 = width() - TU::LINE_WIDTH;
-    painter.drawLine(TU::LINE_WIDTH, WAVE_LEFT_AXIS, x2, WAVE_LEFT_AXIS);
-    painter.drawLine(TU::LINE_WIDTH, WAVE_RIGHT_AXIS, x2, WAVE_RIGHT_AXIS);
+void AudioScope::requestRaster() {
+    ScopeRasterizer::Params params;
+    params.size = size();
+    params.border = TU::LINE_WIDTH;
+    params.line = mLineColor;
+    params.silence = palette().color(QPalette::WindowText);
+
+    mPending = true;
+    QMetaObject::invokeMethod(mRasterizer, [rasterizer = mRasterizer, params]() {
+        rasterizer->rasterize(params);
+    });
+}
 
+void AudioScope::rasterFinished(QImage const& image) {
+    mPending = false;
+    mImage = image;
+    update();
 }
 
-void AudioScope::sample(Locked<VisualizerBuffer> &handle, float index, float ratio, float &outLeft, float &outRight) {
-    float left, right;
-    handle->averageSample(index, ratio, left, right);
+void AudioScope::paintEvent(QPaintEvent *evt) {
+    QFrame::paintEvent(evt);
+
+    // a stale image is skipped while resizing, a new one is on the way
+    if (!mImage.isNull() && mImage.size() == size()) {
+        QPainter painter(this);
+        painter.drawImage(0, 0, mImage);
+    }
+}
 
-    outLeft = WAVE_LEFT_AXIS - (left / (2.0f / WAVE_HEIGHT));
-    outRight = WAVE_RIGHT_AXIS - (right / (2.0f / WAVE_HEIGHT));
+void AudioScope::resizeEvent(QResizeEvent *evt) {
+    QFrame::resizeEvent(evt);
+    emit columnsChanged(columns());
+    scheduleFrame();
 }
 
 #undef TU
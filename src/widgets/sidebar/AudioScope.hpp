@@ -1,14 +1,21 @@
-
 #pragma once
 
 
 #include "audio/VisualizerBuffer.hpp"
 #include "config/data/Palette.hpp"
-#include "utils/Guarded.hpp"
+#include "utils/TripleBuffer.hpp"
 
 #include <QFrame>
+#include <QImage>
+#include <QThread>
+#include <QTimer>
 
+class ScopeRasterizer;
 
+//
+// Oscilloscope widget. The trace is drawn by a ScopeRasterizer on a worker
+// thread, and updates are limited to the screen's refresh rate.
+//
 class AudioScope : public QFrame {
 
     Q_OBJECT
@@ -17,33 +24,64 @@ class AudioScope : public QFrame {
 public:
 
     explicit AudioScope(QWidget *parent = nullptr);
+    ~AudioScope();
 
 
-    void setBuffer(Guarded<VisualizerBuffer>* buffer);
+    //
+    // Sets the source of snapshots to draw. The scope must be the only reader
+    // of the source.
+    //
+    void setSource(TripleBuffer<VisualizerBuffer::Snapshot> *source);
 
     void setColors(Palette const& pal);
 
+    //
+    // Number of envelope columns needed to fill the scope.
+    //
+    int columns() const;
+
+    //
+    // Requests a redraw for a new snapshot. Requests are coalesced, so this
+    // can be called far more often than the screen refreshes.
+    //
+    void scheduleFrame();
+
+signals:
+
+    void columnsChanged(int columns);
+
 protected:
 
     void paintEvent(QPaintEvent *evt) override;
 
+    void resizeEvent(QResizeEvent *evt) override;
+
 private:
     Q_DISABLE_COPY(AudioScope)
 
-    void drawSilence();
+    void onFrameTimeout();
 
-    void sample(Locked<VisualizerBuffer> &handle, float index, float ratio, float &outLeft, float &outRight);
+    void requestRaster();
 
-    static constexpr int WAVE_WIDTH = 160;
-    static constexpr int WAVE_HEIGHT = 64;
-    static constexpr int WAVE_AXIS = WAVE_HEIGHT / 2 - 1;
+    void rasterFinished(QImage const& image);
 
-    static constexpr int WAVE_LEFT_AXIS = (WAVE_HEIGHT / 2) + 1;
-    static constexpr int WAVE_RIGHT_AXIS = (WAVE_HEIGHT / 2) + WAVE_HEIGHT + 1;
+    static constexpr int WAVE_HEIGHT = 64;
 
-    Guarded<VisualizerBuffer> *mBuffer;
+    TripleBuffer<VisualizerBuffer::Snapshot> *mSource;
 
     QColor mLineColor;
 
+    QThread mRasterThread;
+    ScopeRasterizer *mRasterizer;
+
+    // fires at the screen's refresh rate while snapshots are arriving
+    QTimer mFrameTimer;
+    // a new snapshot is available
+    bool mDirty;
+    // the rasterizer is working on an image
+    bool mPending;
+
+    QImage mImage;
+
 
 };
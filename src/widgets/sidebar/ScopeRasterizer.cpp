@@ -0,0 +1,79 @@
+
+#include "widgets/sidebar/ScopeRasterizer.hpp"
+
+#include <QLineF>
+#include <QPainter>
+
+#include <algorithm>
+
+ScopeRasterizer::ScopeRasterizer(QObject *parent) :
+    QObject(parent),
+    mSource(nullptr)
+{
+}
+
+void ScopeRasterizer::setSource(TripleBuffer<VisualizerBuffer::Snapshot> *source) {
+    mSource = source;
+}
+
+void ScopeRasterizer::rasterize(Params const& params) {
+    QImage image(params.size, QImage::Format_ARGB32_Premultiplied);
+    // transparent, the widget fills its own background
+    image.fill(Qt::transparent);
+
+    // each channel gets half of the height inside the frame
+    auto const waveHeight = (params.size.height() - params.border * 2) / 2;
+    auto const leftAxis = params.border + waveHeight / 2;
+    auto const rightAxis = leftAxis + waveHeight;
+    auto const columns = params.size.width() - params.border * 2;
+
+    QPainter painter(&image);
+
+    auto const envelope = mSource ? &mSource->read().envelope : nullptr;
+    if (envelope == nullptr || envelope->width() == 0 || columns <= 0) {
+        // nothing to draw, just the axes
+        painter.setPen(params.silence);
+        auto const x2 = params.size.width() - params.border;
+        painter.drawLine(params.border, leftAxis, x2, leftAxis);
+        painter.drawLine(params.border, rightAxis, x2, rightAxis);
+        painter.end();
+        emit finished(image);
+        return;
+    }
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(params.line);
+
+    // the envelope may be for an older width while the scope is resized
+    auto const w = std::min(envelope->width(), columns);
+    auto const scale = waveHeight / 2.0f;
+
+    // converts a sample to a y coordinate
+    auto toY = [scale](int axis, float sample) {
+        return axis - (sample * scale);
+    };
+
+    auto drawChannel = [&](VisualizerBuffer::Envelope::Channel const& channel, int axis) {
+        auto prev = toY(axis, channel.avg[0]);
+        for (int col = 1; col < w; ++col) {
+            auto const x = col + params.border;
+            auto const y = toY(axis, channel.avg[col]);
+            painter.drawLine(QLineF(x - 1, prev, x, y));
+
+            // show peaks that the average hides (ie a transition in the
+            // middle of a column)
+            auto const top = toY(axis, channel.max[col]);
+            auto const bottom = toY(axis, channel.min[col]);
+            if (bottom - top > 1.0f) {
+                painter.drawLine(QLineF(x, top, x, bottom));
+            }
+            prev = y;
+        }
+    };
+
+    drawChannel(envelope->left(), leftAxis);
+    drawChannel(envelope->right(), rightAxis);
+
+    painter.end();
+    emit finished(image);
+}
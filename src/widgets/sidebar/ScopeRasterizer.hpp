@@ -0,0 +1,51 @@
+#pragma once
+
+#include "audio/VisualizerBuffer.hpp"
+#include "utils/TripleBuffer.hpp"
+
+#include <QColor>
+#include <QImage>
+#include <QObject>
+#include <QSize>
+
+//
+// Draws the scope trace into an image. This object lives on a worker thread
+// so that the scope widget only has to draw the resulting image.
+//
+class ScopeRasterizer : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    struct Params {
+        QSize size;         // size of the image, same as the scope widget
+        int border = 0;     // width of the widget's frame
+        QColor line;        // trace color
+        QColor silence;     // color of the axes when there is no trace
+    };
+
+    explicit ScopeRasterizer(QObject *parent = nullptr);
+
+    //
+    // Sets the source of snapshots. The rasterizer becomes the only reader of
+    // the source. Must be called from the rasterizer's thread.
+    //
+    void setSource(TripleBuffer<VisualizerBuffer::Snapshot> *source);
+
+    //
+    // Draws the latest snapshot and emits finished. Must be called from the
+    // rasterizer's thread.
+    //
+    void rasterize(Params const& params);
+
+signals:
+
+    void finished(QImage image);
+
+private:
+    Q_DISABLE_COPY(ScopeRasterizer)
+
+    TripleBuffer<VisualizerBuffer::Snapshot> *mSource;
+
+};
@@ -0,0 +1,98 @@
+#include "units/TestModuleMetadata.hpp"
+
+#include "core/ModuleMetadata.hpp"
+
+#include "trackerboy/data/Module.hpp"
+
+#include <sstream>
+#include <string>
+
+#define TU TestModuleMetadataTU
+namespace TU {
+
+//
+// Serializes a module with libtrackerboy and returns the start of the file,
+// so that the test fails if the header layout drifts from libtrackerboy's.
+//
+static std::string makeHeader() {
+    trackerboy::Module mod;
+    mod.setTitle(std::string("Title"));
+    // full length strings are not nul terminated
+    mod.setArtist(std::string(32, 'A'));
+    mod.setCopyright(std::string("2022"));
+    for (int i = 0; i < 24; ++i) {
+        mod.instrumentTable().insert();
+    }
+    for (int i = 0; i < 17; ++i) {
+        mod.waveformTable().insert();
+    }
+    // a module always has 1 song
+    for (int i = 0; i < 4; ++i) {
+        mod.songs().append();
+    }
+    mod.setFramerate(300);
+
+    std::ostringstream out(std::ios::binary | std::ios::out);
+    if (mod.serialize(out) != trackerboy::FormatError::none) {
+        return {};
+    }
+    auto header = out.str();
+    header.resize(ModuleMetadata::HEADER_SIZE);
+    return header;
+}
+
+// offsets of fields modified by the tests, the other fields are only checked
+// through libtrackerboy
+constexpr int OFFSET_SIGNATURE = 0;
+constexpr int OFFSET_REV_MAJOR = 24;
+
+}
+
+
+TestModuleMetadata::TestModuleMetadata() {
+
+}
+
+void TestModuleMetadata::parse() {
+    auto const header = TU::makeHeader();
+    QCOMPARE((int)header.size(), ModuleMetadata::HEADER_SIZE);
+
+    ModuleMetadata metadata;
+    QVERIFY(metadata.parse(header.data()));
+    QCOMPARE(metadata.error, ModuleMetadata::Error::none);
+    QCOMPARE(metadata.revisionMajor, ModuleMetadata::SUPPORTED_REVISION);
+    QCOMPARE(metadata.title, QStringLiteral("Title"));
+    QCOMPARE(metadata.artist, QString(32, QChar('A')));
+    QCOMPARE(metadata.copyright, QStringLiteral("2022"));
+    QCOMPARE(metadata.instrumentCount, 24);
+    QCOMPARE(metadata.songCount, 5);
+    QCOMPARE(metadata.waveCount, 17);
+    QCOMPARE(metadata.system, trackerboy::System::custom);
+    QCOMPARE(metadata.customFramerate, 300);
+    QCOMPARE(metadata.framerate(), 300.0f);
+}
+
+void TestModuleMetadata::invalidSignature() {
+    auto header = TU::makeHeader();
+    header[TU::OFFSET_SIGNATURE + 1] = 't';
+
+    ModuleMetadata metadata;
+    QVERIFY(!metadata.parse(header.data()));
+    QCOMPARE(metadata.error, ModuleMetadata::Error::notModule);
+}
+
+void TestModuleMetadata::unsupportedRevision() {
+    auto header = TU::makeHeader();
+    header[TU::OFFSET_REV_MAJOR] = 0;
+
+    ModuleMetadata metadata;
+    QVERIFY(!metadata.parse(header.data()));
+    QCOMPARE(metadata.error, ModuleMetadata::Error::unsupportedRevision);
+
+    header[TU::OFFSET_REV_MAJOR] = 2;
+    QVERIFY(!metadata.parse(header.data()));
+    QCOMPARE(metadata.error, ModuleMetadata::Error::unsupportedRevision);
+    QCOMPARE(metadata.revisionMajor, 2);
+}
+
+#undef TU
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestModuleMetadata : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestModuleMetadata();
+
+private slots:
+
+    void parse();
+
+    void invalidSignature();
+
+    void unsupportedRevision();
+
+};
@@ -0,0 +1,85 @@
+
+#include "units/TestSpscQueue.hpp"
+
+#include "utils/SpscQueue.hpp"
+
+#include <memory>
+#include <thread>
+
+
+TestSpscQueue::TestSpscQueue() {
+
+}
+
+void TestSpscQueue::emptyQueue() {
+    SpscQueue<int, 4> queue;
+    QVERIFY(queue.isEmpty());
+
+    int item = 42;
+    QVERIFY(!queue.pop(item));
+    // item must be untouched when the queue is empty
+    QCOMPARE(item, 42);
+}
+
+void TestSpscQueue::fifoOrder() {
+    SpscQueue<int, 8> queue;
+    for (int i = 0; i < 5; ++i) {
+        QVERIFY(queue.push(i));
+    }
+    QVERIFY(!queue.isEmpty());
+
+    for (int i = 0; i < 5; ++i) {
+        int item;
+        QVERIFY(queue.pop(item));
+        QCOMPARE(item, i);
+    }
+    QVERIFY(queue.isEmpty());
+}
+
+void TestSpscQueue::capacity() {
+    // one slot is reserved, so a queue of 4 can only hold 3 items
+    SpscQueue<std::shared_ptr<int>, 4> queue;
+    auto ptr = std::make_shared<int>(1);
+
+    QVERIFY(queue.push(ptr));
+    QVERIFY(queue.push(ptr));
+    QVERIFY(queue.push(ptr));
+    QVERIFY(!queue.push(ptr));
+    QCOMPARE(ptr.use_count(), 4);
+
+    std::shared_ptr<int> item;
+    while (queue.pop(item)) {
+        item.reset();
+    }
+    // the queue must not keep references to popped items
+    QCOMPARE(ptr.use_count(), 1);
+}
+
+void TestSpscQueue::concurrent() {
+    constexpr int COUNT = 100000;
+    SpscQueue<int, 64> queue;
+
+    std::thread producer([&queue]() {
+        for (int i = 0; i < COUNT; ) {
+            if (queue.push(i)) {
+                ++i;
+            }
+        }
+    });
+
+    bool inOrder = true;
+    int expected = 0;
+    while (expected < COUNT) {
+        int item;
+        if (queue.pop(item)) {
+            if (item != expected) {
+                inOrder = false;
+            }
+            ++expected;
+        }
+    }
+    producer.join();
+
+    QVERIFY(inOrder);
+    QVERIFY(queue.isEmpty());
+}
@@ -0,0 +1,24 @@
+
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestSpscQueue : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestSpscQueue();
+
+private slots:
+
+    void emptyQueue();
+
+    void fifoOrder();
+
+    void capacity();
+
+    void concurrent();
+
+};
@@ -0,0 +1,62 @@
+
+#include "units/TestTripleBuffer.hpp"
+
+#include "utils/TripleBuffer.hpp"
+
+#include <thread>
+#include <utility>
+
+
+TestTripleBuffer::TestTripleBuffer() {
+
+}
+
+void TestTripleBuffer::latestValue() {
+    TripleBuffer<int> buffer;
+    QVERIFY(!buffer.hasUpdate());
+
+    buffer.write(1);
+    QVERIFY(buffer.hasUpdate());
+    QCOMPARE(buffer.read(), 1);
+    QVERIFY(!buffer.hasUpdate());
+    // reading again without a publish gives the same value
+    QCOMPARE(buffer.read(), 1);
+
+    // intermediate values are skipped
+    buffer.write(2);
+    buffer.write(3);
+    buffer.write(4);
+    QCOMPARE(buffer.read(), 4);
+}
+
+void TestTripleBuffer::concurrent() {
+    constexpr int COUNT = 100000;
+
+    // the writer always writes a pair of (n, -n), a torn read would show
+    // a mismatched pair
+    TripleBuffer<std::pair<int, int>> buffer;
+    std::thread writer([&buffer]() {
+        for (int i = 1; i <= COUNT; ++i) {
+            buffer.back() = { i, -i };
+            buffer.publish();
+        }
+    });
+
+    bool consistent = true;
+    bool monotonic = true;
+    int last = 0;
+    while (last != COUNT) {
+        auto const value = buffer.read();
+        if (value.first != -value.second) {
+            consistent = false;
+        }
+        if (value.first < last) {
+            monotonic = false;
+        }
+        last = value.first;
+    }
+    writer.join();
+
+    QVERIFY(consistent);
+    QVERIFY(monotonic);
+}
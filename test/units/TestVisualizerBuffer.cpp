@@ -0,0 +1,81 @@
+
+#include "units/TestVisualizerBuffer.hpp"
+
+#include "audio/VisualizerBuffer.hpp"
+
+#include <QRandomGenerator>
+
+#include <algorithm>
+#include <vector>
+
+
+TestVisualizerBuffer::TestVisualizerBuffer() {
+
+}
+
+void TestVisualizerBuffer::envelope_data() {
+    QTest::addColumn<int>("size");
+    QTest::addColumn<int>("width");
+
+    QTest::newRow("fewer columns") << 735 << 160;
+    QTest::newRow("more columns") << 100 << 160;
+    QTest::newRow("single column") << 735 << 1;
+    QTest::newRow("odd sizes") << 37 << 5;
+}
+
+void TestVisualizerBuffer::envelope() {
+    QFETCH(int, size);
+    QFETCH(int, width);
+
+    VisualizerBuffer buffer;
+    buffer.resize(size);
+
+    // write more than the buffer's size so that the buffer has wrapped
+    auto const amount = size + size / 3;
+    std::vector<float> samples(amount * 2);
+    for (auto &sample : samples) {
+        sample = (float)QRandomGenerator::global()->bounded(2.0) - 1.0f;
+    }
+    buffer.beginWrite(amount);
+    buffer.write(samples.data(), amount);
+
+    VisualizerBuffer::Envelope env;
+    buffer.envelope(width, env);
+    QCOMPARE(env.width(), width);
+
+    // compare against a plain loop using read()
+    for (int col = 0; col < width; ++col) {
+        auto const start = (size_t)col * size / width;
+        auto const end = std::max(start + 1, (size_t)(col + 1) * size / width);
+        float min[2] = { 1.0f, 1.0f };
+        float max[2] = { -1.0f, -1.0f };
+        float sum[2] = { 0.0f, 0.0f };
+        for (auto i = start; i < end; ++i) {
+            float frame[2];
+            buffer.read(i, frame[0], frame[1]);
+            for (int ch = 0; ch < 2; ++ch) {
+                min[ch] = std::min(min[ch], frame[ch]);
+                max[ch] = std::max(max[ch], frame[ch]);
+                sum[ch] += frame[ch];
+            }
+        }
+
+        VisualizerBuffer::Envelope::Channel const* channels[2] = { &env.left(), &env.right() };
+        for (int ch = 0; ch < 2; ++ch) {
+            QCOMPARE(channels[ch]->min[col], min[ch]);
+            QCOMPARE(channels[ch]->max[col], max[ch]);
+            QVERIFY(qAbs(channels[ch]->avg[col] - sum[ch] / (end - start)) < 1e-5f);
+        }
+    }
+}
+
+void TestVisualizerBuffer::envelopeEmpty() {
+    VisualizerBuffer buffer;
+    VisualizerBuffer::Envelope env;
+    buffer.envelope(160, env);
+    QCOMPARE(env.width(), 0);
+
+    buffer.resize(100);
+    buffer.envelope(0, env);
+    QCOMPARE(env.width(), 0);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <QtTest/QtTest>
+
+class TestVisualizerBuffer : public QObject {
+
+    Q_OBJECT
+
+public:
+
+    Q_INVOKABLE TestVisualizerBuffer();
+
+private slots:
+
+    void envelope_data();
+    void envelope();
+
+    void envelopeEmpty();
+
+};